@@ -0,0 +1,431 @@
+/*
+ * Copyright (c) 2002 Jon Atkins http://www.jonatkins.com/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+
+#include "audio.h"
+#include "logger.h"
+#include "memory.h"
+
+
+#define	AUDIO_ENV_RATE		(4000)		//envelope samples per second (roughly)
+#define	AUDIO_TAU		(0.002)		//envelope low pass time constant (seconds)
+#define	AUDIO_TRACK		(5.0)		//carrier level trackers' time constant (seconds)
+#define	AUDIO_WARMUP		(2.0)		//seconds before the levels are trusted
+#define	AUDIO_HYST		(0.1)		//thresholds either side of the middle, as a fraction of the levels' spread
+#define	AUDIO_MIN_DEPTH		(0.8)		//the low level must be under this fraction of the high one
+
+
+static unsigned int
+audioGet16 ( const unsigned char* p )
+{
+	return p[0] | (p[1] << 8);
+}
+
+static unsigned int
+audioGet32 ( const unsigned char* p )
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+
+void
+audioDetInit ( audioDetT* det, int rate )
+{
+	double	envrate;
+
+	memset ( det, 0, sizeof(audioDetT) );
+
+	det->decim = rate / AUDIO_ENV_RATE;
+	if ( det->decim < 1 )
+		det->decim = 1;
+
+	envrate = (double)rate / det->decim;
+
+	det->alpha = 1.0 - exp ( -1.0 / (AUDIO_TAU * envrate) );
+	det->decay = 1.0 - exp ( -1.0 / (AUDIO_TRACK * envrate) );
+	det->warm = AUDIO_WARMUP * envrate;
+
+	//a step between the levels crosses the far threshold this long after it happened - less
+	//the (decim+1)/2 samples the low pass responds early by, as it takes in a whole block at once,
+	//plus the half a sample (on average) between a step and the first sample that sees it
+	det->delay = -log ( 0.5 - AUDIO_HYST ) * AUDIO_TAU * rate - (det->decim + 1) / 2.0 + 0.5;
+}
+
+//|x| for a whole block - no branches, so the compiler can vectorise it
+//(unsigned, as -32768 doesn't fit back in a short)
+static void
+audioRectify ( const short* x, unsigned short* r, int n )
+{
+	int	i;
+
+	for ( i=0; i<n; i++ )
+		r[i] = x[i] < 0 ? -x[i] : x[i];
+}
+
+//one envelope sample (b is the average rectified input over its block) - returns 1 with
+//edge filled in if the level changed
+static int
+audioEnvSample ( audioDetT* det, float b, audioEdgeT* edge )
+{
+	float	prev, mid, hyst, thresh, frac;
+	int	level;
+
+	if ( !det->started )
+	{
+		det->env = det->hi = det->lo = b;
+		det->started = 1;
+	}
+
+	prev = det->env;
+	det->env += det->alpha * (b - det->env);
+
+	//while warming up the levels spread out to the extremes of the envelope - after that each
+	//is the average of the envelope while the line is at that level (so the low level doesn't
+	//creep up through the long high part of each second, which would skew the thresholds)
+	if ( det->warm > 0 )
+	{
+		if ( det->env > det->hi )
+			det->hi = det->env;
+		if ( det->env < det->lo )
+			det->lo = det->env;
+
+		det->warm--;
+		det->level = ( det->env > (det->hi + det->lo) / 2 );
+		return 0;
+	}
+
+	if ( det->level )
+		det->hi += det->decay * (det->env - det->hi);
+	else
+		det->lo += det->decay * (det->env - det->lo);
+
+	mid = (det->hi + det->lo) / 2;
+	hyst = (det->hi - det->lo) * AUDIO_HYST;
+
+	//not modulated deeply enough to be a time signal (or no signal at all)
+	if ( det->lo > det->hi * AUDIO_MIN_DEPTH )
+		return 0;
+
+	if ( det->level && det->env < mid - hyst )
+	{
+		thresh = mid - hyst;
+		level = 0;
+	}
+	else if ( !det->level && det->env > mid + hyst )
+	{
+		thresh = mid + hyst;
+		level = 1;
+	}
+	else
+		return 0;
+
+	det->level = level;
+
+	//where between the last two envelope samples it crossed - each stands for the middle of its block
+	frac = ( det->env != prev ) ? (thresh - prev) / (det->env - prev) : 1;
+	if ( frac < 0 )
+		frac = 0;
+	if ( frac > 1 )
+		frac = 1;
+
+	edge->pos = det->pos + (det->decim - 1) / 2.0 - det->decim * (1 - frac) - det->delay;
+	edge->level = level;
+
+	return 1;
+}
+
+int
+audioDetect ( audioDetT* det, const short* x, int n, audioEdgeT* edges, int max )
+{
+	unsigned short	r[AUDIO_BLOCK];
+	audioEdgeT	edge;
+	int		i, j, m, count, len;
+
+	count = 0;
+
+	while ( n > 0 )
+	{
+		len = n < AUDIO_BLOCK ? n : AUDIO_BLOCK;
+		audioRectify ( x, r, len );
+
+		for ( i=0; i<len; i+=m )
+		{
+			m = det->decim - det->accn;
+			if ( m > len - i )
+				m = len - i;
+
+			for ( j=0; j<m; j++ )
+				det->acc += r[i+j];
+			det->accn += m;
+
+			if ( det->accn < det->decim )
+				break;
+
+			if ( audioEnvSample ( det, (float)det->acc / det->decim, &edge ) && count < max )
+				edges[count++] = edge;
+
+			det->pos += det->decim;
+			det->acc = 0;
+			det->accn = 0;
+		}
+
+		x += len;
+		n -= len;
+	}
+
+	return count;
+}
+
+
+//read len bytes - returns how many there were before the end of the input
+static int
+audioReadFull ( audioInT* in, unsigned char* buf, int len )
+{
+	int	n, got;
+
+	got = 0;
+
+	while ( got < len )
+	{
+		in->reads++;
+		n = read ( in->fd, buf + got, len - got );
+		if ( n < 0 && errno == EINTR )
+			continue;
+		if ( n <= 0 )
+			break;
+		got += n;
+	}
+
+	return got;
+}
+
+audioInT*
+audioOpen ( int fd, const char* name )
+{
+	audioInT*	in;
+	unsigned char	header[12], chunk[8], fmt[40];
+	unsigned int	size, format, bits;
+	int		len;
+
+	in = safe_mallocz ( sizeof(audioInT) );
+	in->fd = fd;
+
+	format = 0;
+	bits = 0;
+
+	if ( audioReadFull ( in, header, 12 ) != 12 || memcmp ( header, "RIFF", 4 ) != 0 || memcmp ( header+8, "WAVE", 4 ) != 0 )
+	{
+		loggerf ( LOGGER_NOTE, "Error: %s is not a wav file\n", name );
+		safe_free ( in );
+		return NULL;
+	}
+
+	//find the format, and the start of the samples
+	while (1)
+	{
+		if ( audioReadFull ( in, chunk, 8 ) != 8 )
+		{
+			loggerf ( LOGGER_NOTE, "Error: %s: no audio data\n", name );
+			safe_free ( in );
+			return NULL;
+		}
+
+		size = audioGet32 ( chunk+4 );
+
+		if ( memcmp ( chunk, "data", 4 ) == 0 )
+			break;
+
+		if ( memcmp ( chunk, "fmt ", 4 ) == 0 && size >= 16 && size <= sizeof(fmt) )
+		{
+			if ( audioReadFull ( in, fmt, size + (size & 1) ) != (int)(size + (size & 1)) )
+				continue;	//(caught as no data next time round)
+
+			format = audioGet16 ( fmt );
+			in->channels = audioGet16 ( fmt+2 );
+			in->rate = audioGet32 ( fmt+4 );
+			bits = audioGet16 ( fmt+14 );
+
+			//WAVE_FORMAT_EXTENSIBLE - the real format starts the sub format guid
+			if ( format == 0xfffe && size >= 26 )
+				format = audioGet16 ( fmt+24 );
+			continue;
+		}
+
+		//skip anything else
+		size += size & 1;
+		while ( size > 0 )
+		{
+			len = size < sizeof(in->buf) ? size : sizeof(in->buf);
+			if ( audioReadFull ( in, in->buf, len ) != len )
+				break;
+			size -= len;
+		}
+	}
+
+	if ( !((format == 1 && (bits == 16 || bits == 24 || bits == 32)) || (format == 3 && bits == 32))
+	  || in->channels < 1 || in->channels > AUDIO_MAX_CHANNELS || in->rate < AUDIO_ENV_RATE )
+	{
+		loggerf ( LOGGER_NOTE, "Error: %s: unsupported wav format %u, %d channels, %d bits, %dHz\n", name, format, in->channels, bits, in->rate );
+		safe_free ( in );
+		return NULL;
+	}
+
+	in->bytes = bits / 8;
+	in->isfloat = ( format == 3 );
+
+	//(a wav written to a pipe doesn't know its length)
+	if ( size == 0 || size >= 0x7fffffff )
+		in->remaining = -1;
+	else
+		in->remaining = size;
+
+	loggerf ( LOGGER_INFO, "%s: %dHz, %d channels, %d bit%s\n", name, in->rate, in->channels, bits, in->isfloat ? " float" : "" );
+
+	return in;
+}
+
+int
+audioUseChannel ( audioInT* in, int channel )
+{
+	if ( channel < 0 || channel >= in->channels )
+		return -1;
+
+	if ( !(in->used & (1 << channel)) )
+		audioDetInit ( &in->det[channel], in->rate );
+
+	in->used |= 1 << channel;
+
+	return 0;
+}
+
+//a sample as 16 bits
+static short
+audioSample ( audioInT* in, const unsigned char* p )
+{
+	unsigned int	u;
+	float		f;
+
+	switch ( in->bytes )
+	{
+	case 2:
+		return (short)audioGet16 ( p );
+	case 3:
+		return (short)audioGet16 ( p+1 );
+	}
+
+	if ( !in->isfloat )
+		return (short)audioGet16 ( p+2 );
+
+	u = audioGet32 ( p );
+	memcpy ( &f, &u, sizeof(f) );
+
+	f *= 32767.0f;
+	if ( f > 32767.0f )
+		return 32767;
+	if ( f < -32767.0f )
+		return -32767;
+	return (short)f;
+}
+
+int
+audioRead ( audioInT* in, audioEdgeT* edges, int max )
+{
+	audioEdgeT	edge;
+	int		framebytes, want, frames, n, i, j, c, count;
+
+	framebytes = in->channels * in->bytes;
+
+	want = AUDIO_BLOCK * framebytes;
+	if ( in->remaining >= 0 && want > in->remaining )
+		want = in->remaining - in->remaining % framebytes;
+
+	//(a pipe returns what it has - wait for a whole frame at least)
+	while ( in->buflen < framebytes )
+	{
+		if ( want <= in->buflen )
+			return -1;
+
+		in->reads++;
+		n = read ( in->fd, in->buf + in->buflen, want - in->buflen );
+		if ( n < 0 && errno == EINTR )
+			continue;
+		if ( n <= 0 )
+			return -1;
+
+		in->buflen += n;
+	}
+
+	frames = in->buflen / framebytes;
+
+	for ( c=0; c<in->channels; c++ )
+	{
+		if ( !(in->used & (1 << c)) )
+			continue;
+
+		for ( i=0; i<frames; i++ )
+			in->samples[c][i] = audioSample ( in, in->buf + i * framebytes + c * in->bytes );
+	}
+
+	in->buflen -= frames * framebytes;
+	memmove ( in->buf, in->buf + frames * framebytes, in->buflen );
+	if ( in->remaining >= 0 )
+		in->remaining -= frames * framebytes;
+	in->frames += frames;
+
+	count = 0;
+	for ( c=0; c<in->channels; c++ )
+	{
+		if ( !(in->used & (1 << c)) )
+			continue;
+
+		n = audioDetect ( &in->det[c], in->samples[c], frames, edges + count, max - count );
+		for ( i=count; i<count+n; i++ )
+			edges[i].channel = c;
+		count += n;
+	}
+
+	//(each channel's edges are in order - merge them)
+	for ( i=1; i<count; i++ )
+	{
+		edge = edges[i];
+		for ( j=i; j>0 && edges[j-1].pos > edge.pos; j-- )
+			edges[j] = edges[j-1];
+		edges[j] = edge;
+	}
+
+	return count;
+}
+
+void
+audioClose ( audioInT* in )
+{
+	close ( in->fd );
+	safe_free ( in );
+}
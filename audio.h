@@ -0,0 +1,77 @@
+#ifndef AUDIO_H_
+#define AUDIO_H_
+
+#include "timef.h"
+
+//sample based front end: a receiver's audio output (a tone keyed by the carrier), or a dc
+//coupled am detector output, sampled by a sound card. the wav data comes from a file, or a
+//pipe or fifo (eg. arecord -f S16_LE -r 48000 -c 1) - each channel in use has an edge
+//detector: rectify, average down to the envelope rate, low pass, then threshold with
+//hysteresis between levels tracked from the envelope itself. edge times are interpolated
+//between envelope samples, so they're a fraction of a sample, not a whole block
+
+#define	AUDIO_MAX_CHANNELS	(8)
+#define	AUDIO_BLOCK		(4096)	//frames read at a time
+
+//envelope detector for one channel
+typedef struct
+{
+	int	decim;		//input samples per envelope sample
+	float	alpha;		//low pass coefficient
+	float	decay;		//level trackers' coefficient
+	double	delay;		//detector delay taken off the edge times (input samples)
+
+	unsigned int	acc;	//rectified sum of the envelope sample being built
+	int	accn;
+	double	pos;		//input sample number at the start of it
+
+	float	env;
+	float	hi, lo;		//carrier levels, from the envelope
+	int	started;
+	int	warm;		//envelope samples until the levels can be trusted
+	int	level;
+} audioDetT;
+
+typedef struct
+{
+	double	pos;		//input sample number (fractional) of the edge
+	int	channel;
+	int	level;
+} audioEdgeT;
+
+//a wav input, and the detectors for the channels in use
+typedef struct
+{
+	int		fd;
+	int		channels;
+	int		rate;
+	int		bytes;		//per sample
+	int		isfloat;
+	long long	remaining;	//data bytes left in the file - -1 for a stream
+	unsigned long	reads;		//read() calls made
+	unsigned long long	frames;	//read so far
+
+	unsigned char	buf[AUDIO_BLOCK*AUDIO_MAX_CHANNELS*4];
+	int		buflen;
+	short		samples[AUDIO_MAX_CHANNELS][AUDIO_BLOCK];
+
+	int		used;		//channel bits with a detector
+	audioDetT	det[AUDIO_MAX_CHANNELS];
+} audioInT;
+
+
+void audioDetInit ( audioDetT* det, int rate );
+//run n samples through the detector - returns the number of edges stored (up to max)
+int audioDetect ( audioDetT* det, const short* x, int n, audioEdgeT* edges, int max );
+
+//read the wav header from fd - returns NULL (and logs why) if it's not usable
+audioInT* audioOpen ( int fd, const char* name );
+//start a detector on a channel - returns -1 if the input doesn't have it
+int audioUseChannel ( audioInT* in, int channel );
+//read the next block, and detect edges on the channels in use - returns the number of
+//edges (in time order), or -1 at the end of the input
+int audioRead ( audioInT* in, audioEdgeT* edges, int max );
+void audioClose ( audioInT* in );
+
+
+#endif
@@ -0,0 +1,1745 @@
+/*
+ * Copyright (c) 2002 Jon Atkins http://www.jonatkins.com/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+//decode benchmark - synthetic receiver output at increasing noise levels, fed straight
+//into the clock code (no serial ports, no ntpd). built and run by "make bench"
+//(and the audio edge detector, on a synthetic keyed tone - and the iq front end, the pps
+//average's sliding window, poll mode's sampling schedule, and the main loop's wakeups against
+//the process per device it replaced)
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "systime.h"
+
+#include "clock.h"
+#include "window.h"
+#include "pollsched.h"
+#include "synth.h"
+#include "audio.h"
+#include "iq.h"
+#include "logger.h"
+#include "settings.h"
+#include "utctime.h"
+
+
+#define	BENCH_MINUTES	(120)	//per run
+#define	BENCH_LEVELS	(7)
+#define	BENCH_DELAY	(0.020)	//receiver delay - what the offset should come out as
+#define	BENCH_SKEW_LEVEL	(1)	//noise level for the pulse stretch runs
+#define	BENCH_VOTE_LEVEL	(4)	//and for the voting window runs
+#define	BENCH_HOLDOVER_LEVEL	(1)	//and the holdover runs...
+#define	BENCH_HOLDOVER_MINUTES	(60)
+#define	BENCH_HOLDOVER_START	(30*60)	//(when the signal goes)
+#define	BENCH_DRIFT		(50e-6)	//...with the pc's clock this far out
+#define	BENCH_ACQUIRE_LEVEL	(1)	//and the runs from the first decode on...
+#define	BENCH_ACQUIRE_MINUTES	(30)
+#define	BENCH_ACQUIRE_DRIFT	(10e-6)	//...with the pc's clock this far out
+#define	BENCH_ACQUIRE_SPANS	(3)
+#define	BENCH_SENT_LEVEL	(1)	//the times sent each second over longer runs...
+#define	BENCH_SENT_MINUTES	(30)
+
+//the pps average over a window of seconds: sorted every second, or kept in order as it goes
+#define	BENCH_WINDOW_MAX	(3600)
+#define	BENCH_WINDOW_SECONDS	(5000)	//averages worked out, once the window's full
+#define	BENCH_MIN_STAMP_ERR	(0.000010)	//(as clock.c's)
+#define	BENCH_STAMP_ERR_LIMIT	(4)
+#define	BENCH_OUTLIER_LIMIT	(3.0)
+#define	BENCH_WINDOW_DRIFT	(10e-6)	//(the pc's clock this far out)
+
+//audio: a DCF77 keyed tone, as a receiver's audio output might be
+//poll mode's sampling schedule
+#define	BENCH_POLL_SECONDS	(600)
+#define	BENCH_POLL_SETTLE	(5)	//seconds before the edges count (the phases are learned)
+#define	BENCH_POLL_OLD		(0.001)	//the fixed interval poll mode used to sample at
+
+//the main loop against a process per device - pipes standing in for the devices
+#define	BENCH_LOOP_SECONDS	(2.0)
+#define	BENCH_LOOP_PERIOD	(0.010)	//an edge on every receiver this often (faster than the radio)
+#define	BENCH_LOOP_MAX		(8)	//receivers
+
+#define	BENCH_AUDIO_RATE	(48000)
+#define	BENCH_AUDIO_SECONDS	(600)
+#define	BENCH_AUDIO_TONE	(1000.0)	//Hz
+#define	BENCH_AUDIO_HIGH	(16000.0)	//carrier amplitude
+#define	BENCH_AUDIO_LOW		(2400.0)	//reduced to 15%
+#define	BENCH_AUDIO_MAX_EDGES	(4096)
+
+//iq: DCF77 beside an MSF carrier, as 8 bit samples from an sdr tuned between them
+#define	BENCH_IQ_RATE		(1024000)
+#define	BENCH_IQ_SECONDS	(120)
+#define	BENCH_IQ_CENTRE		(70000)
+#define	BENCH_IQ_HIGH		(40.0)		//DCF77 amplitude (8 bit steps)
+#define	BENCH_IQ_LOW		(6.0)
+#define	BENCH_IQ_MSF		(30.0)		//MSF - left on, as an interferer
+#define	BENCH_IQ_PM		(15.6)		//DCF77 phase modulation (degrees)
+
+//each run starts somewhere awkward - summer time changes, midnight, new year
+static const struct
+{
+	int	year, mon, mday, hour, min;
+} benchStarts[] =
+{
+	{ 2026,  1, 15, 10,  0 },
+	{ 2026,  3, 29,  0,  0 },
+	{ 2026,  7,  4, 23,  0 },
+	{ 2026, 12, 31, 23, 30 },
+};
+#define	BENCH_RUNS	((int)(sizeof(benchStarts) / sizeof(benchStarts[0])))
+
+static time_t
+benchStartTime ( int run )
+{
+	struct tm	tm;
+
+	memset ( &tm, 0, sizeof(tm) );
+	tm.tm_year = benchStarts[run].year - 1900;
+	tm.tm_mon = benchStarts[run].mon - 1;
+	tm.tm_mday = benchStarts[run].mday;
+	tm.tm_hour = benchStarts[run].hour;
+	tm.tm_min = benchStarts[run].min;
+
+	return UTCtime ( &tm );
+}
+
+typedef struct
+{
+	int		expected;	//minutes that could have been decoded
+	int		good;
+	int		bad;		//decoded, but to the wrong time
+	int		fixes;		//runs that got a good decode
+	time_f		firstfix;	//(total over the runs that did)
+	int		offsets;
+	time_f		offsetsq;	//offset error (from the receiver delay) squared
+	int		seconds;	//times sent to ntpd, one a second
+	int		secwrong;	//sent for the wrong second
+	time_f		secsq;		//the others' offset errors squared
+	long		edges;
+} benchResultT;
+
+
+//noise level n: n*3ms edge jitter, n*0.2% of seconds lost, n*0.5% of seconds with a glitch
+static void
+benchNoise ( int level, synthNoiseT* noise )
+{
+	noise->delay = BENCH_DELAY;
+	noise->jitter = level * 0.003;
+	noise->dropout = level * 0.002;
+	noise->glitch = level * 0.005;
+	noise->glitchlen = 0.030;
+	noise->skew = 0;
+	noise->drift = 0;
+	noise->late = 0;
+	noise->slowread = 0;
+	noise->bracket = 1;
+	noise->outage = 0;
+	noise->outagestart = 0;
+}
+
+static void
+benchRun ( int clocktype, const synthNoiseT* noise, time_t start, unsigned int seed, benchResultT* res )
+{
+	clkInfoT*	clock;
+	synthT		syn;
+	timeStampT	ts;
+	time_ns		end, lastradio, truth, average;
+	time_f		maxerr, err;
+	unsigned long	sent;
+	int		level, gotfix;
+
+	clock = clkCreate ( 0, 0, 0.0, clocktype );
+	synthInit ( &syn, clocktype, start, noise, seed );
+
+	end = (time_ns)(start + BENCH_MINUTES*60) * NSEC_PER_SEC;
+	lastradio = 0;
+	gotfix = 0;
+	sent = clock->sent;
+
+	while(1)
+	{
+		synthNextEdge ( &syn, &level, &ts );
+		if ( ts.real >= end )
+			break;
+
+		res->edges++;
+		clkProcessStatusChange ( clock, level, &ts );
+
+		//a time sent - for the second its pc time (less the receiver delay) is nearest to?
+		if ( clock->sent != sent )
+		{
+			sent = clock->sent;
+			res->seconds++;
+			truth = (clock->sentpc - time_f2time_ns ( BENCH_DELAY ) + NSEC_PER_SEC/2) / NSEC_PER_SEC * NSEC_PER_SEC;
+			if ( clock->sentradio != truth )
+				res->secwrong++;
+			else
+			{
+				err = time_ns2time_f ( clock->sentpc - clock->sentradio ) - BENCH_DELAY;
+				res->secsq += err * err;
+			}
+		}
+
+		//(0 is the seconds being counted again - no time, rather than a wrong one)
+		if ( clock->radiotime == lastradio || clock->radiotime == 0 )
+			continue;
+		lastradio = clock->radiotime;
+
+		//a new decode - the minute it's for starts at the nearest minute to the edge it started on
+		truth = (clock->pctime - time_f2time_ns ( BENCH_DELAY ) + 30*NSEC_PER_SEC) / (60*NSEC_PER_SEC) * (60*NSEC_PER_SEC);
+
+		if ( clock->radiotime != truth )
+		{
+			res->bad++;
+			continue;
+		}
+
+		res->good++;
+		if ( !gotfix )
+		{
+			gotfix = 1;
+			res->fixes++;
+			res->firstfix += time_ns2time_f ( ts.real - (time_ns)start * NSEC_PER_SEC );
+		}
+
+		//what would go to ntpd
+		if ( clkCalculatePPSAverage ( clock, clock->pctime, &average, &maxerr ) == 0 )
+		{
+			err = time_ns2time_f ( average ) - BENCH_DELAY;
+			res->offsetsq += err * err;
+			res->offsets++;
+		}
+	}
+
+	//(the first minute is only there from the minute marker on)
+	res->expected += BENCH_MINUTES - 1;
+
+	clkFree ( clock );
+}
+
+//the runs for one station and noise - one row of the table, labelled (seeds from level)
+static void
+benchStation ( int clocktype, const char* name, const synthNoiseT* noise, int level, const char* label )
+{
+	benchResultT	res;
+	clock_t		cpu;
+	int		run;
+
+	memset ( &res, 0, sizeof(res) );
+
+	cpu = clock();
+	for ( run=0; run<BENCH_RUNS; run++ )
+	{
+		benchRun ( clocktype, noise, benchStartTime ( run ), 1 + run*7919 + level*104729, &res );
+	}
+	cpu = clock() - cpu;
+
+	printf ( "%-7s  %5s  %6.1f%%  %6d", name, label, 100.0 * res.good / res.expected, res.bad );
+
+	if ( res.fixes > 0 )
+		printf ( "  %8.0fs", res.firstfix / res.fixes );
+	else
+		printf ( "  %9s", "none" );
+	if ( res.fixes < BENCH_RUNS )
+		printf ( "*" );
+	else
+		printf ( " " );
+
+	if ( res.offsets > 0 )
+		printf ( "  %7.3fms", sqrt ( res.offsetsq / res.offsets ) * 1000 );
+	else
+		printf ( "  %9s", "-" );
+
+	printf ( "  %7d  %6d", res.seconds, res.secwrong );
+	if ( res.seconds > res.secwrong )
+		printf ( "  %7.3fms", sqrt ( res.secsq / (res.seconds - res.secwrong) ) * 1000 );
+	else
+		printf ( "  %9s", "-" );
+
+	printf ( "  %8.0f\n", cpu > 0 ? res.edges / ((double)cpu / CLOCKS_PER_SEC) : 0.0 );
+}
+
+typedef struct
+{
+	int	sent;
+	time_f	sqsum;		//of their errors
+	time_f	worst;
+	time_f	errsum;		//of the errors they were sent with
+} benchHoldoverT;
+
+//a time sent from the flywheel - how far out it is (from the receiver delay, and the pc clock's
+//drift since the start)
+static void
+benchHoldoverSample ( const clkInfoT* clock, const synthNoiseT* noise, time_t start, benchHoldoverT* res )
+{
+	time_ns	truth;
+	time_f	err;
+
+	truth = clock->sentradio + time_f2time_ns ( BENCH_DELAY
+		+ noise->drift * time_ns2time_f ( clock->sentradio - (time_ns)start * NSEC_PER_SEC ) );
+	err = time_ns2time_f ( clock->sentpc - truth );
+
+	res->sent++;
+	res->sqsum += err * err;
+	res->worst = fmax ( res->worst, fabs ( err ) );
+	res->errsum += clock->senterr;
+}
+
+//the signal gone for a while (noise->outage) - the times sent from the flywheel meanwhile
+static void
+benchHoldover ( int clocktype, const char* name, const synthNoiseT* noise, const char* label )
+{
+	benchHoldoverT	res;
+	clkInfoT*	clock;
+	synthT		syn;
+	timeStampT	ts, now;
+	time_t		start;
+	time_ns		end, tick;
+	int		run, level, sentsec;
+
+	memset ( &res, 0, sizeof(res) );
+	for ( run=0; run<BENCH_RUNS; run++ )
+	{
+		start = benchStartTime ( run );
+
+		clock = clkCreate ( 0, 0, 0.0, clocktype );
+		synthInit ( &syn, clocktype, start, noise, 1 + run*7919 );
+
+		end = (time_ns)(start + BENCH_HOLDOVER_MINUTES*60) * NSEC_PER_SEC;
+		sentsec = clock->sentsec;
+		tick = 0;
+
+		while(1)
+		{
+			synthNextEdge ( &syn, &level, &ts );
+			if ( ts.real >= end )
+				break;
+
+			//(the main loop's wakeups while the line's quiet - a second apart at most)
+			if ( tick == 0 )
+				tick = ts.mono;
+			for ( ; tick < ts.mono; tick += NSEC_PER_SEC )
+			{
+				now.mono = tick;
+				now.real = tick + (ts.real - ts.mono);
+				now.err = 0;
+				clkHoldover ( clock, &now );
+				if ( clock->sentsec != sentsec && clock->sentholdover )
+					benchHoldoverSample ( clock, noise, start, &res );
+				sentsec = clock->sentsec;
+			}
+
+			clkProcessStatusChange ( clock, level, &ts );
+			if ( clock->sentsec != sentsec && clock->sentholdover )
+				benchHoldoverSample ( clock, noise, start, &res );
+			sentsec = clock->sentsec;
+		}
+		clkFree ( clock );
+	}
+
+	printf ( "%-7s %6s  %6d", name, label, res.sent );
+	if ( res.sent > 0 )
+		printf ( "  %7.3fms  %7.3fms  %7.3fms\n", sqrt ( res.sqsum / res.sent ) * 1000, res.worst * 1000, res.errsum / res.sent * 1000 );
+	else
+		printf ( "  %9s  %9s  %9s\n", "-", "-", "-" );
+}
+
+//the times sent each second (not from the flywheel) from the first decode on, averaging over
+//averageSeconds - by how long after the first of them they were sent: how far out they are, and
+//the error they were sent with
+static void
+benchAcquire ( int clocktype, const char* name, const synthNoiseT* noise, const char* label )
+{
+	static const time_f	spans[BENCH_ACQUIRE_SPANS] = { 60, 300, 1e9 };
+	benchHoldoverT	res[BENCH_ACQUIRE_SPANS];
+	clkInfoT*	clock;
+	synthT		syn;
+	timeStampT	ts;
+	time_t		start;
+	time_ns		end, first;
+	int		run, level, sentsec, k;
+
+	memset ( res, 0, sizeof(res) );
+	for ( run=0; run<BENCH_RUNS; run++ )
+	{
+		start = benchStartTime ( run );
+
+		clock = clkCreate ( 0, 0, 0.0, clocktype );
+		synthInit ( &syn, clocktype, start, noise, 1 + run*7919 );
+
+		end = (time_ns)(start + BENCH_ACQUIRE_MINUTES*60) * NSEC_PER_SEC;
+		sentsec = clock->sentsec;
+		first = 0;
+
+		while(1)
+		{
+			synthNextEdge ( &syn, &level, &ts );
+			if ( ts.real >= end )
+				break;
+
+			clkProcessStatusChange ( clock, level, &ts );
+			if ( clock->sentsec != sentsec && !clock->sentholdover && clock->confirmed )
+			{
+				if ( first == 0 )
+					first = ts.real;
+				for ( k=0; time_ns2time_f ( ts.real - first ) >= spans[k]; k++ )
+					;
+				benchHoldoverSample ( clock, noise, start, &res[k] );
+			}
+			sentsec = clock->sentsec;
+		}
+		clkFree ( clock );
+	}
+
+	printf ( "%-7s %5ss", name, label );
+	for ( k=0; k<BENCH_ACQUIRE_SPANS; k++ )
+	{
+		if ( res[k].sent > 0 )
+			printf ( "  %7.3fms %7.3fms", sqrt ( res[k].sqsum / res[k].sent ) * 1000, res[k].errsum / res[k].sent * 1000 );
+		else
+			printf ( "  %9s %9s", "-", "-" );
+	}
+	printf ( "\n" );
+}
+
+typedef struct
+{
+	int		sent;
+	int		wrong;		//for the wrong second
+	time_f		sqsum;		//of the others' errors
+	unsigned long	raw;		//without a pps average
+	unsigned long	outliers;	//pps samples left out (see clkCountPPSSample())
+	time_f		ratesum;	//the rate estimated at the end of each run
+	time_f		ratesq;		//(its error, squared)
+} benchSentT;
+
+//the times sent each second (not from the flywheel) over BENCH_SENT_MINUTES runs: how many were
+//sent for the wrong second, how far out the rest are (from the receiver delay, and the pc clock's
+//drift since the start), and the rate the clock ended up estimating against the drift
+static void
+benchSent ( int clocktype, const char* name, const synthNoiseT* noise, const char* label )
+{
+	benchSentT	res;
+	clkInfoT*	clock;
+	synthT		syn;
+	timeStampT	ts;
+	time_t		start;
+	time_ns		end, truth;
+	time_f		err;
+	unsigned long	sent;
+	int		run, level;
+
+	memset ( &res, 0, sizeof(res) );
+	for ( run=0; run<BENCH_RUNS; run++ )
+	{
+		start = benchStartTime ( run );
+
+		clock = clkCreate ( 0, 0, 0.0, clocktype );
+		synthInit ( &syn, clocktype, start, noise, 1 + run*7919 + BENCH_SENT_LEVEL*104729 );
+
+		end = (time_ns)(start + BENCH_SENT_MINUTES*60) * NSEC_PER_SEC;
+		sent = clock->sent;
+
+		while(1)
+		{
+			synthNextEdge ( &syn, &level, &ts );
+			if ( ts.real >= end )
+				break;
+
+			clkProcessStatusChange ( clock, level, &ts );
+			if ( clock->sent == sent || clock->sentholdover )
+				continue;
+			sent = clock->sent;
+
+			truth = clock->sentradio + time_f2time_ns ( BENCH_DELAY
+				+ noise->drift * time_ns2time_f ( clock->sentradio - (time_ns)start * NSEC_PER_SEC ) );
+			err = time_ns2time_f ( clock->sentpc - truth );
+
+			res.sent++;
+			if ( fabs ( err ) >= 0.5 )
+				res.wrong++;
+			else
+				res.sqsum += err * err;
+		}
+
+		res.raw += clock->sentraw;
+		res.outliers += clock->ppsoutliers;
+		res.ratesum += clock->frequency;
+		res.ratesq += (clock->frequency - noise->drift) * (clock->frequency - noise->drift);
+
+		clkFree ( clock );
+	}
+
+	printf ( "%-7s %6s  %6d  %6d", name, label, res.sent, res.wrong );
+	if ( res.sent > res.wrong )
+		printf ( "  %7.3fms", sqrt ( res.sqsum / (res.sent - res.wrong) ) * 1000 );
+	else
+		printf ( "  %9s", "-" );
+	printf ( "  %6lu  %8lu  %+7.2fppm  %6.2fppm\n", res.raw, res.outliers,
+		res.ratesum / BENCH_RUNS * 1e6, sqrt ( res.ratesq / BENCH_RUNS ) * 1e6 );
+}
+
+static unsigned int	benchSeed = 1;
+
+static double
+benchGauss ( void )
+{
+	double	u1, u2;
+
+	benchSeed = benchSeed * 1103515245 + 12345;
+	u1 = ((benchSeed >> 8) + 1.0) / 16777217.0;
+	benchSeed = benchSeed * 1103515245 + 12345;
+	u2 = (benchSeed >> 8) / 16777216.0;
+
+	return sqrt ( -2 * log ( u1 ) ) * cos ( 2 * M_PI * u2 );
+}
+
+static double
+benchUniform ( void )
+{
+	benchSeed = benchSeed * 1103515245 + 12345;
+	return (benchSeed >> 8) / 16777216.0;
+}
+
+//poll mode sampling a DCF77 style line (a carrier reduction 20ms into each second, 100 or
+//200ms long, none in second 59) with edges +-jitter (uniform) - at a fixed interval as it used
+//to (old), or on pollsched's schedule: the samples and syscalls (a TIOCMGET and a timerfd read
+//each, and a timerfd_settime when it's armed - usleep for the old loop), and how long after
+//each edge it was seen - in a dense window, or by the slow sampling outside them
+static void
+benchPoll ( time_f jitter, int old )
+{
+	static time_ns	edges[BENCH_POLL_SECONDS * 2];
+	pollSchedT	ps;
+	time_ns		base, t, last, next, windowend, delay, maxin, maxout;
+	time_f		sumin;
+	long		samples, syscalls;
+	int		numedges, k, s, periodic, inwindow, changed, in, out;
+
+	base = (time_ns)1767225600 * NSEC_PER_SEC;
+	benchSeed = 1;
+	numedges = 0;
+	for ( s=0; s<BENCH_POLL_SECONDS; s++ )
+	{
+		if ( s % 60 == 59 )
+			continue;
+		edges[numedges++] = base + (time_ns)s * NSEC_PER_SEC + time_f2time_ns ( 0.020 + jitter * (2 * benchUniform () - 1) );
+		edges[numedges++] = base + (time_ns)s * NSEC_PER_SEC
+			+ time_f2time_ns ( (benchUniform () < 0.5 ? 0.120 : 0.220) + jitter * (2 * benchUniform () - 1) );
+	}
+
+	pollSchedInit ( &ps );
+	samples = syscalls = 0;
+	in = out = 0;
+	sumin = 0;
+	maxin = maxout = 0;
+	periodic = inwindow = 0;
+	k = 0;
+	last = t = base;
+	while ( t < base + (time_ns)BENCH_POLL_SECONDS * NSEC_PER_SEC )
+	{
+		samples++;
+		syscalls += 2;
+
+		changed = 0;
+		for ( ; k < numedges && edges[k] <= t; k++ )
+		{
+			changed = 1;
+			if ( edges[k] < base + (time_ns)BENCH_POLL_SETTLE * NSEC_PER_SEC )
+				continue;
+
+			delay = t - edges[k];
+			if ( old || inwindow )
+			{
+				in++;
+				sumin += time_ns2time_f ( delay );
+				if ( delay > maxin )
+					maxin = delay;
+			}
+			else
+			{
+				out++;
+				if ( delay > maxout )
+					maxout = delay;
+			}
+		}
+
+		if ( old )
+		{
+			last = t;
+			t += time_f2time_ns ( BENCH_POLL_OLD );
+			continue;
+		}
+
+		//(as serial.c: the edge stamped between the samples, the timer left running in a window)
+		if ( changed )
+			pollSchedEdge ( &ps, last + (t - last) / 2 );
+		next = pollSchedNext ( &ps, t, &windowend );
+		if ( windowend == 0 )
+			periodic = 0;
+		if ( windowend == 0 || !periodic )
+		{
+			syscalls++;
+			periodic = ( windowend > 0 );
+		}
+		inwindow = ( windowend > 0 );
+
+		last = t;
+		t = next;
+	}
+
+	printf ( "%5.0fms  %-7s  %9.1f  %10.1f  %6d  %8.3fms  %8.3fms  %6d  %8.3fms\n", jitter * 1000, old ? "old" : "windows",
+		(double)samples / BENCH_POLL_SECONDS, (double)syscalls / BENCH_POLL_SECONDS,
+		in, in > 0 ? sumin / in * 1000 : 0.0, time_ns2time_f ( maxin ) * 1000, out, time_ns2time_f ( maxout ) * 1000 );
+}
+
+//the main loop, and the process per device it replaced (see main.c), for n receivers - each
+//either waiting for its edges (TIOCMIWAIT, sysfs gpio) or sampled (poll mode). the devices are
+//pipes: a wait is a read() of one, a status read an ioctl() on one. the edges are written to
+//every receiver at once (as from one transmitter) by a process of its own, so it's not counted
+static int	benchLoopFds[BENCH_LOOP_MAX][2];	//the receivers' "devices"
+static int	benchLoopEvFds[BENCH_LOOP_MAX][2];	//the waiter threads' pipes to the main loop
+
+//the edges dispatched, the system calls made for them, and how long after the edge was sent
+typedef struct
+{
+	long	edges;
+	long	syscalls;
+	time_f	latsum;
+	time_f	latmax;
+} benchEdgesT;
+
+static benchEdgesT	benchLoopEdges[BENCH_LOOP_MAX];	//(each waiter thread's system calls)
+
+static void
+benchEdgeDispatched ( benchEdgesT* e, time_ns sent, time_ns now )
+{
+	time_f	lat = time_ns2time_f ( now - sent );
+
+	e->edges++;
+	e->latsum += lat;
+	if ( lat > e->latmax )
+		e->latmax = lat;
+}
+
+static time_ns
+benchMono ( void )
+{
+	struct timespec	ts;
+	time_ns		t;
+
+	clock_gettime ( CLOCK_MONOTONIC, &ts );
+	timespec2time_ns ( &ts, t );
+	return t;
+}
+
+//voluntary context switches (a wakeup each, near enough) and cpu time, of who
+static void
+benchUsage ( int who, long* pswitches, time_f* pcpu )
+{
+	struct rusage	ru;
+
+	getrusage ( who, &ru );
+	*pswitches = ru.ru_nvcsw;
+	*pcpu = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+//an edge (its time sent) to each receiver every BENCH_LOOP_PERIOD - then they're closed
+static void
+benchLoopFeed ( int n )
+{
+	struct timespec	ts;
+	time_ns		start, t;
+	int		i, k;
+
+	start = benchMono ();
+	for ( k=1; k * BENCH_LOOP_PERIOD < BENCH_LOOP_SECONDS; k++ )
+	{
+		t = start + time_f2time_ns ( k * BENCH_LOOP_PERIOD );
+		ts.tv_sec = t / NSEC_PER_SEC;
+		ts.tv_nsec = t % NSEC_PER_SEC;
+		clock_nanosleep ( CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL );
+
+		t = benchMono ();
+		for ( i=0; i<n; i++ )
+		{
+			if ( write ( benchLoopFds[i][1], &t, sizeof(t) ) != sizeof(t) )
+				break;
+		}
+	}
+
+	for ( i=0; i<n; i++ )
+		close ( benchLoopFds[i][1] );
+}
+
+static void
+benchAlarm ( int sig )
+{
+	(void)sig;
+}
+
+//a process per device, as before the main loop: an edge waited for as serial.c's iwait did -
+//an alarm() set round each wait, in case it never comes - then the lines read, and the edge
+//dispatched there and then. what it counted goes back through its waiter pipe
+static void
+benchOldWaiter ( int i )
+{
+	benchEdgesT	e;
+	struct timeval	tv;
+	time_ns		sent;
+	int		lines, n;
+
+	memset ( &e, 0, sizeof(e) );
+	while(1)
+	{
+		signal ( SIGALRM, benchAlarm );
+		alarm ( 10 );
+		n = read ( benchLoopFds[i][0], &sent, sizeof(sent) );
+		gettimeofday ( &tv, NULL );
+		signal ( SIGALRM, SIG_DFL );
+		alarm ( 0 );
+		if ( n != sizeof(sent) )
+			break;
+		ioctl ( benchLoopFds[i][0], FIONREAD, &lines );	//(TIOCMGET)
+
+		e.syscalls += 6;	//(gettimeofday() is in the vdso)
+		benchEdgeDispatched ( &e, sent, benchMono () );
+	}
+
+	if ( write ( benchLoopEvFds[i][1], &e, sizeof(e) ) != sizeof(e) )
+		printf ( "write() failed\n" );
+}
+
+//...or sampled every 1ms
+static void
+benchOldPoller ( int i )
+{
+	time_ns	end;
+	int	lines;
+
+	end = benchMono () + time_f2time_ns ( BENCH_LOOP_SECONDS );
+	while ( benchMono () < end )
+	{
+		ioctl ( benchLoopFds[i][0], FIONREAD, &lines );
+		usleep ( 1000 );
+	}
+}
+
+//the main loop's waiter thread for a device that can't be poll()ed (serWaitThread()) - the
+//wait, the edge counts and the lines read, each bracketed, and the change passed on
+static void*
+benchNewWaiter ( void* arg )
+{
+	int		i = (int)(long)arg;
+	time_ns		sent;
+	int		lines;
+
+	while ( read ( benchLoopFds[i][0], &sent, sizeof(sent) ) == sizeof(sent) )
+	{
+		ioctl ( benchLoopFds[i][0], FIONREAD, &lines );	//(TIOCGICOUNT)
+		benchMono ();
+		ioctl ( benchLoopFds[i][0], FIONREAD, &lines );	//(TIOCMGET)
+		benchMono ();
+		if ( write ( benchLoopEvFds[i][1], &sent, sizeof(sent) ) != sizeof(sent) )
+			break;
+		benchLoopEdges[i].syscalls += 4;
+	}
+
+	close ( benchLoopEvFds[i][1] );
+	return NULL;
+}
+
+//the main loop: poll() on every waiter's pipe - each change read, and dispatched (or, for poll
+//mode, a 1ms timeout, and every device sampled each time round)
+static void
+benchNewLoop ( int n, int polled, benchEdgesT* e )
+{
+	struct pollfd	pfd[BENCH_LOOP_MAX];
+	time_ns		end, sent;
+	int		i, open, lines;
+
+	if ( polled )
+	{
+		end = benchMono () + time_f2time_ns ( BENCH_LOOP_SECONDS );
+		while ( benchMono () < end )
+		{
+			poll ( NULL, 0, 1 );
+			for ( i=0; i<n; i++ )
+				ioctl ( benchLoopFds[i][0], FIONREAD, &lines );
+		}
+		return;
+	}
+
+	for ( i=0; i<n; i++ )
+	{
+		pfd[i].fd = benchLoopEvFds[i][0];
+		pfd[i].events = POLLIN;
+	}
+
+	open = n;
+	while ( open > 0 && poll ( pfd, n, -1 ) > 0 )
+	{
+		e->syscalls++;
+		for ( i=0; i<n; i++ )
+		{
+			if ( pfd[i].fd < 0 || !(pfd[i].revents & (POLLIN|POLLHUP)) )
+				continue;
+			if ( read ( pfd[i].fd, &sent, sizeof(sent) ) != sizeof(sent) )
+			{
+				pfd[i].fd = -1;
+				open--;
+				continue;
+			}
+			e->syscalls++;
+			benchEdgeDispatched ( e, sent, benchMono () );
+		}
+	}
+}
+
+//n receivers for BENCH_LOOP_SECONDS, waiting for edges or polled, the old way (a process each)
+//or the new (one loop, and a thread for each device that's waited for) - the wakeups and cpu
+//time for each receiver, a second - and for the edges waited for, the system calls made for
+//each, and how long after it was sent it was dispatched
+static void
+benchLoop ( int n, int polled, int old )
+{
+	pthread_t	threads[BENCH_LOOP_MAX];
+	pid_t		feeder, pids[BENCH_LOOP_MAX];
+	benchEdgesT	e, child;
+	long		switches0, switches1;
+	time_f		cpu0, cpu1;
+	int		i, who;
+
+	for ( i=0; i<n; i++ )
+	{
+		if ( pipe ( benchLoopFds[i] ) != 0 || pipe ( benchLoopEvFds[i] ) != 0 )
+		{
+			printf ( "pipe() failed\n" );
+			return;
+		}
+	}
+
+	//(the old way's counted from its children, the new way's in this process)
+	who = old ? RUSAGE_CHILDREN : RUSAGE_SELF;
+	memset ( &e, 0, sizeof(e) );
+	memset ( benchLoopEdges, 0, sizeof(benchLoopEdges) );
+
+	feeder = -1;
+	if ( !polled )
+	{
+		feeder = fork ();
+		if ( feeder == 0 )
+		{
+			benchLoopFeed ( n );
+			_exit ( 0 );
+		}
+		for ( i=0; i<n; i++ )
+			close ( benchLoopFds[i][1] );
+	}
+	//(the feeder's reaped after the counts, so it isn't among the children counted)
+	benchUsage ( who, &switches0, &cpu0 );
+
+	if ( old )
+	{
+		for ( i=0; i<n; i++ )
+		{
+			pids[i] = fork ();
+			if ( pids[i] == 0 )
+			{
+				if ( polled )
+					benchOldPoller ( i );
+				else
+					benchOldWaiter ( i );
+				_exit ( 0 );
+			}
+		}
+		for ( i=0; i<n; i++ )
+		{
+			waitpid ( pids[i], NULL, 0 );
+			if ( !polled && read ( benchLoopEvFds[i][0], &child, sizeof(child) ) == sizeof(child) )
+			{
+				e.edges += child.edges;
+				e.syscalls += child.syscalls;
+				e.latsum += child.latsum;
+				e.latmax = fmax ( e.latmax, child.latmax );
+			}
+		}
+	}
+	else
+	{
+		if ( !polled )
+		{
+			for ( i=0; i<n; i++ )
+				pthread_create ( &threads[i], NULL, benchNewWaiter, (void*)(long)i );
+		}
+		benchNewLoop ( n, polled, &e );
+		if ( !polled )
+		{
+			for ( i=0; i<n; i++ )
+			{
+				pthread_join ( threads[i], NULL );
+				e.syscalls += benchLoopEdges[i].syscalls;
+			}
+		}
+	}
+
+	benchUsage ( who, &switches1, &cpu1 );
+	if ( feeder > 0 )
+		waitpid ( feeder, NULL, 0 );
+
+	for ( i=0; i<n; i++ )
+	{
+		close ( benchLoopFds[i][0] );
+		if ( polled )
+			close ( benchLoopFds[i][1] );
+		close ( benchLoopEvFds[i][0] );
+		if ( old || polled )
+			close ( benchLoopEvFds[i][1] );
+	}
+
+	printf ( "%9d  %-7s  %-4s  %12.1f  %12.1f", n, polled ? "polled" : "waited", old ? "old" : "new",
+		(switches1 - switches0) / (n * BENCH_LOOP_SECONDS), (cpu1 - cpu0) * 1e6 / (n * BENCH_LOOP_SECONDS) );
+	if ( e.edges > 0 )
+		printf ( "  %13.2f  %9.1fus  %9.1fus\n", (double)e.syscalls / e.edges, e.latsum / e.edges * 1e6, e.latmax * 1e6 );
+	else
+		printf ( "  %13s  %11s  %11s\n", "-", "-", "-" );
+}
+
+//the edges of a noiseless DCF77 signal, for seconds from the start - in samples
+static int
+benchKeyedEdges ( double* truth, int* truthlevel, int seconds, double rate )
+{
+	synthT		syn;
+	synthNoiseT	noise;
+	timeStampT	ts;
+	time_ns		start;
+	int		num, level;
+
+	memset ( &noise, 0, sizeof(noise) );
+	start = (time_ns)1768471200 * NSEC_PER_SEC;
+	synthInit ( &syn, CLOCKTYPE_DCF77, 1768471200, &noise, 1 );
+
+	num = 0;
+	while ( num < BENCH_AUDIO_MAX_EDGES )
+	{
+		synthNextEdge ( &syn, &level, &ts );
+		if ( ts.real - start >= (time_ns)seconds * NSEC_PER_SEC )
+			break;
+		truth[num] = time_ns2time_f ( ts.real - start ) * rate;
+		truthlevel[num++] = level;
+	}
+
+	return num;
+}
+
+//match each edge found to the nearest keyed one of the same level (within 30ms) - returns how
+//many matched, and the sum (and sum of squares) of their errors in seconds
+static int
+benchMatchEdges ( const double* truth, const int* truthlevel, int numtruth,
+	const double* found, const int* foundlevel, int numfound, double rate, double* sum, double* sumsq )
+{
+	double	diff, best;
+	int	matched, nearest, e, j, k;
+
+	matched = 0;
+	*sum = 0;
+	*sumsq = 0;
+	e = 0;
+	for ( j=0; j<numfound; j++ )
+	{
+		while ( e+1 < numtruth && truth[e+1] <= found[j] )
+			e++;
+
+		best = 0;
+		nearest = -1;
+		for ( k = e > 0 ? e-1 : 0; k <= e+1 && k < numtruth; k++ )
+		{
+			diff = found[j] - truth[k];
+			if ( foundlevel[j] == truthlevel[k] && fabs(diff) < 0.030 * rate && (nearest < 0 || fabs(diff) < fabs(best)) )
+			{
+				best = diff;
+				nearest = k;
+			}
+		}
+		if ( nearest < 0 )
+			continue;
+
+		diff = best / rate;
+		*sum += diff;
+		*sumsq += diff * diff;
+		matched++;
+	}
+
+	return matched;
+}
+
+typedef struct
+{
+	time_f	offset;
+	time_f	t;
+	time_f	err;
+	int	used;		//(not left out by its timestamp error)
+} benchSampleT;
+
+static int
+benchCompareTimef ( const void* a, const void* b )
+{
+	time_f	ta = *(const time_f*)a, tb = *(const time_f*)b;
+
+	return ta < tb ? -1 : ta > tb ? 1 : 0;
+}
+
+static int
+benchCompareSample ( const void* a, const void* b )
+{
+	return benchCompareTimef ( &((const benchSampleT*)a)->offset, &((const benchSampleT*)b)->offset );
+}
+
+//one half's weighted sums - and its sum of squares from the line x = a + b*t, once that's known
+typedef struct
+{
+	int	count;
+	time_f	w, wx, wt;
+} benchHalfT;
+
+//the limit past which a sample's timestamp error leaves it out, from the median of the window's
+static time_f
+benchSortStampLimit ( const benchSampleT* window, int count )
+{
+	static time_f	errs[BENCH_WINDOW_MAX];
+	int		i;
+
+	for ( i=0; i<count; i++ )
+		errs[i] = window[i].err;
+	qsort ( errs, count, sizeof(time_f), benchCompareTimef );
+
+	return fmax ( BENCH_STAMP_ERR_LIMIT * errs[count/2], BENCH_MIN_STAMP_ERR );
+}
+
+//the samples of a half (ages from to to-1) that are averaged - sorted, and those not too far
+//from the median by the median absolute deviation
+static int
+benchSortHalf ( const benchSampleT* window, int n, int newest, int from, int to, benchSampleT* inliers, benchHalfT* h )
+{
+	static benchSampleT	used[BENCH_WINDOW_MAX];
+	static time_f		devs[BENCH_WINDOW_MAX];
+	const benchSampleT*	w;
+	time_f			median, limit, weight;
+	int			age, m, i, k;
+
+	m = 0;
+	for ( age=from; age<to; age++ )
+	{
+		w = &window[(newest + n - age) % n];
+		if ( w->used )
+			used[m++] = *w;
+	}
+	if ( m == 0 )
+		return 0;
+	qsort ( used, m, sizeof(benchSampleT), benchCompareSample );
+
+	median = used[m/2].offset;
+	for ( i=0; i<m; i++ )
+		devs[i] = fabs ( used[i].offset - median );
+	qsort ( devs, m, sizeof(time_f), benchCompareTimef );
+	limit = fmax ( BENCH_OUTLIER_LIMIT * 1.4826 * devs[m/2], BENCH_MIN_STAMP_ERR );
+
+	memset ( h, 0, sizeof(*h) );
+	k = 0;
+	for ( i=0; i<m; i++ )
+	{
+		if ( used[i].offset < median - limit || used[i].offset >= median + limit )
+			continue;
+		inliers[k++] = used[i];
+		weight = 1.0 / (used[i].err * used[i].err / 12 + BENCH_MIN_STAMP_ERR * BENCH_MIN_STAMP_ERR);
+		h->w += weight;
+		h->wx += weight * used[i].offset;
+		h->wt += weight * used[i].t;
+	}
+	h->count = k;
+
+	return k;
+}
+
+//the pps average worked out as clkCalculatePPSAverage() does, but as it would be by sorting: each
+//half of the window copied and sorted for its median, and its distances from that sorted for the
+//median absolute deviation - the samples within the limit either side averaged for each half's
+//middle, the line through the two, and another pass for the spread from it. the average's the
+//line's offset at the newest sample (the rate isn't averaged over windows, as clock.c's is)
+static int
+benchSortAverage ( benchSampleT* window, int n, int s, time_f* paverage, time_f* pspread )
+{
+	static benchSampleT	inold[BENCH_WINDOW_MAX], innew[BENCH_WINDOW_MAX];
+	benchHalfT		hold, hnew;
+	time_f			limit, b, tbar, xbar, a, dev, sq;
+	int			count, nold, nnew, i;
+
+	//(the new sample, and the one moving to the older half, left out by the limit as it is)
+	count = s < n ? s+1 : n;
+	limit = benchSortStampLimit ( window, count );
+	window[s % n].used = ( window[s % n].err <= limit );
+	if ( s >= n/2 )
+		window[(s - n/2) % n].used = ( window[(s - n/2) % n].err <= limit );
+
+	if ( s < n-1 )
+		return -1;
+
+	nold = benchSortHalf ( window, n, s % n, n/2, n, inold, &hold );
+	nnew = benchSortHalf ( window, n, s % n, 0, n/2, innew, &hnew );
+	if ( nold < 2 || nnew < 2 )
+		return -1;
+
+	b = (hnew.wx / hnew.w - hold.wx / hold.w) / (hnew.wt / hnew.w - hold.wt / hold.w);
+	tbar = (hold.wt + hnew.wt) / (hold.w + hnew.w);
+	xbar = (hold.wx + hnew.wx) / (hold.w + hnew.w);
+	a = xbar - b * tbar;
+
+	sq = 0;
+	for ( i=0; i<nold; i++ )
+	{
+		dev = inold[i].offset - a - b * inold[i].t;
+		sq += dev * dev;
+	}
+	for ( i=0; i<nnew; i++ )
+	{
+		dev = innew[i].offset - a - b * innew[i].t;
+		sq += dev * dev;
+	}
+
+	*paverage = a + b * window[s % n].t;
+	*pspread = sqrt ( sq / (nold + nnew) );
+	return 0;
+}
+
+//(re)put a sample in its half's window, out of the other's
+static void
+benchWindowPut ( windowT* half, windowT* other, int slot, const benchSampleT* sample, time_f limit )
+{
+	windowRemove ( other, slot );
+	if ( sample->err > limit )
+		windowRemove ( half, slot );
+	else
+		windowAdd ( half, slot, sample->offset, sample->t,
+			1.0 / (sample->err * sample->err / 12 + BENCH_MIN_STAMP_ERR * BENCH_MIN_STAMP_ERR) );
+}
+
+//a half's inliers - the ranks from *pfrom to *pto-1
+static void
+benchWindowInliers ( const windowT* half, int* pfrom, int* pto )
+{
+	time_f	median, limit;
+
+	median = windowMedian ( half );
+	limit = fmax ( BENCH_OUTLIER_LIMIT * 1.4826 * windowMAD ( half, median ), BENCH_MIN_STAMP_ERR );
+	*pfrom = windowRank ( half, median - limit );
+	*pto = windowRank ( half, median + limit );
+}
+
+//the same kept in windowTs, as clock.c does: the new sample added to the newer half's window,
+//replacing the one that's gone out of the window, and the one half a window old moved to the
+//older half's - then the median, MAD, ranks and sums for each half, without sorting anything
+static int
+benchWindowAverage ( windowT* old, windowT* new, windowT* errs, benchSampleT* window, int n, int s,
+	time_f* paverage, time_f* pspread )
+{
+	windowSumsT	sold, snew;
+	time_f		limit, b, tbar, xbar, a, spreadold, spreadnew;
+	int		oldfrom, oldto, newfrom, newto, nold, nnew;
+
+	windowAdd ( errs, s % n, window[s % n].err, 0, 1 );
+	limit = fmax ( BENCH_STAMP_ERR_LIMIT * windowMedian ( errs ), BENCH_MIN_STAMP_ERR );
+	benchWindowPut ( new, old, s % n, &window[s % n], limit );
+	if ( s >= n/2 )
+		benchWindowPut ( old, new, (s - n/2) % n, &window[(s - n/2) % n], limit );
+
+	if ( s < n-1 )
+		return -1;
+
+	benchWindowInliers ( old, &oldfrom, &oldto );
+	benchWindowInliers ( new, &newfrom, &newto );
+	nold = oldto - oldfrom;
+	nnew = newto - newfrom;
+	if ( nold < 2 || nnew < 2 )
+		return -1;
+
+	windowSums ( old, oldfrom, oldto, &sold );
+	windowSums ( new, newfrom, newto, &snew );
+	b = (snew.wx / snew.w - sold.wx / sold.w) / (snew.wt / snew.w - sold.wt / sold.w);
+	tbar = (sold.wt + snew.wt) / (sold.w + snew.w);
+	xbar = (sold.wx + snew.wx) / (sold.w + snew.w);
+	a = xbar - b * tbar;
+
+	spreadold = windowSpread ( old, oldfrom, oldto, a, b );
+	spreadnew = windowSpread ( new, newfrom, newto, a, b );
+
+	*paverage = a + b * window[s % n].t;
+	*pspread = sqrt ( (nold * spreadold * spreadold + nnew * spreadnew * spreadnew) / (nold + nnew) );
+	return 0;
+}
+
+//an average every second over a window of n seconds' samples (the receiver delay, the pc's clock
+//drifting, 3ms of jitter with the odd sample 2-15ms late, timestamp errors of 5-20us with the odd
+//wide one), each way - the time each takes a second, and the most they differ by
+static void
+benchWindow ( int n )
+{
+	static benchSampleT	window[BENCH_WINDOW_MAX];
+	windowT		old, new, errs;
+	clock_t		sortcpu, windowcpu, t;
+	time_f		sortavg, sortspread, avg, spread, avgdiff, spreaddiff;
+	int		s, sortret, windowret;
+
+	windowInit ( &old, n );
+	windowInit ( &new, n );
+	windowInit ( &errs, n );
+	benchSeed = 1;
+
+	sortcpu = windowcpu = 0;
+	avg = spread = sortavg = sortspread = 0;
+	avgdiff = spreaddiff = 0;
+	for ( s=0; s<n+BENCH_WINDOW_SECONDS; s++ )
+	{
+		window[s % n].t = s;
+		window[s % n].offset = BENCH_DELAY + BENCH_WINDOW_DRIFT * s + 0.003 * benchGauss ();
+		if ( benchUniform () < 0.01 )
+			window[s % n].offset += 0.002 + 0.013 * benchUniform ();
+		window[s % n].err = 0.000005 + 0.000005 * fmin ( fabs ( benchGauss () ), 3.0 );
+		if ( benchUniform () < 0.01 )
+			window[s % n].err += 0.001;
+
+		t = clock();
+		windowret = benchWindowAverage ( &old, &new, &errs, window, n, s, &avg, &spread );
+		if ( s >= n )
+			windowcpu += clock() - t;
+
+		t = clock();
+		sortret = benchSortAverage ( window, n, s, &sortavg, &sortspread );
+		if ( s >= n )
+			sortcpu += clock() - t;
+
+		if ( s < n || sortret != windowret )
+		{
+			if ( s >= n )
+				avgdiff = spreaddiff = INFINITY;	//(one had an average, the other didn't)
+			continue;
+		}
+		if ( sortret < 0 )
+			continue;
+
+		avgdiff = fmax ( avgdiff, fabs ( avg - sortavg ) );
+		spreaddiff = fmax ( spreaddiff, fabs ( spread - sortspread ) );
+	}
+
+	printf ( "%6d  %9.2fus  %9.2fus  %7.1fx  %8.3fns  %8.3fns\n", n,
+		(double)sortcpu / CLOCKS_PER_SEC / BENCH_WINDOW_SECONDS * 1e6,
+		(double)windowcpu / CLOCKS_PER_SEC / BENCH_WINDOW_SECONDS * 1e6,
+		windowcpu > 0 ? (double)sortcpu / windowcpu : 0.0, avgdiff * 1e9, spreaddiff * 1e9 );
+
+	windowFree ( &old );
+	windowFree ( &new );
+	windowFree ( &errs );
+}
+
+//run the audio detector over a keyed tone with noise (sd a fraction of the carrier) -
+//reports how the edges it finds compare to the ones keyed, and its speed
+static void
+benchAudio ( double noisefrac )
+{
+	static double	truth[BENCH_AUDIO_MAX_EDGES];
+	static int	truthlevel[BENCH_AUDIO_MAX_EDGES];
+	static double	found[BENCH_AUDIO_MAX_EDGES];
+	static int	foundlevel[BENCH_AUDIO_MAX_EDGES];
+	short		x[AUDIO_BLOCK];
+	audioEdgeT	edges[64];
+	audioDetT	det;
+	clock_t		cpu, t;
+	double		sum, sumsq;
+	long		i, total;
+	int		numtruth, numfound, e, n, j, k, level, matched;
+
+	numtruth = benchKeyedEdges ( truth, truthlevel, BENCH_AUDIO_SECONDS, BENCH_AUDIO_RATE );
+
+	audioDetInit ( &det, BENCH_AUDIO_RATE );
+	benchSeed = 1;
+
+	total = (long)BENCH_AUDIO_SECONDS * BENCH_AUDIO_RATE;
+	numfound = 0;
+	cpu = 0;
+	level = 1;
+	e = 0;
+
+	for ( i=0; i<total; i+=AUDIO_BLOCK )
+	{
+		n = total - i < AUDIO_BLOCK ? total - i : AUDIO_BLOCK;
+
+		for ( j=0; j<n; j++ )
+		{
+			while ( e < numtruth && truth[e] <= i+j )
+				level = truthlevel[e++];
+
+			x[j] = (short)lrint ( (level ? BENCH_AUDIO_HIGH : BENCH_AUDIO_LOW) * sin ( 2 * M_PI * BENCH_AUDIO_TONE * (i+j) / BENCH_AUDIO_RATE )
+				+ noisefrac * BENCH_AUDIO_HIGH * benchGauss () );
+		}
+
+		t = clock();
+		k = audioDetect ( &det, x, n, edges, 64 );
+		cpu += clock() - t;
+
+		for ( j=0; j<k && numfound < BENCH_AUDIO_MAX_EDGES; j++ )
+		{
+			found[numfound] = edges[j].pos;
+			foundlevel[numfound++] = edges[j].level;
+		}
+	}
+
+	matched = benchMatchEdges ( truth, truthlevel, numtruth, found, foundlevel, numfound, BENCH_AUDIO_RATE, &sum, &sumsq );
+
+	printf ( "%5.2f  %7d  %6d  %6d  %8.1fus  %8.1fus  %8.1f\n", noisefrac, numtruth, numtruth - matched, numfound - matched,
+		matched > 0 ? sum / matched * 1e6 : 0.0, matched > 0 ? sqrt ( sumsq / matched ) * 1e6 : 0.0,
+		cpu > 0 ? total / ((double)cpu / CLOCKS_PER_SEC) / 1e6 : 0.0 );
+}
+
+//the same for the iq front end: u8 samples with DCF77 keyed 7.5kHz above the centre (and its
+//phase modulation), MSF steady 10kHz below it, noise (sd a fraction of the DCF77 carrier, on
+//each of i and q) and the rounding to 8 bits. with pm, reports the phase modulation
+//correlator's seconds instead of the edges
+static void
+benchIQ ( double noisefrac, int pm )
+{
+	static double	truth[BENCH_AUDIO_MAX_EDGES];
+	static int	truthlevel[BENCH_AUDIO_MAX_EDGES];
+	static double	found[BENCH_AUDIO_MAX_EDGES];
+	static int	foundlevel[BENCH_AUDIO_MAX_EDGES];
+	static unsigned char	x[IQ_BLOCK*2];
+	audioEdgeT	edges[64];
+	iqInT*		in;
+	clock_t		cpu, t;
+	double		sum, sumsq, amp, v, dre, dim, mre, mim, r;
+	double		drotre, drotim, mrotre, mrotim;
+	double		pmchip, pmre, pmim, u, diff;
+	signed char	chips[PM_CHIPS];
+	int		bits[BENCH_IQ_SECONDS], haspm[BENCH_IQ_SECONDS];
+	int		pmexpected, pmfound, pmwrong;
+	long		i, total, sec;
+	int		numtruth, numfound, e, n, block, j, k, level, matched;
+
+	numtruth = benchKeyedEdges ( truth, truthlevel, BENCH_IQ_SECONDS, BENCH_IQ_RATE );
+
+	//each second's bit, from the length of its carrier reduction (none in second 59)
+	memset ( haspm, 0, sizeof(haspm) );
+	pmexpected = 0;
+	for ( e=0; e+1<numtruth; e++ )
+	{
+		sec = lround ( truth[e] / BENCH_IQ_RATE );
+		if ( truthlevel[e] == 0 && sec < BENCH_IQ_SECONDS )
+		{
+			bits[sec] = ( truth[e+1] - truth[e] > 0.15 * BENCH_IQ_RATE );
+			haspm[sec] = 1;
+			pmexpected++;
+		}
+	}
+	pmSequence ( chips );
+	pmchip = (double)BENCH_IQ_RATE * PM_CHIP_CYCLES / PM_CARRIER;
+
+	in = iqOpen ( -1, BENCH_IQ_RATE, BENCH_IQ_CENTRE );
+	iqUseCarrier ( in, 77500 );
+	if ( pm )
+		iqUsePM ( in, 77500 );
+	benchSeed = 1;
+
+	pmfound = 0;
+	pmwrong = 0;
+	sum = 0;
+	sumsq = 0;
+
+	//(whole boxcar sums per call, as iqRead() does)
+	block = IQ_BLOCK / in->decim1 * in->decim1;
+	total = (long)BENCH_IQ_SECONDS * BENCH_IQ_RATE;
+	numfound = 0;
+	cpu = 0;
+	level = 1;
+	e = 0;
+
+	//the carriers, as phasors stepped each sample
+	drotre = cos ( 2 * M_PI * (77500 - BENCH_IQ_CENTRE) / (double)BENCH_IQ_RATE );
+	drotim = sin ( 2 * M_PI * (77500 - BENCH_IQ_CENTRE) / (double)BENCH_IQ_RATE );
+	mrotre = cos ( 2 * M_PI * (60000 - BENCH_IQ_CENTRE) / (double)BENCH_IQ_RATE );
+	mrotim = sin ( 2 * M_PI * (60000 - BENCH_IQ_CENTRE) / (double)BENCH_IQ_RATE );
+	dre = 1;
+	dim = 0;
+	mre = 1;
+	mim = 0;
+
+	for ( i=0; i<total; i+=block )
+	{
+		n = total - i < block ? total - i : block;
+
+		for ( j=0; j<n; j++ )
+		{
+			while ( e < numtruth && truth[e] <= i+j )
+				level = truthlevel[e++];
+			amp = level ? BENCH_IQ_HIGH : BENCH_IQ_LOW;
+
+			//the chip being sent, if any
+			sec = (i+j) / BENCH_IQ_RATE;
+			u = (i+j) - sec * BENCH_IQ_RATE - PM_START * BENCH_IQ_RATE;
+			pmre = 1;
+			pmim = 0;
+			if ( haspm[sec] && u >= 0 && u < PM_CHIPS * pmchip )
+			{
+				pmre = cos ( BENCH_IQ_PM * M_PI / 180 );
+				pmim = sin ( BENCH_IQ_PM * M_PI / 180 ) * chips[(int)(u / pmchip)] * ( bits[sec] ? -1 : 1 );
+			}
+
+			v = 127.5 + amp * (dre * pmre - dim * pmim) + BENCH_IQ_MSF * mre + noisefrac * BENCH_IQ_HIGH * benchGauss ();
+			x[2*j] = v < 0 ? 0 : v > 255 ? 255 : (unsigned char)lrint ( v );
+			v = 127.5 + amp * (dre * pmim + dim * pmre) + BENCH_IQ_MSF * mim + noisefrac * BENCH_IQ_HIGH * benchGauss ();
+			x[2*j+1] = v < 0 ? 0 : v > 255 ? 255 : (unsigned char)lrint ( v );
+
+			r = dre * drotre - dim * drotim;
+			dim = dre * drotim + dim * drotre;
+			dre = r;
+			r = mre * mrotre - mim * mrotim;
+			mim = mre * mrotim + mim * mrotre;
+			mre = r;
+		}
+
+		//(keep the phasors from drifting off the unit circle)
+		r = sqrt ( dre * dre + dim * dim );
+		dre /= r;
+		dim /= r;
+		r = sqrt ( mre * mre + mim * mim );
+		mre /= r;
+		mim /= r;
+
+		t = clock();
+		k = iqProcess ( in, x, n, edges, 64 );
+		cpu += clock() - t;
+
+		for ( j=0; j<k && numfound < BENCH_AUDIO_MAX_EDGES; j++ )
+		{
+			found[numfound] = edges[j].pos;
+			foundlevel[numfound++] = edges[j].level;
+		}
+
+		//(the seconds start on whole seconds of samples)
+		for ( j=0; j<in->numpm; j++ )
+		{
+			sec = lround ( in->pm[j].pos / BENCH_IQ_RATE );
+			if ( sec < 0 || sec >= BENCH_IQ_SECONDS || !haspm[sec] )
+				continue;
+
+			diff = in->pm[j].pos / BENCH_IQ_RATE - sec;
+			sum += diff;
+			sumsq += diff * diff;
+			pmfound++;
+			if ( in->pm[j].bit != bits[sec] )
+				pmwrong++;
+		}
+	}
+
+	v = cpu > 0 ? total / ((double)cpu / CLOCKS_PER_SEC) / 1e6 : 0.0;
+
+	if ( pm )
+	{
+		printf ( "%5.2f  %7d  %6d  %6d  %8.2fus  %8.2fus  %8.1f  %5.1f%%\n", noisefrac, pmexpected, pmexpected - pmfound, pmwrong,
+			pmfound > 0 ? sum / pmfound * 1e6 : 0.0, pmfound > 0 ? sqrt ( sumsq / pmfound ) * 1e6 : 0.0,
+			v, v > 0 ? 100 * 2.4 / v : 0.0 );
+		iqClose ( in );
+		return;
+	}
+
+	matched = benchMatchEdges ( truth, truthlevel, numtruth, found, foundlevel, numfound, BENCH_IQ_RATE, &sum, &sumsq );
+
+	printf ( "%5.2f  %7d  %6d  %6d  %8.1fus  %8.1fus  %8.1f  %5.1f%%\n", noisefrac, numtruth, numtruth - matched, numfound - matched,
+		matched > 0 ? sum / matched * 1e6 : 0.0, matched > 0 ? sqrt ( sumsq / matched ) * 1e6 : 0.0,
+		v, v > 0 ? 100 * 2.4 / v : 0.0 );
+
+	iqClose ( in );	//(close(-1) - harmless)
+}
+
+int
+main ( int argc, char** argv )
+{
+	static const struct
+	{
+		int	type;
+		char*	name;
+	} stations[] =
+	{
+		{ CLOCKTYPE_DCF77, "DCF77" },
+		{ CLOCKTYPE_MSF, "MSF" },
+		{ CLOCKTYPE_WWVB, "WWVB" },
+	};
+	static const time_f	skews[] = { -0.060, -0.030, 0.030, 0.060 };
+	static const int	windows[] = { 0, 5, 10, 30 };
+	static const time_f	outages[] = { 60, 180, 600 };
+	static const int	windowsizes[] = { 60, 300, 900, 3600 };
+	static const int	averages[] = { 60, 300, 900 };
+	//(nothing steers the pc's clock here - much past 40ppm, its offset's past clock.c's
+	//PPS_MAX_OFFSET before the runs end)
+	static const time_f	drifts[] = { 0, 10e-6, 40e-6 };
+	static const time_f	lates[] = { 0, 0.01, 0.05, 0.10 };
+	static const time_f	polljitters[] = { 0.001, 0.003, 0.010 };
+	static const int	loopreceivers[] = { 1, 4, 8 };
+	synthNoiseT	noise;
+	char		label[16];
+	int		s, level, k, bracket, defaultvote, defaultaverage;
+
+	(void)argc;
+	(void)argv;
+
+	//quiet, and keep away from ntpd's shared memory
+	loggerSetFile ( NULL, 0 );
+	loggerSyslog ( 0, 0 );
+	debugLevel = 1;
+
+	printf ( "radioclkd2 decode benchmark - %d runs of %d minutes for each noise level\n", BENCH_RUNS, BENCH_MINUTES );
+	printf ( "noise level n: n*3ms edge jitter (sd), n*0.2%% of seconds lost, n*0.5%% of seconds with a glitch\n" );
+	printf ( "offset error is from the %.0fms receiver delay, rms - for the minutes decoded, and for the times\n", BENCH_DELAY * 1000 );
+	printf ( "sent to ntpd each second (those sent for the wrong second counted, and left out of theirs)\n\n" );
+
+	printf ( "station  noise  decoded   wrong  first fix  offset err  seconds   wrong  second err   edges/s\n" );
+
+	for ( s=0; s<(int)(sizeof(stations)/sizeof(stations[0])); s++ )
+	{
+		for ( level=0; level<BENCH_LEVELS; level++ )
+		{
+			benchNoise ( level, &noise );
+			snprintf ( label, sizeof(label), "%d", level );
+			benchStation ( stations[s].type, stations[s].name, &noise, level, label );
+		}
+		printf ( "\n" );
+	}
+
+	printf ( "receivers that stretch (or shorten) the carrier reductions - noise level %d as well\n\n", BENCH_SKEW_LEVEL );
+	printf ( "station   skew  decoded   wrong  first fix  offset err  seconds   wrong  second err   edges/s\n" );
+
+	for ( s=0; s<(int)(sizeof(stations)/sizeof(stations[0])); s++ )
+	{
+		for ( k=0; k<(int)(sizeof(skews)/sizeof(skews[0])); k++ )
+		{
+			benchNoise ( BENCH_SKEW_LEVEL, &noise );
+			noise.skew = skews[k];
+			snprintf ( label, sizeof(label), "%+.0fms", skews[k] * 1000 );
+			benchStation ( stations[s].type, stations[s].name, &noise, BENCH_SKEW_LEVEL, label );
+		}
+		printf ( "\n" );
+	}
+
+	printf ( "voting each minute with the ones before it (up to the window) - noise level %d\n\n", BENCH_VOTE_LEVEL );
+	printf ( "station window decoded   wrong  first fix  offset err  seconds   wrong  second err   edges/s\n" );
+
+	defaultvote = voteMinutes;
+	for ( s=0; s<(int)(sizeof(stations)/sizeof(stations[0])); s++ )
+	{
+		for ( k=0; k<(int)(sizeof(windows)/sizeof(windows[0])); k++ )
+		{
+			benchNoise ( BENCH_VOTE_LEVEL, &noise );
+			voteMinutes = windows[k];
+			snprintf ( label, sizeof(label), "%dmin", windows[k] );
+			benchStation ( stations[s].type, stations[s].name, &noise, BENCH_VOTE_LEVEL, label );
+		}
+		printf ( "\n" );
+	}
+	voteMinutes = defaultvote;
+
+	printf ( "(* - not every run got a fix, the first fix is averaged over the ones that did)\n\n" );
+
+	printf ( "holdover - the signal gone %d minutes in, %d runs of %d minutes with the pc's clock %+.0fppm out,\n",
+		BENCH_HOLDOVER_START / 60, BENCH_RUNS, BENCH_HOLDOVER_MINUTES, BENCH_DRIFT * 1e6 );
+	printf ( "noise level %d - the times sent from the flywheel, their error, and the error they were sent with\n\n", BENCH_HOLDOVER_LEVEL );
+	printf ( "station outage    sent    rms err      worst   sent err\n" );
+
+	for ( s=0; s<(int)(sizeof(stations)/sizeof(stations[0])); s++ )
+	{
+		for ( k=0; k<(int)(sizeof(outages)/sizeof(outages[0])); k++ )
+		{
+			benchNoise ( BENCH_HOLDOVER_LEVEL, &noise );
+			noise.drift = BENCH_DRIFT;
+			noise.outage = outages[k];
+			noise.outagestart = BENCH_HOLDOVER_START;
+			snprintf ( label, sizeof(label), "%.0fmin", outages[k] / 60 );
+			benchHoldover ( stations[s].type, stations[s].name, &noise, label );
+		}
+		printf ( "\n" );
+	}
+
+	printf ( "pps average from the first decode - %d runs of %d minutes with the pc's clock %+.0fppm out, noise level %d,\n",
+		BENCH_RUNS, BENCH_ACQUIRE_MINUTES, BENCH_ACQUIRE_DRIFT * 1e6, BENCH_ACQUIRE_LEVEL );
+	printf ( "averaging over up to the window - the times sent each second, by how long after the first they\n" );
+	printf ( "were sent: their rms error and the error they were sent with (mean)\n\n" );
+	printf ( "station window   first min  sent err    1-5 min  sent err   5 min on  sent err\n" );
+
+	defaultaverage = averageSeconds;
+	for ( s=0; s<(int)(sizeof(stations)/sizeof(stations[0])); s++ )
+	{
+		for ( k=0; k<(int)(sizeof(averages)/sizeof(averages[0])); k++ )
+		{
+			benchNoise ( BENCH_ACQUIRE_LEVEL, &noise );
+			noise.drift = BENCH_ACQUIRE_DRIFT;
+			averageSeconds = averages[k];
+			snprintf ( label, sizeof(label), "%d", averages[k] );
+			benchAcquire ( stations[s].type, stations[s].name, &noise, label );
+		}
+		printf ( "\n" );
+	}
+	averageSeconds = defaultaverage;
+
+	printf ( "the pc's clock drifting - %d runs of %d minutes, noise level %d: the times sent each second from\n",
+		BENCH_RUNS, BENCH_SENT_MINUTES, BENCH_SENT_LEVEL );
+	printf ( "the first decode on (for the wrong second, and the others' rms error from the receiver delay and\n" );
+	printf ( "the drift), those sent without a pps average, the pps samples left out as outliers, and the rate\n" );
+	printf ( "estimated at the end (mean, and rms error from the drift)\n\n" );
+	printf ( "station  drift    sent   wrong    rms err  no avg  outliers      rate   rate err\n" );
+	for ( s=0; s<(int)(sizeof(stations)/sizeof(stations[0])); s++ )
+	{
+		for ( k=0; k<(int)(sizeof(drifts)/sizeof(drifts[0])); k++ )
+		{
+			benchNoise ( BENCH_SENT_LEVEL, &noise );
+			noise.drift = drifts[k];
+			snprintf ( label, sizeof(label), "%.0fppm", drifts[k] * 1e6 );
+			benchSent ( stations[s].type, stations[s].name, &noise, label );
+		}
+		printf ( "\n" );
+	}
+
+	printf ( "late timestamps (a late wakeup, a preempted status read) - the same, with the pc's clock %+.0fppm\n",
+		BENCH_WINDOW_DRIFT * 1e6 );
+	printf ( "out, and this many of the edges timestamped 2-15ms late\n\n" );
+	printf ( "station   late    sent   wrong    rms err  no avg  outliers      rate   rate err\n" );
+	for ( s=0; s<(int)(sizeof(stations)/sizeof(stations[0])); s++ )
+	{
+		for ( k=0; k<(int)(sizeof(lates)/sizeof(lates[0])); k++ )
+		{
+			benchNoise ( BENCH_SENT_LEVEL, &noise );
+			noise.drift = BENCH_WINDOW_DRIFT;
+			noise.late = lates[k];
+			snprintf ( label, sizeof(label), "%.0f%%", lates[k] * 100 );
+			benchSent ( stations[s].type, stations[s].name, &noise, label );
+		}
+		printf ( "\n" );
+	}
+
+	printf ( "slow status reads (preempted for 2-15ms) - the same, this many of the edges' reads slow, the\n" );
+	printf ( "stamp taken after the read (as before), or in the middle of the bracket round it with its\n" );
+	printf ( "length as the error (as serial.c does) - and so weighted, or left out, by the pps average\n\n" );
+	for ( s=0; s<(int)(sizeof(stations)/sizeof(stations[0])); s++ )
+	{
+		printf ( "%s\n", stations[s].name );
+		printf ( "stamp     slow    sent   wrong    rms err  no avg  outliers      rate   rate err\n" );
+		for ( k=0; k<(int)(sizeof(lates)/sizeof(lates[0])); k++ )
+		{
+			for ( bracket=0; bracket<2; bracket++ )
+			{
+				benchNoise ( BENCH_SENT_LEVEL, &noise );
+				noise.drift = BENCH_WINDOW_DRIFT;
+				noise.slowread = lates[k];
+				noise.bracket = bracket;
+				snprintf ( label, sizeof(label), "%.0f%%", lates[k] * 100 );
+				benchSent ( stations[s].type, bracket ? "bracket" : "after", &noise, label );
+			}
+		}
+		printf ( "\n" );
+	}
+
+	printf ( "pps average - worked out every second over a sliding window of samples, as clock.c does (a\n" );
+	printf ( "line through the halves' middles, each half's outliers left out by the median absolute\n" );
+	printf ( "deviation): sorting each half for its median and MAD, against keeping them in order as samples\n" );
+	printf ( "come and go (window.c) - the time per second each way, and the most their averages (and\n" );
+	printf ( "spreads) differ\n\n" );
+	printf ( "window       sort     window  speedup  avg diff  spread diff\n" );
+	for ( k=0; k<(int)(sizeof(windowsizes)/sizeof(windowsizes[0])); k++ )
+		benchWindow ( windowsizes[k] );
+	printf ( "\n" );
+
+	printf ( "the main loop (one process, poll()ing every device - and a waiter thread for each one that\n" );
+	printf ( "can't be) against a process per device (old), with pipes for the devices: edges waited for\n" );
+	printf ( "(iwait, an edge every %.0fms, on every receiver at once) or polled every 1ms - the wakeups\n",
+		BENCH_LOOP_PERIOD * 1000 );
+	printf ( "(voluntary context switches) and cpu time for each receiver, a second, and for the edges\n" );
+	printf ( "waited for, the system calls made for each, and how long from its being sent to its dispatch\n" );
+	printf ( "(to clkProcessStatusChange()) - mean and worst\n\n" );
+	printf ( "receivers  device   loop     wakeups/s      cpu us/s  syscalls/edge      latency    worst lat\n" );
+	for ( k=0; k<(int)(sizeof(loopreceivers)/sizeof(loopreceivers[0])); k++ )
+	{
+		benchLoop ( loopreceivers[k], 0, 1 );
+		benchLoop ( loopreceivers[k], 0, 0 );
+		benchLoop ( loopreceivers[k], 1, 1 );
+		benchLoop ( loopreceivers[k], 1, 0 );
+	}
+	printf ( "\n" );
+
+	printf ( "poll mode - %ds of a DCF77 style line, edges +-jitter, sampled every %.0fms as it used to be (old)\n",
+		BENCH_POLL_SECONDS, BENCH_POLL_OLD * 1000 );
+	printf ( "or densely only in windows around the edges learned (pollsched.c) - samples and syscalls per\n" );
+	printf ( "second, and the edges seen in a window (or by the old loop) and by the slow sampling, and how\n" );
+	printf ( "late (the first %ds are left out, while the edges are learned)\n\n", BENCH_POLL_SETTLE );
+	printf ( " jitter  sampling  samples/s  syscalls/s  window  mean late   max late    slow   max late\n" );
+	for ( k=0; k<(int)(sizeof(polljitters)/sizeof(polljitters[0])); k++ )
+	{
+		benchPoll ( polljitters[k], 1 );
+		benchPoll ( polljitters[k], 0 );
+	}
+	printf ( "\n" );
+
+	printf ( "audio edge detector - %ds of DCF77 as a %.0fHz keyed tone at %dHz, with gaussian noise\n",
+		BENCH_AUDIO_SECONDS, BENCH_AUDIO_TONE, BENCH_AUDIO_RATE );
+	printf ( "(noise sd as a fraction of the carrier, the first %.0fs are for the detector to settle)\n\n", 2.0 );
+	printf ( "noise    edges  missed   extra  mean err    rms err   Msamples/s\n" );
+	benchAudio ( 0.0 );
+	benchAudio ( 0.1 );
+	benchAudio ( 0.3 );
+	benchAudio ( 0.5 );
+	benchAudio ( 1.0 );
+
+	printf ( "\niq front end - %ds of DCF77 at %dHz in 8 bit iq, %d samples/s centred on %dHz,\n",
+		BENCH_IQ_SECONDS, 77500, BENCH_IQ_RATE, BENCH_IQ_CENTRE );
+	printf ( "with MSF's carrier at 60000Hz and gaussian noise (sd a fraction of the carrier)\n" );
+	printf ( "(cpu is the share of one core it would take at 2.4M samples/s, on this machine)\n\n" );
+	printf ( "noise    edges  missed   extra  mean err    rms err   Msamples/s   cpu\n" );
+	benchIQ ( 0.0, 0 );
+	benchIQ ( 0.3, 0 );
+	benchIQ ( 1.0, 0 );
+	benchIQ ( 2.0, 0 );
+
+	printf ( "\nDCF77 phase modulation correlator - the same signal (%.1f degrees of phase modulation),\n", BENCH_IQ_PM );
+	printf ( "the seconds' starts it finds and their bits, the carrier's edge detector still running\n\n" );
+	printf ( "noise  seconds  missed   wrong  mean err    rms err   Msamples/s   cpu\n" );
+	benchIQ ( 0.0, 1 );
+	benchIQ ( 1.0, 1 );
+	benchIQ ( 3.0, 1 );
+	benchIQ ( 6.0, 1 );
+	benchIQ ( 10.0, 1 );
+
+	return 0;
+}
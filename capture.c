@@ -0,0 +1,506 @@
+/*
+ * Copyright (c) 2002 Jon Atkins http://www.jonatkins.com/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "capture.h"
+#include "logger.h"
+#include "memory.h"
+
+
+//the edges are captured from the main loop, which mustn't wait on the disk (and
+//O_NONBLOCK does nothing for a file) - so the records are buffered, and a thread writes
+//them out. if the buffer fills before it's caught up, records are dropped
+#define	CAP_BUFFER_SIZE	(64*1024)
+#define	CAP_FLUSH_SIZE	(4096)
+
+static int		capfd = -1;
+static unsigned char	capbuf[CAP_BUFFER_SIZE];
+static int		caplen;
+static unsigned long	capdropped;
+
+static pthread_t	capthread;
+static pthread_mutex_t	capmutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	capcond = PTHREAD_COND_INITIALIZER;
+static unsigned char	capout[CAP_BUFFER_SIZE];	//(the writer's - what it took from capbuf)
+static int		capstarted;	//(the writer's running - see capStart())
+static int		capstop;
+static int		caperror;	//the errno the writer stopped on
+
+static int		capnumdevs;
+static char		capdevs[CAP_MAX_DEVS][64];
+
+
+static void
+capPut32 ( unsigned char* p, unsigned int v )
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static void
+capPut64 ( unsigned char* p, int64_t v )
+{
+	capPut32 ( p, (unsigned int)v );
+	capPut32 ( p+4, (unsigned int)((uint64_t)v >> 32) );
+}
+
+static unsigned int
+capGet32 ( const unsigned char* p )
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static int64_t
+capGet64 ( const unsigned char* p )
+{
+	return (int64_t)( capGet32(p) | ((uint64_t)capGet32(p+4) << 32) );
+}
+
+
+//returns -1 if the record had to be dropped
+static int
+capAppend ( const unsigned char* data, int len )
+{
+	int	ret = 0;
+
+	pthread_mutex_lock ( &capmutex );
+
+	if ( caplen + len > CAP_BUFFER_SIZE || caperror )
+	{
+		capdropped++;
+		ret = -1;
+	}
+	else
+	{
+		memcpy ( capbuf + caplen, data, len );
+		caplen += len;
+
+		if ( caplen >= CAP_FLUSH_SIZE )
+			pthread_cond_signal ( &capcond );
+	}
+
+	pthread_mutex_unlock ( &capmutex );
+
+	return ret;
+}
+
+//takes what's buffered and writes it, until capClose() - or a write fails
+static void*
+capWriteThread ( void* arg )
+{
+	int	len, done, n;
+
+	(void)arg;
+
+	pthread_mutex_lock ( &capmutex );
+	for ( ;; )
+	{
+		while ( caplen == 0 && !capstop )
+			pthread_cond_wait ( &capcond, &capmutex );
+		if ( caplen == 0 )
+			break;
+
+		len = caplen;
+		memcpy ( capout, capbuf, len );
+		caplen = 0;
+		pthread_mutex_unlock ( &capmutex );
+
+		for ( done=0; done<len; done+=n )
+		{
+			n = write ( capfd, capout + done, len - done );
+			if ( n < 0 && errno == EINTR )
+				n = 0;
+			else if ( n <= 0 )
+				break;
+		}
+
+		pthread_mutex_lock ( &capmutex );
+		if ( done < len )
+		{
+			caperror = ( n < 0 ) ? errno : ENOSPC;
+			break;
+		}
+	}
+	pthread_mutex_unlock ( &capmutex );
+
+	return NULL;
+}
+
+//find the device's index in the capture, writing a device record the first time - the
+//device is only known once its record is buffered (a reader rejects edges before it), so
+//if that's dropped this returns -1, and the next edge tries again
+static int
+capDevIndex ( const char* dev, int mode )
+{
+	unsigned char	rec[CAP_RECORD_SIZE + 64];
+	int		i, len;
+
+	for ( i=0; i<capnumdevs; i++ )
+	{
+		if ( strcmp ( capdevs[i], dev ) == 0 )
+			return i;
+	}
+
+	len = strlen ( dev );
+	if ( capnumdevs >= CAP_MAX_DEVS || len >= 64 )
+		return -1;
+
+	memset ( rec, 0, sizeof(rec) );
+	rec[0] = CAP_REC_DEVICE;
+	rec[1] = capnumdevs;
+	rec[3] = mode;
+	capPut32 ( rec+4, len );
+	memcpy ( rec + CAP_RECORD_SIZE, dev, len );
+
+	if ( capAppend ( rec, CAP_RECORD_SIZE + (len + CAP_RECORD_SIZE-1) / CAP_RECORD_SIZE * CAP_RECORD_SIZE ) < 0 )
+		return -1;
+
+	strcpy ( capdevs[capnumdevs], dev );
+	return capnumdevs++;
+}
+
+
+int
+capOpen ( char* file )
+{
+	unsigned char	header[CAP_HEADER_SIZE];
+
+	capfd = open ( file, O_WRONLY|O_CREAT|O_TRUNC, 0644 );
+	if ( capfd < 0 )
+	{
+		loggerf ( LOGGER_NOTE, "Error: can't open capture file %s: %d\n", file, errno );
+		return -1;
+	}
+
+	caplen = 0;
+	capdropped = 0;
+	capnumdevs = 0;
+	capstarted = 0;
+	capstop = 0;
+	caperror = 0;
+
+	memset ( header, 0, sizeof(header) );
+	memcpy ( header, CAP_MAGIC, 8 );
+	capPut32 ( header+8, CAP_VERSION );
+	capAppend ( header, sizeof(header) );
+
+	loggerf ( LOGGER_INFO, "capturing edges to %s\n", file );
+
+	return 0;
+}
+
+int
+capStart ( void )
+{
+	if ( capfd < 0 || capstarted )
+		return 0;
+
+	if ( pthread_create ( &capthread, NULL, capWriteThread, NULL ) != 0 )
+	{
+		loggerf ( LOGGER_NOTE, "Error: failed to start capture writer thread - capture stopped\n" );
+		close ( capfd );
+		capfd = -1;
+		return -1;
+	}
+	capstarted = 1;
+
+	return 0;
+}
+
+void
+capEdge ( const char* dev, int mode, int line, int level, int lost, const timeStampT* ts )
+{
+	unsigned char	rec[CAP_RECORD_SIZE];
+	int		index;
+	time_ns		err;
+
+	if ( capfd < 0 )
+		return;
+
+	index = capDevIndex ( dev, mode );
+	if ( index < 0 )
+		return;
+
+	err = time_f2time_ns ( ts->err );
+	if ( err > 0xffffffffLL )
+		err = 0xffffffffLL;
+
+	memset ( rec, 0, sizeof(rec) );
+	rec[0] = CAP_REC_EDGE;
+	rec[1] = index;
+	rec[2] = ( level != 0 );
+	capPut32 ( rec+4, line );
+	capPut32 ( rec+8, lost );
+	capPut32 ( rec+12, (unsigned int)err );
+	capPut64 ( rec+16, ts->real );
+	capPut64 ( rec+24, ts->mono );
+
+	capAppend ( rec, sizeof(rec) );
+}
+
+void
+capFlush ( void )
+{
+	unsigned long	dropped;
+	int		error;
+
+	if ( capfd < 0 )
+		return;
+
+	pthread_mutex_lock ( &capmutex );
+	if ( caplen > 0 )
+		pthread_cond_signal ( &capcond );
+	dropped = capdropped;
+	capdropped = 0;
+	error = caperror;
+	pthread_mutex_unlock ( &capmutex );
+
+	if ( error )
+	{
+		loggerf ( LOGGER_NOTE, "Error: writing capture failed: %d - capture stopped\n", error );
+		capClose ();
+		return;
+	}
+
+	if ( dropped )
+		loggerf ( LOGGER_INFO, "warning: capture too slow - %lu edges dropped\n", dropped );
+}
+
+//(waits for the writer to write out what's buffered - or writes it here, if it never started)
+void
+capClose ( void )
+{
+	if ( capfd < 0 )
+		return;
+
+	pthread_mutex_lock ( &capmutex );
+	capstop = 1;
+	pthread_cond_signal ( &capcond );
+	pthread_mutex_unlock ( &capmutex );
+
+	if ( capstarted )
+		pthread_join ( capthread, NULL );
+	else
+		capWriteThread ( NULL );
+	capstarted = 0;
+
+	close ( capfd );
+	capfd = -1;
+}
+
+
+capReaderT*
+capOpenRead ( char* file )
+{
+	capReaderT*	cap;
+	unsigned char	header[CAP_HEADER_SIZE];
+	int		fd;
+
+	fd = open ( file, O_RDONLY );
+	if ( fd < 0 )
+	{
+		loggerf ( LOGGER_NOTE, "Error: can't open capture file %s: %d\n", file, errno );
+		return NULL;
+	}
+
+	if ( read ( fd, header, sizeof(header) ) != sizeof(header)
+	  || memcmp ( header, CAP_MAGIC, 8 ) != 0 )
+	{
+		loggerf ( LOGGER_NOTE, "Error: %s is not a capture file\n", file );
+		close ( fd );
+		return NULL;
+	}
+
+	if ( capGet32 ( header+8 ) != CAP_VERSION )
+	{
+		loggerf ( LOGGER_NOTE, "Error: %s: unknown capture version %u\n", file, capGet32 ( header+8 ) );
+		close ( fd );
+		return NULL;
+	}
+
+	cap = safe_mallocz ( sizeof(capReaderT) );
+	cap->fd = fd;
+
+	return cap;
+}
+
+capReaderT*
+capAttach ( int fd )
+{
+	capReaderT*	cap;
+
+	cap = safe_mallocz ( sizeof(capReaderT) );
+	cap->fd = fd;
+	cap->stream = 1;
+	cap->needheader = 1;
+
+	return cap;
+}
+
+int
+capPending ( capReaderT* cap )
+{
+	return cap->len - cap->pos >= CAP_RECORD_SIZE;
+}
+
+//make sure there are len bytes buffered - returns 0 at the end of the file
+static int
+capFill ( capReaderT* cap, int len )
+{
+	int	n;
+
+	if ( cap->len - cap->pos >= len )
+		return 1;
+
+	memmove ( cap->buf, cap->buf + cap->pos, cap->len - cap->pos );
+	cap->len -= cap->pos;
+	cap->pos = 0;
+
+	//(a stream may have sent part of a record - what's buffered is kept for next time)
+	while ( cap->len < len )
+	{
+		cap->reads++;
+		n = read ( cap->fd, cap->buf + cap->len, sizeof(cap->buf) - cap->len );
+		if ( n < 0 && errno == EINTR )
+			continue;
+		if ( n <= 0 )
+			return n;
+		cap->len += n;
+	}
+
+	return 1;
+}
+
+int
+capRead ( capReaderT* cap, capRecordT* rec )
+{
+	unsigned char*	p;
+	int		ret, index, len;
+
+	if ( cap->needheader )
+	{
+		ret = capFill ( cap, CAP_HEADER_SIZE );
+		if ( ret <= 0 )
+			return ret;
+
+		p = cap->buf + cap->pos;
+		if ( memcmp ( p, CAP_MAGIC, 8 ) != 0 || capGet32 ( p+8 ) != CAP_VERSION )
+		{
+			errno = EINVAL;
+			return -1;
+		}
+		cap->pos += CAP_HEADER_SIZE;
+		cap->needheader = 0;
+	}
+
+	ret = capFill ( cap, CAP_RECORD_SIZE );
+	if ( ret <= 0 )
+		return ret;
+
+	p = cap->buf + cap->pos;
+
+	rec->type = p[0];
+	index = p[1];
+
+	errno = EINVAL;		//(for the errors below)
+
+	if ( index >= CAP_MAX_DEVS )
+		return -1;
+
+	switch ( rec->type )
+	{
+	case CAP_REC_DEVICE:
+		len = capGet32 ( p+4 );
+		if ( len >= 64 )
+			return -1;
+
+		//the whole record has to be there before any of it is used
+		ret = capFill ( cap, CAP_RECORD_SIZE + (len + CAP_RECORD_SIZE-1) / CAP_RECORD_SIZE * CAP_RECORD_SIZE );
+		if ( ret == 0 )
+			errno = EINVAL;
+		if ( ret <= 0 )
+			return -1;
+
+		p = cap->buf + cap->pos;
+		cap->pos += CAP_RECORD_SIZE + (len + CAP_RECORD_SIZE-1) / CAP_RECORD_SIZE * CAP_RECORD_SIZE;
+
+		cap->modes[index] = p[3];
+		memcpy ( cap->devs[index], p + CAP_RECORD_SIZE, len );
+		cap->devs[index][len] = 0;
+
+		if ( index >= cap->numdevs )
+			cap->numdevs = index + 1;
+
+		rec->dev = cap->devs[index];
+		rec->mode = cap->modes[index];
+		return 1;
+
+	case CAP_REC_EDGE:
+		cap->pos += CAP_RECORD_SIZE;
+
+		//(a stream's edges don't need a device record first)
+		if ( cap->stream )
+		{
+			rec->dev = NULL;
+			rec->mode = 0;
+		}
+		else if ( index >= cap->numdevs )
+			return -1;
+		else
+		{
+			rec->dev = cap->devs[index];
+			rec->mode = cap->modes[index];
+		}
+
+		rec->level = p[2];
+		rec->line = capGet32 ( p+4 );
+		rec->lost = capGet32 ( p+8 );
+		rec->time.err = time_ns2time_f ( capGet32 ( p+12 ) );
+		rec->time.real = capGet64 ( p+16 );
+		rec->time.mono = capGet64 ( p+24 );
+		return 1;
+	}
+
+	//(unknown records from a newer version are skipped)
+	cap->pos += CAP_RECORD_SIZE;
+	rec->dev = NULL;
+	return 1;
+}
+
+void
+capCloseRead ( capReaderT* cap )
+{
+	close ( cap->fd );
+	safe_free ( cap );
+}
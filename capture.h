@@ -0,0 +1,88 @@
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+#include "timef.h"
+
+//edge capture files - every raw edge seen on the lines, so reception problems can be
+//replayed offline (-s replay:<file>)
+//
+//the file is a 16 byte header ("RCLKCAP1", version, reserved) followed by 32 byte
+//records, all little endian:
+//	0	u8	type		CAP_REC_*
+//	1	u8	device		index given by an earlier CAP_REC_DEVICE record
+//	2	u8	level		line level after the edge (0 or 1)
+//	3	u8	mode		device records: the SERPORT_MODE_*
+//	4	u32	line		the line as given on the command line - a TIOCM_* bit, or a gpio
+//				line offset (device records: the length of the name)
+//	8	u32	lost		edges the kernel counted before this one that weren't seen
+//	12	u32	err		timestamp error, in nanoseconds
+//	16	s64	real		CLOCK_REALTIME, nanoseconds
+//	24	s64	mono		CLOCK_MONOTONIC, nanoseconds
+//device records are followed by the device name, padded to a whole number of records
+//
+//the same format is read from edge streams (-s stream) - there the device index is
+//ignored, and either timestamp can be 0 if the sender doesn't have that clock
+
+#define	CAP_MAGIC	"RCLKCAP1"
+#define	CAP_VERSION	(1)
+
+#define	CAP_HEADER_SIZE	(16)
+#define	CAP_RECORD_SIZE	(32)
+
+#define	CAP_REC_DEVICE	(1)
+#define	CAP_REC_EDGE	(2)
+
+//devices per capture file
+#define	CAP_MAX_DEVS	(32)
+
+typedef struct
+{
+	int		type;
+	const char*	dev;	//(points into the reader - valid until it's closed)
+	int		mode;
+	int		line;
+	int		level;
+	int		lost;
+	timeStampT	time;
+} capRecordT;
+
+typedef struct
+{
+	int		fd;
+	unsigned char	buf[64*CAP_RECORD_SIZE];
+	int		len;
+	int		pos;
+	int		stream;		//a nonblocking stream (see capAttach())
+	int		needheader;
+	unsigned long	reads;		//read() calls made
+	int		numdevs;
+	char		devs[CAP_MAX_DEVS][64];
+	int		modes[CAP_MAX_DEVS];
+} capReaderT;
+
+
+//open a capture file - returns -1 on error. the records are only buffered until capStart()
+int capOpen ( char* file );
+//start the thread that writes the capture out - after any fork (setDemon()), as a thread
+//doesn't survive one. returns -1 (and the capture's stopped) if it can't
+int capStart ( void );
+//record an edge (buffered - a thread writes them, so a slow disk doesn't hold up the main loop)
+void capEdge ( const char* dev, int mode, int line, int level, int lost, const timeStampT* ts );
+//have the writer write out what's buffered (without waiting for it), and log any records dropped
+//or a write error (which stops the capture)
+void capFlush ( void );
+void capClose ( void );
+
+//read a capture - capRead() returns 1 for a record, 0 at the end, -1 on error
+capReaderT* capOpenRead ( char* file );
+int capRead ( capReaderT* cap, capRecordT* rec );
+void capCloseRead ( capReaderT* cap );
+
+//read records from a nonblocking fd (a fifo or socket) - the header is checked as it
+//arrives, and capRead() returns -1 with errno EAGAIN when it needs more to be sent
+capReaderT* capAttach ( int fd );
+//returns 1 if a whole record is buffered (capRead() may still need more for a device record)
+int capPending ( capReaderT* cap );
+
+
+#endif
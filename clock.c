@@ -25,6 +25,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 
@@ -48,6 +49,48 @@ static time_f lengths_clocktype_msf[8]   = { 0.1, 0.2, 0.3, 0.5, 0.7, 0.8, 0.9,
 static time_f lengths_clocktype_wwvb[4]  = { 0.2, 0.5, 0.8, -1.0 };
 
 
+//timestamp errors below this (seconds) don't count - it's the floor for the weighting
+#define	PPS_MIN_STAMP_ERR	(0.000010)
+//a sample with more than this many times the median timestamp error is left out of the average
+#define	PPS_STAMP_ERR_LIMIT	(4)
+//as is one further than this from the radio time (a second mislabelled, say - ntpd would step
+//the time before the pc clock got this far out)
+#define	PPS_MAX_OFFSET		(NSEC_PER_SEC / 10)
+//and one further than this many (robust) standard deviations from the median of its half of the
+//window - 1.4826 median absolute deviations, for normal noise
+#define	PPS_OUTLIER_LIMIT	(3.0)
+//the samples' times are from ppsref, which is moved up to the newest after this many windows (so
+//the times don't get too big)
+#define	PPS_REBASE_WINDOWS	(10)
+//the fewest samples averaged in each half of the window - the average starts from twice this
+#define	PPS_MIN_HALF		(2)
+//the pc clock's rate is averaged over about this many windows - it's the slope between the two
+//halves of a minute of samples, so it's noisy, and a pc's clock's rate doesn't change fast
+#define	PPS_FREQ_WINDOWS	(10)
+
+//pulse starts in a row that the flywheel doesn't put on a second before the seconds are counted
+//again from scratch
+#define	CLK_RESYNC		(3)
+
+//holdover: how long after a second's start its time is sent from the flywheel, if its start
+//hasn't come (seconds) - and for how long after the last second's start it's trusted to
+#define	CLK_HOLDOVER_WAIT	(2.0)
+#define	CLK_HOLDOVER		(600)
+
+//a phase modulation second is for the pps sample within this of it (seconds)
+#define	PM_MATCH_WINDOW		(0.050)
+//phase modulation bits that can differ from the carrier reductions' in a minute, before the
+//minute is thrown away - and how many have to be compared for it to count
+#define	PM_MAX_MISMATCHES	(2)
+#define	PM_MIN_COMPARED		(20)
+
+//soft decision decoding: the cheapest bits of a group that are tried flipping, the most the flips
+//can cost altogether, and how much cheaper they have to be than the next best flips (the costs
+//are log likelihood ratios - 3.0 is 20 times as likely)
+#define	CLK_FLIP_CANDIDATES	(10)
+#define	CLK_MAX_FLIP_COST	(6.0)
+#define	CLK_FLIP_MARGIN		(3.0)
+
 static clkInfoT* clkListHead;
 
 
@@ -64,6 +107,21 @@ clkDumpData ( const clkInfoT* clock )
 	loggerf ( LOGGER_TRACE, "\n" );
 }
 
+//pulse/clear lengths for each radio clock
+static time_f*
+clkLengths ( int clocktype )
+{
+	switch ( clocktype )
+	{
+	case CLOCKTYPE_MSF:
+		return lengths_clocktype_msf;
+	case CLOCKTYPE_WWVB:
+		return lengths_clocktype_wwvb;
+	}
+
+	//  (note: the last 2 of DCF77's are to handle the missing second 59)
+	return lengths_clocktype_dcf77;
+}
 
 clkInfoT*
 clkCreate ( int inverted, int shmunit, time_f fudgeoffset, int clocktype )
@@ -77,8 +135,17 @@ clkCreate ( int inverted, int shmunit, time_f fudgeoffset, int clocktype )
 	clkinfo->inverted = inverted;
 	clkinfo->fudgeoffset = fudgeoffset;
 
-	clkinfo->numdata = 0;
 	clkinfo->clocktype=clocktype;
+	clkinfo->pulsesec = -1;
+	clkDataClear ( clkinfo );
+	flywheelInit ( &clkinfo->flywheel );
+	clkinfo->ppssize = averageSeconds;
+	clkinfo->ppslist = safe_mallocz ( clkinfo->ppssize * sizeof(*clkinfo->ppslist) );
+	windowInit ( &clkinfo->ppsold, clkinfo->ppssize );
+	windowInit ( &clkinfo->ppsnew, clkinfo->ppssize );
+	windowInit ( &clkinfo->ppserrs, clkinfo->ppssize );
+
+	pulseInit ( &clkinfo->pulses, clkLengths ( clocktype ) );
 
 	if ( !debugLevel )
 		clkinfo->shm = shmCreate ( shmunit );
@@ -86,300 +153,1046 @@ clkCreate ( int inverted, int shmunit, time_f fudgeoffset, int clocktype )
 	return clkinfo;
 }
 
+void
+clkFree ( clkInfoT* clock )
+{
+	clkInfoT**	p;
+
+	for ( p=&clkListHead; *p != NULL; p=&(*p)->next )
+	{
+		if ( *p == clock )
+		{
+			*p = clock->next;
+			break;
+		}
+	}
+
+	windowFree ( &clock->ppsold );
+	windowFree ( &clock->ppsnew );
+	windowFree ( &clock->ppserrs );
+	safe_free ( clock->ppslist );
+	if ( clock->shm != NULL )
+		shmFree ( clock->shm );
+	safe_free ( clock );
+}
+
 void
 clkDataClear ( clkInfoT* clock )
 {
+	int	i;
+
+	for ( i=0; i<CLK_SECONDS; i++ )
+		clock->sec[i].num = -1;
 	clock->numdata = 0;
 }
 
+//store a second's value, with the length of its pulse and what each of its bits would cost to flip
+static void
+clkStoreSecond ( clkInfoT* clock, int n, int val, time_f width )
+{
+	pulseClassT*	pc = &clock->pulses;
+	float*		cost;
+
+	if ( n < 0 )
+		return;
+
+	clock->sec[n % CLK_SECONDS].num = n;
+	clock->sec[n % CLK_SECONDS].val = val;
+	clock->sec[n % CLK_SECONDS].width = width;
+	cost = clock->sec[n % CLK_SECONDS].cost;
+
+	//(markers, and what would need another pulse - MSF's 11 - can't be flipped)
+	cost[0] = PULSE_MAX_COST;
+	cost[1] = PULSE_MAX_COST;
+
+	switch ( clock->clocktype )
+	{
+	case CLOCKTYPE_DCF77:
+		if ( val == 1 || val == 2 )
+			cost[0] = pulseCost ( pc, PULSE_LOW, width, val, 3 - val );
+		break;
+	case CLOCKTYPE_MSF:
+		if ( val == 1 || val == 2 )
+			cost[0] = pulseCost ( pc, PULSE_LOW, width, val, 3 - val );
+		if ( val == 2 || val == 3 )
+			cost[1] = pulseCost ( pc, PULSE_LOW, width, val, 5 - val );
+		break;
+	case CLOCKTYPE_WWVB:
+		if ( val == 2 || val == 5 )
+			cost[0] = pulseCost ( pc, PULSE_LOW, width, val, 7 - val );
+		break;
+	}
+}
+
+//second n's value - CLK_ERASED if it wasn't received
+static int
+clkSecond ( const clkInfoT* clock, int n )
+{
+	if ( n < 0 || clock->sec[n % CLK_SECONDS].num != n )
+		return CLK_ERASED;
+	return clock->sec[n % CLK_SECONDS].val;
+}
+
+//whether second n can start a minute, as far as the time decoded says (a second late, for a leap
+//second) - a minute marker anywhere else is a misread (or, for DCF77, a pulse missed)
+static int
+clkOnMinute ( const clkInfoT* clock, int n )
+{
+	return clock->radiotime == 0 || (n - clock->timesec) % 60 == 0
+		|| ( clock->radioleap == LEAP_ADDSECOND && (n - clock->timesec) % 60 == 1 );
+}
+
+//the minute before second 'first' (its second 0) into data[], for the decoders
+static void
+clkGetMinute ( clkInfoT* clock, int first )
+{
+	int	s, n;
+
+	for ( s=0; s<60; s++ )
+	{
+		n = first - 60 + s;
+		clock->data[s] = clkSecond ( clock, n );
+		if ( clock->clocktype == CLOCKTYPE_DCF77 && clock->data[s] == 0 && s != 59 )
+			clock->data[s] = CLK_ERASED;	//(a missed pulse taken for second 59)
+		clock->width[s] = 0;
+		clock->cost[s][0] = 0;
+		clock->cost[s][1] = 0;
+		if ( clock->data[s] != CLK_ERASED )
+		{
+			clock->width[s] = clock->sec[n % CLK_SECONDS].width;
+			clock->cost[s][0] = clock->sec[n % CLK_SECONDS].cost[0];
+			clock->cost[s][1] = clock->sec[n % CLK_SECONDS].cost[1];
+		}
+	}
+	clock->numdata = 60;
+}
+
+//number a pulse start by its time - returns the second it starts, or -1 if it doesn't start one.
+//only a start after a good clear steers the flywheel (after a bad one, it could be a glitch's
+//start, just before the second's)
+static int
+clkNumberSecond ( clkInfoT* clock, const timeStampT* ts, int track )
+{
+	int	n;
+
+	n = flywheelMatch ( &clock->flywheel, clock->secnum, ts->mono );
+	if ( n >= 0 )
+	{
+		if ( track )
+			flywheelTrack ( &clock->flywheel, n, ts->mono );
+
+		clock->secnum = n;
+		clock->unmatched = 0;
+		return n;
+	}
+
+	if ( clock->flywheel.count > 0 && ++clock->unmatched < CLK_RESYNC )
+		return -1;
+
+	//the seconds were counted from something that wasn't one (or the signal's been gone too
+	//long to tell) - start again from this one, and the time decoded can't be counted on from
+	if ( clock->flywheel.count > 0 )
+		loggerf ( LOGGER_DEBUG, "warning: %d pulses in a row not on a second - counting seconds again\n", clock->unmatched );
+
+	//(numbered on past any sent from the flywheel meanwhile)
+	clkDataClear ( clock );
+	if ( clock->sentsec > clock->secnum )
+		clock->secnum = clock->sentsec;
+	clock->secnum += CLK_SECONDS;
+	flywheelStart ( &clock->flywheel, clock->secnum, ts->mono );
+	clock->unmatched = 0;
+	clock->radiotime = 0;
+	clock->heldtime = 0;
+
+	return clock->secnum;
+}
+
 int
-clkPulseLength ( time_f timef, int clocktype )
-{
-        //only detect short pulses...
-        if ( timef > 2.0 )
-                return -1;
-
-	//pulse/clear lengths for each radio clock
-	time_f* lengths = NULL;
-
-        switch (clocktype) {
-        case CLOCKTYPE_DCF77:
-            //  (note: these last 2 are to handle the missing second 59)
-            lengths = lengths_clocktype_dcf77;
-            break;
-        case CLOCKTYPE_MSF:
-            lengths = lengths_clocktype_msf;
-            break;
-        case CLOCKTYPE_WWVB:
-            lengths = lengths_clocktype_wwvb;
-            break;
-        }
+clkBitValue ( int clocktype, int val, int b )
+{
+	switch ( clocktype )
+	{
+	case CLOCKTYPE_DCF77:
+		if ( b == 0 && (val == 1 || val == 2) )
+			return val == 2;
+		break;
+	case CLOCKTYPE_MSF:
+		if ( val == 1 || val == 2 || val == 3 || val == 11 )
+			return b == 0 ? (val == 2 || val == 3) : (val == 3 || val == 11);
+		break;
+	case CLOCKTYPE_WWVB:
+		if ( b == 0 && (val == 2 || val == 5) )
+			return val == 5;
+		break;
+	}
+	return -1;
+}
 
+int
+clkFlipValue ( int clocktype, int val, int b )
+{
+	if ( clkBitValue ( clocktype, val, b ) < 0 )
+		return val;
+
+	switch ( clocktype )
+	{
+	case CLOCKTYPE_DCF77:
+		return 3 - val;
+	case CLOCKTYPE_MSF:
+		//A bit: 1 <-> 2, 3 <-> 11 - B bit: 2 <-> 3, 1 <-> 11
+		if ( b == 0 )
+			return val == 1 || val == 2 ? 3 - val : 14 - val;
+		return val == 2 || val == 3 ? 5 - val : 12 - val;
+	case CLOCKTYPE_WWVB:
+		return 7 - val;
+	}
+	return val;
+}
+
+void
+clkFlipBit ( clkInfoT* clock, int i, int b )
+{
+	clock->data[i] = clkFlipValue ( clock->clocktype, clock->data[i], b );
+}
+
+//flip the candidates in mask
+static void
+clkFlipMask ( clkInfoT* clock, const int* cand, int numcand, int mask )
+{
 	int	i;
 
-	for ( i=0; lengths[i] > 0; i++ )
+	for ( i=0; i<numcand; i++ )
 	{
-		if ( timef > (lengths[i]-0.040) && timef < (lengths[i]+0.040) )
-			return (int)(lengths[i] * 10 + 0.5);	//to convert to 10ths of a second
+		if ( mask & (1 << i) )
+			clkFlipBit ( clock, clock->numdata - 60 + cand[i] / 2, cand[i] & 1 );
 	}
-	return -1;
 }
 
+//put back an erased bit that was guessed at (as clkGetMinute() left it)
+static void
+clkUnguessErased ( clkInfoT* clock, int d )
+{
+	clock->data[d] = CLK_ERASED;
+	clock->cost[d][0] = 0;
+	clock->cost[d][1] = 0;
+}
+
+int
+clkCorrectBits ( clkInfoT* clock, const int* bits, int numbits, int (*valid) ( clkInfoT*, int ), int group, float* pcost )
+{
+	int	cand[CLK_FLIP_CANDIDATES];
+	float	candcost[CLK_FLIP_CANDIDATES];
+	float	cost, bestcost, nextcost;
+	int	i, j, d, n, numcand, mask, bestmask, flips, bestflips, erased;
+
+	*pcost = 0;
+
+	//an erased bit - a 0 that's as likely to be a 1
+	erased = -1;
+	for ( i=0; i<numbits; i++ )
+	{
+		d = clock->numdata - 60 + bits[i] / 2;
+		if ( d < 0 || d >= clock->numdata || clock->data[d] != CLK_ERASED )
+			continue;
+		if ( erased >= 0 )
+		{
+			clkUnguessErased ( clock, erased );
+			return -1;
+		}
+
+		erased = d;
+		clock->data[d] = clock->clocktype == CLOCKTYPE_WWVB ? 2 : 1;
+		clock->cost[d][0] = ( bits[i] & 1 ) ? PULSE_MAX_COST : 0;
+		clock->cost[d][1] = ( bits[i] & 1 ) ? 0 : PULSE_MAX_COST;
+	}
+
+	if ( valid ( clock, group ) )
+		return 0;
+
+	//the cheapest bits to flip, cheapest first
+	numcand = 0;
+	for ( i=0; i<numbits; i++ )
+	{
+		d = clock->numdata - 60 + bits[i] / 2;
+		if ( d < 0 || d >= clock->numdata )
+			continue;
+		cost = clock->cost[d][bits[i] & 1];
+		if ( cost >= PULSE_MAX_COST )
+			continue;
+
+		for ( j=numcand; j>0 && candcost[j-1] > cost; j-- )
+		{
+			if ( j < CLK_FLIP_CANDIDATES )
+			{
+				cand[j] = cand[j-1];
+				candcost[j] = candcost[j-1];
+			}
+		}
+		if ( j < CLK_FLIP_CANDIDATES )
+		{
+			cand[j] = bits[i];
+			candcost[j] = cost;
+			if ( numcand < CLK_FLIP_CANDIDATES )
+				numcand++;
+		}
+	}
+
+	//every way of flipping up to CLK_MAX_FLIPS of them - the best and the next best that work
+	bestcost = CLK_MAX_FLIPS * PULSE_MAX_COST;
+	nextcost = bestcost;
+	bestmask = 0;
+	bestflips = 0;
+	for ( mask=1; mask < (1 << numcand); mask++ )
+	{
+		cost = 0;
+		flips = 0;
+		for ( n=0; n<numcand; n++ )
+		{
+			if ( mask & (1 << n) )
+			{
+				cost += candcost[n];
+				flips++;
+			}
+		}
+		if ( flips > CLK_MAX_FLIPS || cost >= nextcost )
+			continue;
+
+		clkFlipMask ( clock, cand, numcand, mask );
+		if ( valid ( clock, group ) )
+		{
+			if ( cost < bestcost )
+			{
+				nextcost = bestcost;
+				bestcost = cost;
+				bestmask = mask;
+				bestflips = flips;
+			}
+			else
+				nextcost = cost;
+		}
+		clkFlipMask ( clock, cand, numcand, mask );
+	}
+
+	if ( !bestmask || bestcost > CLK_MAX_FLIP_COST || nextcost - bestcost < CLK_FLIP_MARGIN )
+	{
+		if ( erased >= 0 )
+			clkUnguessErased ( clock, erased );
+		return -1;
+	}
+
+	clkFlipMask ( clock, cand, numcand, bestmask );
+	*pcost = bestcost;
+
+	return bestflips;
+}
+
+
+static int
+clkDecode ( clkInfoT* clock, time_ns minstart )
+{
+	switch ( clock->clocktype )
+	{
+	case CLOCKTYPE_MSF:
+		return msfDecode ( clock, minstart );
+	case CLOCKTYPE_WWVB:
+		return wwvbDecode ( clock, minstart );
+	}
+	return dcf77Decode ( clock, minstart );
+}
+
+//whether time 'after', for second aftersec, follows on from 'before' for beforesec - by the
+//seconds counted between them (one of which may have been a leap second)
+static int
+clkFollows ( time_ns before, int beforesec, int leap, time_ns after, int aftersec )
+{
+	time_ns	gap;
+
+	gap = after - before - (time_ns)(aftersec - beforesec) * NSEC_PER_SEC;
+
+	return gap == 0 || ( leap == LEAP_ADDSECOND && gap == -NSEC_PER_SEC );
+}
+
+//start the pps samples again - their radio times are from a time that's been stepped from
+static void
+clkPPSClear ( clkInfoT* clock )
+{
+	memset ( clock->ppslist, 0, clock->ppssize * sizeof(*clock->ppslist) );
+	clock->ppscount = 0;
+	windowClear ( &clock->ppsold );
+	windowClear ( &clock->ppsnew );
+	windowClear ( &clock->ppserrs );
+}
+
+//decode the minute that's just ended, before second 'first' (which started at minstart) - or, if
+//it won't, it voted with the minutes before it. a minute can be misread and still check, so once
+//there's a time one that doesn't follow on from it is held until the next minute agrees
+static int
+clkDecodeMinute ( clkInfoT* clock, time_ns minstart, int first )
+{
+	time_ns	radiotime, pctime;
+	int	radioleap, minutes;
+
+	radiotime = clock->radiotime;
+	pctime = clock->pctime;
+	radioleap = clock->radioleap;
+	clkGetMinute ( clock, first );
+	clkDumpData ( clock );
+
+	voteAddMinute ( clock, minstart );
+
+	minutes = 0;
+	if ( clkDecode ( clock, minstart ) < 0 )
+	{
+		minutes = voteMinute ( clock, minstart );
+		if ( minutes < 0 || clkDecode ( clock, minstart ) < 0 )
+			return -1;
+
+		loggerf ( LOGGER_DEBUG, "decoded by voting %d minutes\n", minutes );
+	}
+
+	if ( radiotime != 0 && !clkFollows ( radiotime, clock->timesec, radioleap, clock->radiotime, first ) )
+	{
+		if ( clock->heldtime == 0
+		  || !clkFollows ( clock->heldtime, clock->heldsec, radioleap, clock->radiotime, first ) )
+		{
+			loggerf ( LOGGER_DEBUG, "warning: decoded time doesn't follow on from the last - held for the next minute\n" );
+
+			clock->heldtime = clock->radiotime;
+			clock->heldsec = first;
+			clock->radiotime = radiotime;
+			clock->pctime = pctime;
+			clock->radioleap = radioleap;
+			clock->secondssincetime = clock->secnum - clock->timesec;
+			return -1;
+		}
+
+		loggerf ( LOGGER_INFO, "clock: time stepped - two minutes in a row agree on it\n" );
+		clkPPSClear ( clock );
+	}
+
+	clock->confirmed = ( radiotime != 0 );
+	clock->heldtime = 0;
+	clock->timesec = first;
+	return 0;
+}
+
+
+//compare the phase modulation bits with the carrier reductions' for the minute that's just been
+//decoded (minstart is the end of it) - returns -1 if too many differ. the time and date bits
+//(20 - 58) are compared, counted either way round - an sdr that inverts the spectrum inverts
+//the phase, so the bits come out inverted
+static int
+clkCheckPMBits ( clkInfoT* clock, time_ns minstart )
+{
+	time_f	pos;
+	int	i, s, val, agree, disagree, mismatches;
+
+	agree = 0;
+	disagree = 0;
+
+	for ( i=0; i<CLK_PM_SECONDS; i++ )
+	{
+		if ( clock->pmlist[i].time == 0 )
+			continue;
+
+		pos = time_ns2time_f ( clock->pmlist[i].time - (minstart - 60 * NSEC_PER_SEC) );
+		s = lround ( pos );
+		if ( s < 20 || s > 58 || fabs ( pos - s ) > PM_MATCH_WINDOW )
+			continue;
+		if ( clock->numdata - 60 + s < 0 )
+			continue;
+
+		val = clock->data[clock->numdata - 60 + s];
+		if ( val != 1 && val != 2 )
+			continue;
+
+		if ( (val == 2) == (clock->pmlist[i].bit != 0) )
+			agree++;
+		else
+			disagree++;
+	}
+
+	if ( agree + disagree < PM_MIN_COMPARED )
+		return 0;
+
+	mismatches = agree < disagree ? agree : disagree;
+	loggerf ( LOGGER_DEBUG, "DCF77 phase modulation: %d of %d bits differ\n", mismatches, agree + disagree );
+
+	return mismatches > PM_MAX_MISMATCHES ? -1 : 0;
+}
 
 void
-clkProcessStatusChange ( clkInfoT* clock, int status, time_f timef )
+clkProcessStatusChange ( clkInfoT* clock, int status, const timeStampT* ts )
 {
 	time_f diff;
-	int	val;
+	int	val, n;
 
 
 	if ( clock->inverted )
 		status = !status;
 
-//	timersub ( tv, &clock->changetime, &diff );
-	diff = timef - clock->changetime;
+	//(on the monotonic clock, so a step of the system clock doesn't upset the pulse lengths)
+	diff = time_ns2time_f ( ts->mono - clock->changetime.mono );
+
+	//(a minute that went by without a time - before this edge can start the next)
+	clkHoldover ( clock, ts );
 
 	if ( !clock->status && status )
 	{
-		val = clkPulseLength ( diff, clock->clocktype );
+		val = pulseClassify ( &clock->pulses, PULSE_LOW, diff );
+		n = clock->pulsesec;
 
-
-		if ( val < 0 )
+		if ( n < 0 )
 		{
-			loggerf ( LOGGER_TRACE, "warning: bad pulse length "TIMEF_FORMAT"\n", diff );
+			//not a second's pulse - MSF's B bit, after a 100ms clear (or a glitch)
+			if ( clock->msf_skip_b && (val == 1) && clkSecond ( clock, clock->secnum ) == 1 )
+			{
+				clock->sec[clock->secnum % CLK_SECONDS].val += 10;
+				clock->sec[clock->secnum % CLK_SECONDS].cost[0] = PULSE_MAX_COST;
+				clock->sec[clock->secnum % CLK_SECONDS].cost[1] = PULSE_MAX_COST;
+			}
+			else
+				loggerf ( LOGGER_TRACE, "warning: pulse of "TIMEF_FORMAT" not on a second ignored\n", diff );
+		}
+		else if ( val < 0 )
+		{
+			loggerf ( LOGGER_TRACE, "warning: bad pulse length "TIMEF_FORMAT" - second %d erased\n", diff, n % 60 );
 
-			clkDataClear ( clock );
+			clkStoreSecond ( clock, n, CLK_ERASED, diff );
 		}
 		else
 		{
-			//make sure we dont go off the end - unlikely but could happen with noise...
-			if ( clock->numdata >= 120 )
-				clkDataClear ( clock );
-
-			if ( clock->msf_skip_b && (val == 1) )
+			if ( val == 5 && clock->clocktype==CLOCKTYPE_MSF && !clkOnMinute ( clock, n ) )
 			{
-				clock->msf_skip_b = 0;
-				if ( clock->numdata >= 1 )
-					clock->data[clock->numdata-1] += 10;
+				loggerf ( LOGGER_DEBUG, "warning: MSF minute marker off the minute - second %d erased\n", n % 60 );
+				val = CLK_ERASED;
 			}
-			else
+			if ( val == 5 && clock->clocktype==CLOCKTYPE_MSF )  //MSF minute marker...
+			{
+				if ( clkDecodeMinute ( clock, clock->changetime.real, n ) < 0 )
+					loggerf ( LOGGER_DEBUG, "warning: failed to decode MSF time\n" );
+				else
+					clkSendTime ( clock );
+			}
+			if ( val == 8 && 
+			     clock->clocktype == CLOCKTYPE_WWVB &&
+			     clkSecond ( clock, n - 1 ) == 8 && clkOnMinute ( clock, n ) )
 			{
-				if ( val == 5 && clock->clocktype==CLOCKTYPE_MSF )  //MSF minute marker...
-				{
-					clkDumpData ( clock );
-					if ( msfDecode ( clock, clock->changetime ) < 0 )
-						loggerf ( LOGGER_DEBUG, "warning: failed to decode MSF time\n" );
-					else
-						clkSendTime ( clock );
-
-
-					clkDataClear ( clock );
-				}
-				if ( val == 8 && 
-                                     clock->clocktype == CLOCKTYPE_WWVB &&
-                                     clock->numdata > 0 && 
-                                     clock->data[ clock->numdata - 1 ] == 8 )	
-				{
-                                    /*
-                                        WWVB's Minute marker is a pair of back-to-back 0.8 second pulses, where
-                                        the first one is the start of the new minute, and the previous one was the
-                                        end of the previous minute. Strangely, they send the On-Time-Marker, and
-                                        then the time.
-                                    */
-					clkDumpData ( clock );
-					if ( wwvbDecode ( clock, clock->changetime ) < 0 )
-						loggerf ( LOGGER_DEBUG, "warning: failed to decode WWVB time\n" );
-					else
-						clkSendTime ( clock );
-
-					clkDataClear ( clock );
-				}
-
-				clock->data[ clock->numdata++ ] = val;
+                            /*
+                                WWVB's Minute marker is a pair of back-to-back 0.8 second pulses, where
+                                the first one is the start of the new minute, and the previous one was the
+                                end of the previous minute. Strangely, they send the On-Time-Marker, and
+                                then the time.
+                            */
+				if ( clkDecodeMinute ( clock, clock->changetime.real, n ) < 0 )
+					loggerf ( LOGGER_DEBUG, "warning: failed to decode WWVB time\n" );
+				else
+					clkSendTime ( clock );
 			}
 
-			if ( clock->numdata > 0 )
-				loggerf ( LOGGER_TRACE, "pulse end: length "TIMEF_FORMAT" - # Bits: %3d: Pulse Width (10ths): %d\n", diff, clock->numdata-1, clock->data[clock->numdata-1] );
+			clkStoreSecond ( clock, n, val, diff );
 
+			loggerf ( LOGGER_TRACE, "pulse end: length "TIMEF_FORMAT" - second %d: Pulse Width (10ths): %d\n", diff, n, val );
 		}
 
+		clock->msf_skip_b = 0;
+
 		clock->status = status;
-		clock->changetime = timef;
+		clock->changetime = *ts;
 	}
 	else if ( clock->status && !status )
 	{
-		loggerf ( LOGGER_TRACE, "pulse start: at "TIMEF_FORMAT"\n", timef );
+		loggerf ( LOGGER_TRACE, "pulse start: at "TIMENS_FORMAT" +-"TIMEF_FORMAT"\n", TIMENS_ARGS(ts->real), ts->err / 2 );
 
 
-		val = clkPulseLength ( diff, clock->clocktype );
+		val = pulseClassify ( &clock->pulses, PULSE_HIGH, diff );
 
-		if ( val < 0 )
-		{
-			loggerf ( LOGGER_TRACE, "warning: bad clear length "TIMEF_FORMAT"\n", diff );
-
-			clkDataClear ( clock );
-		}
-		else if ( (clock->numdata > 1) && (clock->data[clock->numdata-1] == 1) && (val == 1) )
+		if ( clock->clocktype == CLOCKTYPE_MSF && clock->pulsesec >= 0
+		  && clkSecond ( clock, clock->pulsesec ) == 1 && (val == 1) )
 		{
 			//the MSF signal has a 2nd bit sometimes - flag it...
 			clock->msf_skip_b = 1;
+			clock->pulsesec = -1;
+		}
+		else if ( (n = clkNumberSecond ( clock, ts, val >= 0 )) < 0 )
+		{
+			//a glitch - the seconds' starts (and their lengths) are from their times
+			loggerf ( LOGGER_TRACE, "warning: pulse start not on a second (clear length "TIMEF_FORMAT")\n", diff );
+			clock->pulsesec = -1;
+		}
+		else if ( (val == 18 || val == 19) && !clkOnMinute ( clock, n ) )
+		{
+			//not the minute - a pulse missed, so the second before it stays erased
+			loggerf ( LOGGER_DEBUG, "warning: DCF77 pulse missed - second %d erased\n", (n - 1) % 60 );
+			clock->pulsesec = n;
+			clkProcessPPS ( clock, ts );
 		}
 		else if ( val == 18 || val == 19 )
 		{
-			clock->data[clock->numdata++] = 0;	//store the missing second 59 value
+			clock->pulsesec = n;
+			clkStoreSecond ( clock, n - 1, 0, 0 );	//store the missing second 59 value
 
-			clkDumpData ( clock );
-
-			if ( dcf77Decode ( clock, timef ) < 0 )
+			if ( clkDecodeMinute ( clock, ts->real, n ) < 0 )
 				loggerf ( LOGGER_DEBUG, "Warning: failed to decode DCF77\n" );
+			else if ( clkCheckPMBits ( clock, ts->real ) < 0 )
+				loggerf ( LOGGER_DEBUG, "Warning: DCF77 phase modulation disagrees with the decoded minute\n" );
 			else
 				clkSendTime ( clock );
-
-
-			clkDataClear ( clock );
-
 		}
 		else
 		{
 			//we have the start of a second here...
+			clock->pulsesec = n;
 
-//printf ( "\a" ); flush ( stdout );
-
-			//TODO: PPS processing on this time
-			//increment time by 1 second (if pulse is good - within 50 ms perhaps?)
-			//and, keep a running average of the error from the current time
-			clkProcessPPS ( clock, timef );
-
-//			clkDumpPPS ( clock );
+			//keep a running average of the error from the current time (unless the clear before
+			//it was a bad length - it could be a glitch's start, just before the second's)
+			if ( val >= 0 )
+				clkProcessPPS ( clock, ts );
 		}
 
 
 		clock->status = status;
-		clock->changetime = timef;
+		clock->changetime = *ts;
 	}
 	//else no change so ignore pulse (should never happen)
 }
 
 void
-clkSendTime ( clkInfoT* clock )
+clkLostEdges ( clkInfoT* clock, int lost, int status, const timeStampT* ts )
 {
-	time_f	average, maxerr;
+	time_f	diff;
 
-	if ( clkCalculatePPSAverage ( clock, &average, &maxerr ) < 0 )
+	if ( clock->inverted )
+		status = !status;
+	status = ( status != 0 );
+
+	diff = time_ns2time_f ( ts->mono - clock->changetime.mono );
+
+	clkHoldover ( clock, ts );
+
+	//an even number lost with no change - something came and went between reads
+	if ( (lost & 1) == 0 && status == (clock->status != 0) )
+	{
+		//a dropout during a pulse - the pulse is still going, and its start was good
+		if ( !status )
+		{
+			loggerf ( LOGGER_TRACE, "dropout of %d edges during pulse ignored\n", lost );
+			return;
+		}
+
+		//a spike just after a pulse ended
+		if ( diff < 0.05 )
+		{
+			loggerf ( LOGGER_TRACE, "spike of %d edges after pulse ignored\n", lost );
+			return;
+		}
+	}
+
+	//otherwise a whole pulse may have gone, or this change happened at some time before ts -
+	//either way the lengths around it can't be trusted. the second now is left erased, and the
+	//next starts from its own edge (the seconds are numbered by their times, so a missing pulse
+	//isn't measured as a long clear - it could look like a minute marker)
+	loggerf ( LOGGER_DEBUG, "warning: %d edges lost "TIMEF_FORMAT" after the last change - resyncing\n", lost, diff );
+
+	clock->pulsesec = -1;
+	clock->msf_skip_b = 0;
+
+	clock->status = status;
+	clock->changetime.real = 0;
+	clock->changetime.mono = 0;
+	clock->changetime.err = 0;
+}
+
+//send a time to ntpd - and keep it, as the last sent
+static void
+clkStoreTime ( clkInfoT* clock, time_ns radiotime, time_ns pctime, time_f maxerr, int sec, int holdover )
+{
+	if ( !debugLevel )
+		shmStore ( clock->shm, radiotime, pctime, maxerr, clock->radioleap );
+
+	clock->sentradio = radiotime;
+	clock->sentpc = pctime;
+	clock->senterr = maxerr;
+	clock->sentsec = sec;
+	clock->sentholdover = holdover;
+	clock->sent++;
+}
+
+//whether the time decoded can be carried on from, second by second - it's been decoded twice in
+//a row, and no minute since disagrees with it
+static int
+clkTimeConfirmed ( const clkInfoT* clock )
+{
+	return clock->radiotime != 0 && clock->confirmed && clock->heldtime == 0;
+}
+
+//send second sec's time (from the one decoded), started at pctime - by the offset estimated for
+//then, if there is one
+static void
+clkSendSecond ( clkInfoT* clock, int sec, time_ns pctime, int level )
+{
+	time_ns	radiotime, offset;
+	time_f	maxerr;
+
+	radiotime = clock->radiotime + (time_ns)(sec - clock->timesec) * NSEC_PER_SEC;
+
+	if ( clkCalculatePPSAverage ( clock, pctime, &offset, &maxerr ) < 0 )
 	{
 		maxerr = 0.005;
+		clock->sentraw++;
 
-		loggerf ( LOGGER_DEBUG, "clock: radio time "TIMEF_FORMAT", pc time "TIMEF_FORMAT"\n", clock->radiotime, clock->pctime );
+		loggerf ( level, "clock: radio time "TIMENS_FORMAT", pc time "TIMENS_FORMAT"\n", TIMENS_ARGS(radiotime), TIMENS_ARGS(pctime) );
 
-		if ( !debugLevel )
-			shmStore ( clock->shm, clock->radiotime, clock->pctime, maxerr, clock->radioleap );
+		clkStoreTime ( clock, radiotime, pctime, maxerr, sec, 0 );
 	}
 	else
 	{
-		loggerf ( LOGGER_DEBUG, "clock: radio time "TIMEF_FORMAT", average pctime "TIMEF_FORMAT", error +-"TIMEF_FORMAT"\n", clock->radiotime, clock->radiotime + average, maxerr );
+		loggerf ( level, "clock: radio time "TIMENS_FORMAT", estimated pctime "TIMENS_FORMAT", error +-"TIMEF_FORMAT"\n", TIMENS_ARGS(radiotime), TIMENS_ARGS(radiotime + offset), maxerr );
 
-		if ( !debugLevel )
-			shmStore ( clock->shm, clock->radiotime, clock->radiotime + average, maxerr, clock->radioleap );
+		clkStoreTime ( clock, radiotime, radiotime + offset, maxerr, sec, 0 );
 	}
+}
+
+void
+clkSendTime ( clkInfoT* clock )
+{
+	//(MSF's and WWVB's minutes are decoded after their second 0 started - and was sent, if the
+	//time was confirmed already)
+	if ( clock->sentsec == clock->timesec && !clock->sentholdover && clock->sentradio == clock->radiotime )
+		return;
 
+	clkSendSecond ( clock, clock->timesec, clock->pctime, LOGGER_DEBUG );
+}
+
+//the next second the flywheel could send a time for - the minute decoded last, if it wasn't
+//sent, or the first after the last sent. -1 if it can't: the time's not confirmed, the flywheel
+//isn't settled or has gone too long without a second, or a leap second's due, which it wouldn't
+//know about
+static int
+clkHoldoverSecond ( const clkInfoT* clock )
+{
+	int	s;
+
+	if ( !clkTimeConfirmed ( clock ) || !flywheelSettled ( &clock->flywheel ) || clock->radioleap == LEAP_ADDSECOND )
+		return -1;
+
+	s = clock->sentsec < clock->timesec ? clock->timesec : clock->sentsec + 1;
+	if ( time_ns2time_f ( flywheelPredict ( &clock->flywheel, s ) - clock->flywheel.start ) > CLK_HOLDOVER )
+		return -1;
+
+	return s;
 }
 
 void
-clkProcessPPS ( clkInfoT* clock, time_f timef )
+clkHoldover ( clkInfoT* clock, const timeStampT* now )
 {
-//	time_f	average, maxerr;
+	time_ns	start;
+	time_f	since, maxerr;
+	int	m;
 
-	//cant process second pulses unless we have decoded the time...
-	if ( clock->radiotime == 0 )
+	if ( (m = clkHoldoverSecond ( clock )) < 0 )
 		return;
 
-	clock->secondssincetime += 1.0;
+	//(the latest that's due - the ones before it are too late to be any use now)
+	if ( now->mono < flywheelPredict ( &clock->flywheel, m ) + time_f2time_ns ( CLK_HOLDOVER_WAIT ) )
+		return;
+	while ( time_ns2time_f ( flywheelPredict ( &clock->flywheel, m ) - clock->flywheel.start ) <= CLK_HOLDOVER
+	  && now->mono >= flywheelPredict ( &clock->flywheel, m + 1 ) + time_f2time_ns ( CLK_HOLDOVER_WAIT ) )
+		m++;
 
-	clock->ppslist[clock->ppsindex].pctime = timef;
-	clock->ppslist[clock->ppsindex].radiotime = clock->radiotime + clock->secondssincetime;
-	clock->ppsindex++;
-	clock->ppsindex %= PPS_AVERAGE_COUNT;
+	start = flywheelPredict ( &clock->flywheel, m );
+	since = time_ns2time_f ( start - clock->flywheel.start );
+	if ( since > CLK_HOLDOVER )
+	{
+		loggerf ( LOGGER_INFO, "clock: no seconds for %.0fs - holdover ended\n", since );
+
+		clock->sentsec = m;
+		return;
+	}
+
+	maxerr = flywheelError ( &clock->flywheel, start );
 
-//	if ( clkCalculatePPSAverage ( clock, &average, &maxerr ) >= 0 )
-//	{
-//
-//	}
+	loggerf ( LOGGER_TRACE, "clock: holdover: radio time "TIMENS_FORMAT" from the flywheel (%.0fs since the last second), error +-"TIMEF_FORMAT"\n",
+		TIMENS_ARGS(clock->radiotime + (time_ns)(m - clock->timesec) * NSEC_PER_SEC), since, maxerr );
+
+	//(the start's on the monotonic clock - to the real one by the two now, which the real one's
+	//steering hasn't had time to move apart much)
+	clkStoreTime ( clock, clock->radiotime + (time_ns)(m - clock->timesec) * NSEC_PER_SEC,
+		now->real - (now->mono - start), maxerr, m, 1 );
+	clock->holdovers++;
 }
 
+int
+clkHoldoverTimeout ( const clkInfoT* clock, const timeStampT* now )
+{
+	time_ns	due;
+	int	m;
 
+	if ( (m = clkHoldoverSecond ( clock )) < 0 )
+		return -1;
 
+	due = flywheelPredict ( &clock->flywheel, m ) + time_f2time_ns ( CLK_HOLDOVER_WAIT );
+	if ( due <= now->mono )
+		return 0;
 
-static int
-sort_timef_compare ( const void* a, const void* b )
+	return (int)( (due - now->mono) / 1000000 ) + 1;
+}
+
+//the widest timestamp error a sample can have and be averaged
+static time_f
+clkPPSStampLimit ( const clkInfoT* clock )
 {
-	time_f	ta,tb;
+	return fmax ( PPS_STAMP_ERR_LIMIT * windowMedian ( &clock->ppserrs ), PPS_MIN_STAMP_ERR );
+}
 
-	ta = *(time_f*)a;
-	tb = *(time_f*)b;
+//the offsets in half of the window that are averaged - from low up to (not including) high
+static void
+clkPPSInlierRange ( const windowT* half, time_f* plow, time_f* phigh )
+{
+	time_f	median, limit;
 
-	if ( ta < tb )
-		return -1;
-	else if ( ta > tb )
-		return +1;
-	return 0;
+	median = windowMedian ( half );
+	//(a spread finer than the timestamps doesn't count)
+	limit = fmax ( PPS_OUTLIER_LIMIT * 1.4826 * windowMAD ( half, median ), PPS_MIN_STAMP_ERR );
+
+	*plow = median - limit;
+	*phigh = median + limit;
 }
 
-int
-clkCalculatePPSAverage ( clkInfoT* clock, time_f* paverage, time_f* pmaxerr )
+//the slot of the pps sample age seconds old (0 the newest)
+static int
+clkPPSSlot ( const clkInfoT* clock, int age )
 {
-	int	i;
+	return (clock->ppsindex + clock->ppssize - 1 - age) % clock->ppssize;
+}
+
+//the half of the window ppslist[i] is in, by its age - the newer half is the ppscount/2 newest
+static windowT*
+clkPPSHalf ( clkInfoT* clock, int i )
+{
+	if ( (clock->ppsindex + clock->ppssize - 1 - i) % clock->ppssize < clock->ppscount/2 )
+		return &clock->ppsnew;
+	return &clock->ppsold;
+}
+
+//(re)put ppslist[i] in the offsets' window for its half of the window
+static void
+clkAddPPSOffset ( clkInfoT* clock, int i )
+{
+	windowT	*half;
+	time_ns	offset;
 	time_f	err;
-	time_f	total_offset,average_offset;
-	int	total_count;
-	time_f	standard_deviation;
-	time_f	timediff[PPS_AVERAGE_COUNT] = { 0.0 };
 
+	half = clkPPSHalf ( clock, i );
+	windowRemove ( half == &clock->ppsold ? &clock->ppsnew : &clock->ppsold, i );
+
+	offset = clock->ppslist[i].pctime - clock->ppslist[i].radiotime;
+	err = clock->ppslist[i].err;
 
-	for ( i=0; i<PPS_AVERAGE_COUNT; i++ )
+	//(left out by the median timestamp error as it is when it comes in)
+	if ( clock->ppslist[i].pctime == 0 || llabs ( offset ) > PPS_MAX_OFFSET
+	  || err > clkPPSStampLimit ( clock ) )
 	{
-		if ( clock->ppslist[i].pctime == 0 || clock->ppslist[i].radiotime == 0 )
-			return -1;
+		windowRemove ( half, i );
+		return;
+	}
 
-		err = clock->ppslist[i].pctime - clock->ppslist[i].radiotime;
-		//if the time isn't close, don't bother tracking it...
-		if ( fabs ( err ) > 0.1 )	//within 100ms - more than this and ntpd will step the time soon
-			return -1;
+	//(1/variance weights - a stamp bracket of width w is +-w/2, uniform)
+	windowAdd ( half, i, time_ns2time_f ( offset ), time_ns2time_f ( clock->ppslist[i].pctime - clock->ppsref ),
+		1.0 / (err * err / 12 + PPS_MIN_STAMP_ERR * PPS_MIN_STAMP_ERR) );
+}
+
+//put a sample in ppslist[i] - and the average's windows
+static void
+clkSetPPSSample ( clkInfoT* clock, int i, time_ns pctime, time_ns radiotime, time_f err )
+{
+	clock->ppslist[i].pctime = pctime;
+	clock->ppslist[i].radiotime = radiotime;
+	clock->ppslist[i].err = err;
+
+	windowAdd ( &clock->ppserrs, i, err, 0, 1 );
 
-		timediff[i] = err;
+	//(a new base for the times - all of them again)
+	if ( clock->ppsref == 0 || time_ns2time_f ( pctime - clock->ppsref ) > PPS_REBASE_WINDOWS * clock->ppssize )
+	{
+		clock->ppsref = pctime;
+		for ( i=0; i<clock->ppssize; i++ )
+			clkAddPPSOffset ( clock, i );
 	}
+	else
+		clkAddPPSOffset ( clock, i );
+}
+
+//count (and log) the sample just put in ppslist[i] if it's left out of the average
+static void
+clkCountPPSSample ( clkInfoT* clock, int i )
+{
+	time_f	offset, low, high;
 
-	qsort ( timediff, PPS_AVERAGE_COUNT, sizeof(time_f), sort_timef_compare );
+	clock->ppssamples++;
 
+	offset = time_ns2time_f ( clock->ppslist[i].pctime - clock->ppslist[i].radiotime );
+	clkPPSInlierRange ( clkPPSHalf ( clock, i ), &low, &high );
 
-	total_offset = 0;
-	total_count = 0;
-	for ( i=PPS_AVERAGE_COUNT/4; i<PPS_AVERAGE_COUNT*3/4; i++ )
+	if ( llabs ( clock->ppslist[i].pctime - clock->ppslist[i].radiotime ) > PPS_MAX_OFFSET )
 	{
-		err = timediff[i];
+		clock->ppstoofar++;
+		loggerf ( LOGGER_DEBUG, "clock: pps sample "TIMEF_FORMAT"s from the radio time left out\n", offset );
+	}
+	else if ( clock->ppslist[i].err > clkPPSStampLimit ( clock ) )
+	{
+		clock->ppswide++;
+		loggerf ( LOGGER_DEBUG, "clock: pps sample's timestamp error "TIMEF_FORMAT"s (> "TIMEF_FORMAT"s) left out\n",
+			clock->ppslist[i].err, clkPPSStampLimit ( clock ) );
+	}
+	else if ( offset < low || offset >= high )
+	{
+		clock->ppsoutliers++;
+		loggerf ( LOGGER_DEBUG, "clock: pps sample offset "TIMEF_FORMAT"s an outlier (not "TIMEF_FORMAT"s to "TIMEF_FORMAT"s)\n",
+			offset, low, high );
+	}
+}
+
+void
+clkProcessPPS ( clkInfoT* clock, const timeStampT* ts )
+{
+	//cant process second pulses unless we have decoded the time...
+	if ( clock->radiotime == 0 )
+		return;
+
+	//(by the seconds' numbers - a second missed still counts)
+	clock->secondssincetime = clock->secnum - clock->timesec;
+
+	//(the window grows to ppssize - and the sample half of it old moves to the older half)
+	clock->ppsindex++;
+	clock->ppsindex %= clock->ppssize;
+	if ( clock->ppscount < clock->ppssize )
+		clock->ppscount++;
+	clkSetPPSSample ( clock, clkPPSSlot ( clock, 0 ), ts->real,
+		clock->radiotime + clock->secondssincetime * NSEC_PER_SEC, ts->err );
+	clkAddPPSOffset ( clock, clkPPSSlot ( clock, clock->ppscount/2 ) );
+	clkCountPPSSample ( clock, clkPPSSlot ( clock, 0 ) );
+
+	//once the time's confirmed, each second's sent as it starts - not just the minutes decoded
+	//(past the minute decoded, a leap second due would leave them one out)
+	if ( clkTimeConfirmed ( clock ) && (clock->radioleap != LEAP_ADDSECOND || clock->secondssincetime < 60) )
+		clkSendSecond ( clock, clock->secnum, ts->real, LOGGER_TRACE );
+}
+
+
+void
+clkProcessPMSecond ( clkInfoT* clock, int bit, const timeStampT* ts )
+{
+	int	i;
+
+	loggerf ( LOGGER_TRACE, "phase modulation second: at "TIMENS_FORMAT" +-"TIMEF_FORMAT" bit %d\n", TIMENS_ARGS(ts->real), ts->err / 2, bit );
 
-		total_offset += err;
-		total_count++;
+	clock->pmlist[clock->pmindex].time = ts->real;
+	clock->pmlist[clock->pmindex].bit = bit;
+	clock->pmindex++;
+	clock->pmindex %= CLK_PM_SECONDS;
 
+	//it's found a second or so after the carrier reduction that started the same second - a
+	//finer time for that pps sample
+	for ( i=0; i<clock->ppssize; i++ )
+	{
+		if ( clock->ppslist[i].pctime != 0
+		  && fabs ( time_ns2time_f ( ts->real - clock->ppslist[i].pctime ) ) < PM_MATCH_WINDOW )
+		{
+			clkSetPPSSample ( clock, i, ts->real, clock->ppslist[i].radiotime, ts->err );
+			break;
+		}
 	}
+}
 
-	average_offset = total_offset / total_count;
 
-	standard_deviation = 0;
-	for ( i=0; i<PPS_AVERAGE_COUNT; i++ )
+//the pc clock's offset and rate, from a line through the two halves of the window: each half's
+//middle - the (weighted) mean of its samples that aren't outliers, at their mean time - and the
+//rate between them, averaged over several windows. the line's extrapolated to when from the
+//whole window's middle, as the mean alone would lag by half a window's drift. samples are
+//weighted by their timestamp error, and a sample is left out - just that sample - if it has a
+//much wider error than usual (a late wakeup or a preempted status read), is too far from the
+//radio time, or is too far from the rest of its half (by the median absolute deviation, so a few
+//wild ones don't hide each other). only if most of a half's slots have no sample averaged is
+//there no estimate. the window grows from the time's first decode, so there's an estimate from
+//the first few seconds - with an error that shrinks as the samples come in. the samples are
+//kept in order as they come in (see window.h), so there's no sorting here
+int
+clkCalculatePPSAverage ( clkInfoT* clock, time_ns when, time_ns* poffset, time_f* pmaxerr )
+{
+	windowSumsT	inold, innew;
+	time_ns		newest;
+	time_f		low, high, tbar, xbar, a, spreadold, spreadnew, spread, dt, weight, gain, rate, ahead;
+	int		oldfrom, oldto, newfrom, newto, nold, nnew, half;
+
+	clkPPSInlierRange ( &clock->ppsold, &low, &high );
+	oldfrom = windowRank ( &clock->ppsold, low );
+	oldto = windowRank ( &clock->ppsold, high );
+	clkPPSInlierRange ( &clock->ppsnew, &low, &high );
+	newfrom = windowRank ( &clock->ppsnew, low );
+	newto = windowRank ( &clock->ppsnew, high );
+
+	//(the newer half has ppscount/2 slots, the older the rest)
+	nold = oldto - oldfrom;
+	nnew = newto - newfrom;
+	half = clock->ppscount / 2;
+	if ( nold < PPS_MIN_HALF || nnew < PPS_MIN_HALF || 2 * nold < clock->ppscount - half || 2 * nnew < half )
 	{
-		if ( clock->ppslist[i].pctime == 0 || clock->ppslist[i].radiotime == 0 )
-			continue;
+		if ( clock->ppscount == clock->ppssize )
+			loggerf ( LOGGER_DEBUG, "clock: no pps average - only %d of %d and %d of %d samples agree\n",
+				nold, clock->ppscount - half, nnew, half );
+		return -1;
+	}
 
-		err = (clock->ppslist[i].pctime - clock->ppslist[i].radiotime) - average_offset;
+	windowSums ( &clock->ppsold, oldfrom, oldto, &inold );
+	windowSums ( &clock->ppsnew, newfrom, newto, &innew );
 
-		standard_deviation += err*err;
+	//the rate between the halves - averaged with the ones before, weighted by how sure each is (the
+	//halves' middles are each about sd/sqrt(n) out, dt apart), once for each new sample. once it's
+	//had a few windows' worth it's an exponential average, so it follows the pc clock's rate
+	dt = innew.wt / innew.w - inold.wt / inold.w;
+	weight = dt * dt / (1.0 / nold + 1.0 / nnew);
+	newest = clock->ppslist[clkPPSSlot ( clock, 0 )].pctime;
+	if ( newest != clock->freqtime )
+	{
+		clock->freqtime = newest;
+		clock->freqcount++;
+		clock->freqweight += weight;
+		gain = weight / clock->freqweight;
+		if ( gain < 1.0 / (PPS_FREQ_WINDOWS * clock->ppssize) )
+		{
+			//(which averages about 2/gain of them)
+			gain = 1.0 / (PPS_FREQ_WINDOWS * clock->ppssize);
+			clock->freqweight = 2 * weight / gain;
+		}
+		clock->frequency += gain * ( (innew.wx / innew.w - inold.wx / inold.w) / dt - clock->frequency );
 	}
-	standard_deviation /= total_count;
-	standard_deviation = sqrt ( standard_deviation );
 
-	*paverage = average_offset;
-	*pmaxerr = standard_deviation;	//over50%   * 2.0;	//over 90% of the values should be in this range...
+	//the spread of the offsets from the line (at the rate averaged) through the window's middle
+	tbar = (inold.wt + innew.wt) / (inold.w + innew.w);
+	xbar = (inold.wx + innew.wx) / (inold.w + innew.w);
+	a = xbar - clock->frequency * tbar;
+	spreadold = windowSpread ( &clock->ppsold, oldfrom, oldto, a, clock->frequency );
+	spreadnew = windowSpread ( &clock->ppsnew, newfrom, newto, a, clock->frequency );
+	spread = (nold * spreadold * spreadold + nnew * spreadnew * spreadnew) / (nold + nnew);
+
+	//how sure the rate is: one estimate's (dt apart) over how many were averaged - of which one a
+	//window's length apart is news
+	clock->freqvar = spread / weight / fmax ( 1.0, clock->freqweight / weight / clock->ppscount );
+
+	//extrapolated to when - by the rate, taken down towards 0 as far as it's no surer than its
+	//noise (extrapolating by a rate that's mostly noise costs more than the drift it corrects)
+	rate = 0;
+	if ( clock->frequency != 0 )
+		rate = clock->frequency * clock->frequency * clock->frequency
+			/ (clock->frequency * clock->frequency + clock->freqvar);
+	ahead = time_ns2time_f ( when - clock->ppsref ) - tbar;
+	*poffset = time_f2time_ns ( xbar + rate * ahead );
+
+	//how far out that could be: the middle's standard error (the spread's from the line, the line
+	//fitted to these samples too, early on) and the rate's over the time to when (as measured -
+	//taken down, it's out by about as much) - not less than the timestamps' resolution
+	*pmaxerr = fmax ( sqrt ( spread / (nold + nnew - 2) + clock->freqvar * ahead * ahead ), PPS_MIN_STAMP_ERR );
 
 	return 0;
 }
-
@@ -4,9 +4,17 @@
 #include "systime.h"
 #include "timef.h"
 #include "shm.h"
+#include "pulse.h"
+#include "vote.h"
+#include "flywheel.h"
+#include "window.h"
 
 
-#define	PPS_AVERAGE_COUNT		(60)
+#define	PPS_MIN_AVERAGE			(8)	//seconds the pps average can be over (averageSeconds)
+#define	PPS_MAX_AVERAGE			(3600)
+#define	CLK_PM_SECONDS			(64)	//DCF77 phase modulation seconds kept
+#define	CLK_SECONDS			(120)	//seconds kept - a complete minute is in there somewhere
+#define	CLK_ERASED			(-1)	//data[] for a second that couldn't be read
 
 #define CLOCKTYPE_DCF77	0
 #define CLOCKTYPE_MSF	1
@@ -22,28 +30,93 @@ struct clkInfoS
 	time_f	fudgeoffset;	//added to the recieved time - used to correct for recieve delays
 
 	int	status;
-	time_f	changetime;
+	timeStampT	changetime;
 
 
-	//store 2 minutes of data - there will be a complete minute of data in here somewhere...
-	signed char	data[120];
+	//the seconds as they come in, numbered by the time they start (their carrier reduction) -
+	//second n is in sec[n % CLK_SECONDS]. one that can't be read is erased, rather than lose the
+	//rest of the minute with it
+	struct
+	{
+		int		num;		//the second's number - if it isn't n, second n is erased
+		signed char	val;		//as data[]
+		time_f		width;
+		float		cost[2];
+	} sec[CLK_SECONDS];
+	int		secnum;		//the second now - the last whose start fell on a second
+	flywheelT	flywheel;	//where the seconds start (see flywheel.h)
+	int		pulsesec;	//the second the pulse now (or last) started - -1 if not a second's
+	int		unmatched;	//pulse starts since the last that fell on a second
+	int		timesec;	//the second the decoded time is for (its minute's second 0)
+	time_ns		heldtime;	//a time decoded that didn't follow on from the one before, for
+	int		heldsec;	//second heldsec - taken if the next minute's agrees (0 for none)
+	int		confirmed;	//the time's been decoded twice, the second following on from the first
+
+	//the minute being decoded, from sec[]: data[numdata-60+s] is its second s (CLK_ERASED if
+	//it couldn't be read) - and how sure each one is: the length of the second's pulse, and the
+	//cost of each of its bits being the other way (see pulseCost() - [0] is the bit, or MSF's A
+	//bit, [1] MSF's B bit)
+	signed char	data[60];
 	int		numdata;
+	time_f		width[60];
+	float		cost[60][2];
 
 	int		msf_skip_b;	//set to 1 if we have a 100ms high after a 100ms low
 
-	time_f		pctime;
-	time_f		radiotime;
+	pulseClassT	pulses;		//the receiver's actual pulse widths, as learned
+	voteT		votes;		//the minutes before, to vote with
+
+	time_ns		pctime;
+	time_ns		radiotime;
 	int		radioleap;
 	int		clocktype;	// The clock type. See CLOCKTYPE_
 
 	int	secondssincetime;
 
+	//the last time sent to ntpd - and the second it was for. once the time's confirmed every
+	//second is sent, from its start - one whose start doesn't come is sent from the flywheel
+	//(holdover) while it can be trusted
+	time_ns		sentradio;
+	time_ns		sentpc;
+	time_f		senterr;
+	int		sentsec;
+	int		sentholdover;	//whether it came from the flywheel
+	unsigned long	sent;		//times sent
+	unsigned long	holdovers;	//of them from the flywheel
+	unsigned long	sentraw;	//of them without a pps average (just the second's start)
+
+	//the pps samples - ppscount of them, in a window that grows to ppssize (averageSeconds when the
+	//clock was made) from the time's first decode
 	struct
 	{
-		time_f	pctime;
-		time_f	radiotime;
-	} ppslist[PPS_AVERAGE_COUNT];
+		time_ns	pctime;
+		time_ns	radiotime;
+		time_f	err;		//timestamp error (bracket width) of pctime
+	} *ppslist;
+	int	ppssize;
+	int	ppscount;
 	int	ppsindex;
+	windowT	ppsold;		//their offsets (pctime - radiotime, seconds) in order - the older half
+	windowT	ppsnew;		//of the samples and the newer, less any left out (times from ppsref)
+	windowT	ppserrs;	//all their timestamp errors, in order
+	time_ns	ppsref;
+	time_f	frequency;	//the pc clock's rate against the radio time's, as estimated (averaged) -
+	time_f	freqvar;	//and its variance
+	time_ns	freqtime;	//the newest sample when it was last averaged in
+	unsigned long	freqcount;	//estimates averaged in
+	time_f	freqweight;	//and their weights
+	unsigned long	ppssamples;	//samples since start
+	unsigned long	ppstoofar;	//of them left out of the average as they came in: too far from the
+	unsigned long	ppswide;	//radio time, with a much wider timestamp error than usual, or
+	unsigned long	ppsoutliers;	//too far from the rest (see clkCalculatePPSAverage())
+
+	//DCF77 phase modulation seconds (iq input only) - to check the minute's bits against
+	struct
+	{
+		time_ns	time;
+		int	bit;
+	} pmlist[CLK_PM_SECONDS];
+	int	pmindex;
 
 	shmTimeT*	shm;
 };
@@ -52,21 +125,55 @@ struct clkInfoS
 void clkDumpData ( const clkInfoT* clock );
 
 clkInfoT* clkCreate ( int inverted, int shmunit, time_f fudgeoffset, int clocktype );
+void clkFree ( clkInfoT* clock );
 
+//forget the seconds received
 void clkDataClear ( clkInfoT* clock );
 
-int clkPulseLength ( time_f timef, int clocktype );
+//a data[] value's bit b (0, or 1 for MSF's B bit) - or -1 if it has no such bit (a marker)
+int clkBitValue ( int clocktype, int val, int b );
+//the value with bit b flipped (the same, if it has no such bit)
+int clkFlipValue ( int clocktype, int val, int b );
+//flip bit b of data[i]
+void clkFlipBit ( clkInfoT* clock, int i, int b );
+
+//soft decision decoding: the bits given are seconds of the minute ending at data[numdata-1],
+//times 2, plus b. finds the likeliest bits, of up to CLK_MAX_FLIPS of them, to flip to make
+//valid ( clock, group ) true - and flips them, if they're cheap enough and clearly the best. one
+//erased bit is filled in the same way (any more is too much guessing). returns the number
+//flipped (0 if it's valid as it is), or -1 if there's no such fix
+#define	CLK_MAX_FLIPS		(3)
+int clkCorrectBits ( clkInfoT* clock, const int* bits, int numbits, int (*valid) ( clkInfoT*, int ), int group, float* pcost );
+
+//pulse lengths are measured on ts->mono, the times sent to ntpd come from ts->real
+void clkProcessStatusChange ( clkInfoT* clock, int Status, const timeStampT* ts );
+
+//the line's edge counts show lost edges before this status - instead of clkProcessStatusChange()
+//(ts is when they were found - the lost edges happened some time before it)
+void clkLostEdges ( clkInfoT* clock, int lost, int status, const timeStampT* ts );
+
+//send the minute just decoded (unless its second's been sent already)
+void clkSendTime ( clkInfoT* clock );
 
+//send the time for a second that's gone by without its start, from the flywheel - if it's due
+//by now (the edges' ts, or the time now, for a clock whose line has gone quiet)
+void clkHoldover ( clkInfoT* clock, const timeStampT* now );
 
-void clkProcessStatusChange ( clkInfoT* clock, int Status, time_f timef );
+//ms until clkHoldover() might send a time - -1 if it won't
+int clkHoldoverTimeout ( const clkInfoT* clock, const timeStampT* now );
 
-void clkSendTime ( clkInfoT* clock );
+//a second's start (ts) - a sample for the average, and the second's time sent
+void clkProcessPPS ( clkInfoT* clock, const timeStampT* ts );
 
-void clkProcessPPS ( clkInfoT* clock, time_f timef );
+//a second found by DCF77's phase modulation (ts is when it started) - a finer time for the
+//second's pps sample, and the bit again
+void clkProcessPMSecond ( clkInfoT* clock, int bit, const timeStampT* ts );
 
 //void clkDumpPPS ( clkInfoT* clock );
 
-int clkCalculatePPSAverage ( clkInfoT* clock, time_f* paverage, time_f* pdeviation );
+//the pc clock's offset from the radio time (pctime - radiotime) at when, from the pps samples -
+//and how far out that could be (its standard error). -1 if there's no estimate
+int clkCalculatePPSAverage ( clkInfoT* clock, time_ns when, time_ns* poffset, time_f* pmaxerr );
 
 
 #endif
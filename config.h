@@ -7,7 +7,7 @@
 
 #if HAVE_DECL_TIOCMIWAIT && HAVE_ALARM
 // ioctl(serialfd,TIOCMIWAIT,..) waits for a serial interrupt
-// alarm() is used as a timeout on the above
+// (in a waiter thread - the main loop notices when it has been quiet too long)
 # define ENABLE_TIOCMIWAIT
 #endif
 
@@ -31,4 +31,20 @@
 #define ENABLE_GPIO
 #endif
 
+#ifdef __linux__
+// timerfd - lets poll mode sleep until an absolute deadline with sub-millisecond resolution
+# define ENABLE_TIMERFD
+
+// ioctl(serialfd,TIOCGICOUNT,..) - the kernel's count of modem line interrupts,
+// so edges that came too close together to be read separately are noticed
+# define ENABLE_TIOCGICOUNT
+
+// GPIO character device (/dev/gpiochipN) with kernel edge timestamps -
+// needs the v2 uAPI (linux 5.10)
+# include <linux/version.h>
+# if LINUX_VERSION_CODE >= KERNEL_VERSION(5,10,0)
+#  define ENABLE_GPIOCDEV
+# endif
+#endif
+
 #endif
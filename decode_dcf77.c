@@ -45,7 +45,8 @@
 //all these macros assume the following:
 //1. clock is a variable for the current clock
 //2. the index used is the second index
-#define	DATA_OK(bit)	((clock->numdata-60+(bit)) >= 0 && (clock->numdata-60+(bit)) < clock->numdata)
+#define	DATA_OK(bit)	((clock->numdata-60+(bit)) >= 0 && (clock->numdata-60+(bit)) < clock->numdata \
+			 && clock->data[clock->numdata-60+(bit)] != CLK_ERASED)
 #define	GET_DATA(bit)	(DATA_OK(bit) ? clock->data[clock->numdata-60+(bit)] : 0)
 #define	GET(bit)	(GET_DATA(bit)==2)
 
@@ -85,6 +86,58 @@ dcf77GetBCD ( clkInfoT* clock, int valstart, int valcount )
 	return val;
 }
 
+//the groups the minute is checked (and corrected) in - the start bit and Z1/Z2, then each of
+//the parity groups. bits are seconds times 2 (see clkCorrectBits())
+#define	DCF77_GROUPS	(4)
+
+static const int dcf77Bits0[] = { 17*2, 18*2, 20*2 };
+static const int dcf77Bits1[] = { 21*2, 22*2, 23*2, 24*2, 25*2, 26*2, 27*2, 28*2 };
+static const int dcf77Bits2[] = { 29*2, 30*2, 31*2, 32*2, 33*2, 34*2, 35*2 };
+static const int dcf77Bits3[] = { 36*2, 37*2, 38*2, 39*2, 40*2, 41*2, 42*2, 43*2, 44*2, 45*2, 46*2, 47*2,
+	48*2, 49*2, 50*2, 51*2, 52*2, 53*2, 54*2, 55*2, 56*2, 57*2, 58*2 };
+
+static const int* dcf77GroupBits[DCF77_GROUPS] = { dcf77Bits0, dcf77Bits1, dcf77Bits2, dcf77Bits3 };
+static const int dcf77GroupSize[DCF77_GROUPS] = { 3, 8, 7, 23 };
+
+//whether a group's bits make sense - the parity, and the values (BCD digits, ranges, and that
+//the date exists and is on that day of the week)
+static int
+dcf77ValidGroup ( clkInfoT* clock, int group )
+{
+	int	mday, wday, mon;
+
+	switch ( group )
+	{
+	case 0:
+		return GET(20) && (GET(17) ^ GET(18));
+
+	case 1:
+		return !dcf77CheckParity ( clock, 21, 7, 28 )
+			&& dcf77GetBCD ( clock, 21, 4 ) <= 9 && dcf77GetBCD ( clock, 21, 7 ) <= 59;
+
+	case 2:
+		return !dcf77CheckParity ( clock, 29, 6, 35 )
+			&& dcf77GetBCD ( clock, 29, 4 ) <= 9 && dcf77GetBCD ( clock, 29, 6 ) <= 23;
+
+	case 3:
+		if ( dcf77CheckParity ( clock, 36, 22, 58 ) )
+			return 0;
+		if ( dcf77GetBCD ( clock, 36, 4 ) > 9 || dcf77GetBCD ( clock, 45, 4 ) > 9
+		  || dcf77GetBCD ( clock, 50, 4 ) > 9 || dcf77GetBCD ( clock, 54, 4 ) > 9 )
+			return 0;
+
+		mday = dcf77GetBCD ( clock, 36, 6 );
+		wday = dcf77GetBCD ( clock, 42, 3 );
+		mon = dcf77GetBCD ( clock, 45, 5 );
+		if ( wday < 1 || mon < 1 || mon > 12 )
+			return 0;
+
+		return UTCcheckDate ( dcf77GetBCD ( clock, 50, 8 ) + CENTURY, mon - 1, mday, wday % 7 );
+	}
+
+	return 0;
+}
+
 void
 dcf77Dump ( clkInfoT* clock )
 {
@@ -102,33 +155,36 @@ dcf77Dump ( clkInfoT* clock )
 }
 
 int
-dcf77Decode ( clkInfoT* clock, time_f minstart )
+dcf77Decode ( clkInfoT* clock, time_ns minstart )
 {
 	struct tm	dectime;
 	time_t		dectimet;
+	float		cost, totalcost;
+	int		g, n, flips;
 
 	dcf77Dump ( clock );
 
-	if ( !DATA_OK(15) )
-		return -1;
-
-
-	if ( !GET(20) )	//start bit
-		return -1;
-
-
-	if ( dcf77CheckParity ( clock, 21, 7, 28 ) )	//minutes parity
-		return -1;
-
-	if ( dcf77CheckParity ( clock, 29, 6, 35 ) )	//hours parity
-		return -1;
-
-	if ( dcf77CheckParity ( clock, 36, 22, 58 ) )	//day/dow/month/year parity
-		return -1;
+	//start bit, Z1/Z2 (only one should be set), then the minutes, hours and
+	//day/dow/month/year parity - flipping the likeliest wrong bits if they don't check, and
+	//filling in one that's erased. (the weather bits 1-14 don't matter, and the flags - 15, 16
+	//and 19 - read as clear if they're erased)
+	flips = 0;
+	totalcost = 0;
+	for ( g=0; g<DCF77_GROUPS; g++ )
+	{
+		n = clkCorrectBits ( clock, dcf77GroupBits[g], dcf77GroupSize[g], dcf77ValidGroup, g, &cost );
+		if ( n < 0 )
+			return -1;
 
+		flips += n;
+		totalcost += cost;
+	}
 
-	if ( !(GET(17) ^ GET(18)) )	//only one of Z1/Z2 should be set
-		return -1;
+	if ( flips > 0 )
+	{
+		loggerf ( LOGGER_DEBUG, "DCF77: corrected %d bits (cost %.1f)\n", flips, totalcost );
+		dcf77Dump ( clock );
+	}
 
 	memset ( &dectime, 0, sizeof(dectime) );
 
@@ -177,7 +233,7 @@ dcf77Decode ( clkInfoT* clock, time_f minstart )
 	//right - the time seems OK now...
 
 	clock->pctime = minstart;
-	clock->radiotime = dectimet + clock->fudgeoffset;
+	clock->radiotime = (time_ns)dectimet * NSEC_PER_SEC + time_f2time_ns ( clock->fudgeoffset );
 	clock->radioleap = GET(19) ? LEAP_ADDSECOND : LEAP_NOWARNING;
 
 	clock->secondssincetime = 0;
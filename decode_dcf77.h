@@ -3,7 +3,7 @@
 
 
 
-int dcf77Decode ( clkInfoT* clock, time_f minstart );
+int dcf77Decode ( clkInfoT* clock, time_ns minstart );
 
 
 #endif
@@ -45,7 +45,8 @@
 //all these macros assume the following:
 //1. clock is a variable for the current clock
 //2. the index used is that in ctm001v03.pdf docs - see http://www.npl.co.uk/npl/ctm/msf.html
-#define	DATA_OK(bit)	((clock->numdata-60+(bit)) >= 0 && (clock->numdata-60+(bit)) < clock->numdata)
+#define	DATA_OK(bit)	((clock->numdata-60+(bit)) >= 0 && (clock->numdata-60+(bit)) < clock->numdata \
+			 && clock->data[clock->numdata-60+(bit)] != CLK_ERASED)
 #define	GET_DATA(bit)	(DATA_OK(bit) ? clock->data[clock->numdata-60+(bit)] : 0)
 #define	GET_A(bit)	((GET_DATA(bit)==2)||(GET_DATA(bit)==3))
 #define	GET_B(bit)	((GET_DATA(bit)==3)||(GET_DATA(bit)==11))
@@ -97,6 +98,57 @@ msfGetBCDA ( clkInfoT* clock, int valstart, int valcount )
 	return val;
 }
 
+//the groups the minute is checked (and corrected) in - each parity group, the year first as the
+//date's check needs it, and the date before the day of the week. bits are seconds times 2, plus
+//1 for a B bit (see clkCorrectBits())
+#define	MSF_GROUPS	(4)
+
+static const int msfBits0[] = { 17*2, 18*2, 19*2, 20*2, 21*2, 22*2, 23*2, 24*2, 54*2+1 };
+static const int msfBits1[] = { 25*2, 26*2, 27*2, 28*2, 29*2, 30*2, 31*2, 32*2, 33*2, 34*2, 35*2, 55*2+1 };
+static const int msfBits2[] = { 36*2, 37*2, 38*2, 56*2+1 };
+static const int msfBits3[] = { 39*2, 40*2, 41*2, 42*2, 43*2, 44*2, 45*2, 46*2, 47*2, 48*2, 49*2, 50*2,
+	51*2, 57*2+1 };
+
+static const int* msfGroupBits[MSF_GROUPS] = { msfBits0, msfBits1, msfBits2, msfBits3 };
+static const int msfGroupSize[MSF_GROUPS] = { 9, 12, 4, 14 };
+
+//whether a group's bits make sense - the parity, and the values (BCD digits, ranges, and that
+//the date exists and is on that day of the week)
+static int
+msfValidGroup ( clkInfoT* clock, int group )
+{
+	int	year, mon, mday;
+
+	switch ( group )
+	{
+	case 0:
+		return msfCheckParity ( clock, 17, 8, 54 )
+			&& msfGetBCDA ( clock, 17, 4 ) <= 9 && msfGetBCDA ( clock, 21, 4 ) <= 9;
+
+	case 1:
+	case 2:
+		if ( group == 1 && !msfCheckParity ( clock, 25, 11, 55 ) )
+			return 0;
+		if ( group == 2 && !msfCheckParity ( clock, 36, 3, 56 ) )
+			return 0;
+
+		year = msfGetBCDA ( clock, 17, 8 ) + CENTURY;
+		mon = msfGetBCDA ( clock, 25, 5 );
+		mday = msfGetBCDA ( clock, 30, 6 );
+		if ( msfGetBCDA ( clock, 26, 4 ) > 9 || msfGetBCDA ( clock, 32, 4 ) > 9 || mon < 1 || mon > 12 )
+			return 0;
+
+		return UTCcheckDate ( year, mon - 1, mday, group == 2 ? msfGetBCDA ( clock, 36, 3 ) : -1 );
+
+	case 3:
+		return msfCheckParity ( clock, 39, 13, 57 )
+			&& msfGetBCDA ( clock, 41, 4 ) <= 9 && msfGetBCDA ( clock, 39, 6 ) <= 23
+			&& msfGetBCDA ( clock, 48, 4 ) <= 9 && msfGetBCDA ( clock, 45, 7 ) <= 59;
+	}
+
+	return 0;
+}
+
 void
 msfDump ( clkInfoT* clock )
 {
@@ -121,31 +173,40 @@ msfDump ( clkInfoT* clock )
 
 
 int
-msfDecode ( clkInfoT* clock, time_f minstart )
+msfDecode ( clkInfoT* clock, time_ns minstart )
 {
 //	int	year, month, mday, wday, hour, min;
 	struct tm	dectime;
 	time_t		dectimet;
+	float		cost, totalcost;
+	int		g, n, flips;
 
 	msfDump ( clock );
 
-	//make sure the earliest bit we look at is there.. (start of year)
-	if ( !DATA_OK(17) )
+	//make sure BST is there - the rest is checked by the parity groups (DUT1 and the
+	//other positions that aren't used don't matter)
+	if ( !DATA_OK(58) )
 		return -1;
 
-	//first, check that the parity bits make sense...
-
-	if ( !msfCheckParity ( clock, 17, 8, 54 ) )	//year...
-		return -1;
-
-	if ( !msfCheckParity ( clock, 25, 11, 55 ) )	//month/month day...
-		return -1;
+	//first, check that the parity bits (year, month/month day, day of week, hour/minute) and
+	//the values make sense - flipping the likeliest wrong bits if they don't
+	flips = 0;
+	totalcost = 0;
+	for ( g=0; g<MSF_GROUPS; g++ )
+	{
+		n = clkCorrectBits ( clock, msfGroupBits[g], msfGroupSize[g], msfValidGroup, g, &cost );
+		if ( n < 0 )
+			return -1;
 
-	if ( !msfCheckParity ( clock, 36, 3, 56 ) )	//day of week...
-		return -1;
+		flips += n;
+		totalcost += cost;
+	}
 
-	if ( !msfCheckParity ( clock, 39, 13, 57 ) )	//hour/minute...
-		return -1;
+	if ( flips > 0 )
+	{
+		loggerf ( LOGGER_DEBUG, "MSF: corrected %d bits (cost %.1f)\n", flips, totalcost );
+		msfDump ( clock );
+	}
 
 	memset ( &dectime, 0, sizeof(dectime) );
 
@@ -187,7 +248,7 @@ msfDecode ( clkInfoT* clock, time_f minstart )
 	//right - the time seems OK now...
 
 	clock->pctime = minstart;
-	clock->radiotime = dectimet + clock->fudgeoffset;
+	clock->radiotime = (time_ns)dectimet * NSEC_PER_SEC + time_f2time_ns ( clock->fudgeoffset );
 	clock->radioleap = LEAP_NOWARNING;
 
 	clock->secondssincetime = 0;
@@ -4,6 +4,6 @@
 #include "clock.h"
 
 
-int msfDecode ( clkInfoT* clock, time_f minstart );
+int msfDecode ( clkInfoT* clock, time_ns minstart );
 
 #endif
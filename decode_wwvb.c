@@ -42,7 +42,8 @@
 //all these macros assume the following:
 //1. clock is a variable for the current clock
 //2. the index used is the second index
-#define	DATA_OK(bit)	((clock->numdata-60+(bit)) >= 0 && (clock->numdata-60+(bit)) < clock->numdata)
+#define	DATA_OK(bit)	((clock->numdata-60+(bit)) >= 0 && (clock->numdata-60+(bit)) < clock->numdata \
+			 && clock->data[clock->numdata-60+(bit)] != CLK_ERASED)
 #define	GET_DATA(bit)	(DATA_OK(bit) ? clock->data[clock->numdata-60+(bit)] : 0)
 #define	GET(bit)	(GET_DATA(bit)==5)
 
@@ -60,6 +61,9 @@ wwvbGetBCD ( clkInfoT* clock, int valstart, int valcount )
 
 	for ( i=0; i<valcount; i++ )
 	{
+		//(a bit that's erased makes it unknown - unless it's one of the unused positions)
+		if ( BCD [ 12 - valcount + i ] && !DATA_OK(valstart+i) )
+			return -1;
 		if ( GET(valstart+i) )
 			val += BCD [ 12 - valcount + i ];
 	}
@@ -85,14 +89,16 @@ wwvbDump ( clkInfoT* clock )
 
 
 int
-wwvbDecode ( clkInfoT* clock, time_f minstart )
+wwvbDecode ( clkInfoT* clock, time_ns minstart )
 {
 	struct tm	dectime;
 	time_t		dectimet;
 
 	wwvbDump ( clock );
 
-	if ( !DATA_OK(1) )
+	//(every bit of each value has to be there)
+	if ( wwvbGetBCD ( clock, 44, 10 ) < 0 || wwvbGetBCD ( clock, 22, 12 ) < 0
+	  || wwvbGetBCD ( clock, 12, 7 ) < 0 || wwvbGetBCD ( clock, 1, 8 ) < 0 )
 		return -1;
 
 	memset ( &dectime, 0, sizeof(dectime) );
@@ -118,14 +124,9 @@ wwvbDecode ( clkInfoT* clock, time_f minstart )
                 WWVB Sends the on-time marker, which is back-to-back 0.8s pulses
                 and THEN the time at that marker. So, we need to always move the
                 time forward one minute to be correct.
+                (a minute of 60 is left for UTCtime() to carry into the hour, day
+                and year - doing it here missed the day at midnight)
         */
-	if ( dectime.tm_min == 60 ) {
-		dectime.tm_min = 0;
-		dectime.tm_hour++;
-		if ( dectime.tm_hour > 23 ) {
-			dectime.tm_hour = 0;
-		}
-	}
 
 	loggerf ( LOGGER_DEBUG, "WWVB time: %04d-%03d %02d:%02d %s%s\n", dectime.tm_year+1900, dectime.tm_mday, dectime.tm_hour, dectime.tm_min, GET(55)?" leap year":"", GET(56)?" leap second soon":"" );
 
@@ -134,7 +135,7 @@ wwvbDecode ( clkInfoT* clock, time_f minstart )
 		return -1;
 
 	clock->pctime = minstart;
-	clock->radiotime = dectimet + clock->fudgeoffset;
+	clock->radiotime = (time_ns)dectimet * NSEC_PER_SEC + time_f2time_ns ( clock->fudgeoffset );
 	clock->radioleap = GET(56) ? LEAP_ADDSECOND : LEAP_NOWARNING;
 
 	clock->secondssincetime = 0;
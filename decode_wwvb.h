@@ -4,6 +4,6 @@
 #include "clock.h"
 
 
-int wwvbDecode ( clkInfoT* clock, time_f minstart );
+int wwvbDecode ( clkInfoT* clock, time_ns minstart );
 
 #endif
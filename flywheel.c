@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2002 Jon Atkins http://www.jonatkins.com/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include "config.h"
+
+#include <math.h>
+
+#include "flywheel.h"
+
+
+#define	FLYWHEEL_GAIN		(0.02)		//the loop's phase gain, once it's settled (a 50s time constant)
+#define	FLYWHEEL_SETTLE		(20)		//starts tracked before it's believed
+#define	FLYWHEEL_WINDOW		(0.100)		//how far a start can be from expected - until settled, and at most
+#define	FLYWHEEL_MIN_WINDOW	(0.020)		//and at least
+#define	FLYWHEEL_SIGMAS		(5.0)		//the window, in the starts' rms errors
+#define	FLYWHEEL_WANDER		(20e-6)		//how far out the rate might be, once settled - the window (and the
+						//error) grows by this much for each second without a start
+#define	FLYWHEEL_MAX_RATE	(500e-6)	//furthest the pc's clock is believed to be from the seconds
+#define	FLYWHEEL_RMS_WEIGHT	(16)		//the rms is averaged over about this many starts
+
+
+void
+flywheelInit ( flywheelT* fw )
+{
+	fw->sec = 0;
+	fw->start = 0;
+	fw->period = 1.0;
+	fw->rms = FLYWHEEL_WINDOW / FLYWHEEL_SIGMAS;
+	fw->count = 0;
+}
+
+void
+flywheelStart ( flywheelT* fw, int sec, time_ns mono )
+{
+	fw->sec = sec;
+	fw->start = mono;
+	fw->rms = FLYWHEEL_WINDOW / FLYWHEEL_SIGMAS;
+	fw->count = 1;
+}
+
+time_ns
+flywheelPredict ( const flywheelT* fw, int sec )
+{
+	return fw->start + time_f2time_ns ( (sec - fw->sec) * fw->period );
+}
+
+int
+flywheelSettled ( const flywheelT* fw )
+{
+	return fw->count >= FLYWHEEL_SETTLE;
+}
+
+time_f
+flywheelError ( const flywheelT* fw, time_ns mono )
+{
+	return fw->rms + FLYWHEEL_WANDER * fabs ( time_ns2time_f ( mono - fw->start ) );
+}
+
+//how far from expected a start at mono can be
+static time_f
+flywheelWindow ( const flywheelT* fw, time_ns mono )
+{
+	if ( !flywheelSettled ( fw ) )
+		return FLYWHEEL_WINDOW;
+
+	return fmin ( fmax ( FLYWHEEL_SIGMAS * fw->rms, FLYWHEEL_MIN_WINDOW )
+		+ FLYWHEEL_WANDER * time_ns2time_f ( mono - fw->start ), FLYWHEEL_WINDOW );
+}
+
+int
+flywheelMatch ( const flywheelT* fw, int after, time_ns mono )
+{
+	time_f	since;
+	long	k;
+
+	if ( fw->count == 0 )
+		return -1;
+
+	since = time_ns2time_f ( mono - fw->start );
+	k = lround ( since / fw->period );
+
+	if ( fw->sec + k <= after || fabs ( since - k * fw->period ) > flywheelWindow ( fw, mono ) )
+		return -1;
+
+	return fw->sec + k;
+}
+
+void
+flywheelTrack ( flywheelT* fw, int sec, time_ns mono )
+{
+	time_ns	expect;
+	time_f	err, gain;
+	int	k;
+
+	k = sec - fw->sec;
+	if ( fw->count == 0 || k < 1 )
+	{
+		flywheelStart ( fw, sec, mono );
+		return;
+	}
+
+	expect = flywheelPredict ( fw, sec );
+	err = time_ns2time_f ( mono - expect );
+	fw->count++;
+
+	//(a loop that starts wide open and narrows as the starts come in - critically damped, so
+	//the rate gain is a quarter of the phase gain squared. the rate's from the error over all
+	//the seconds since the last start)
+	gain = fmax ( 1.0 / fw->count, FLYWHEEL_GAIN );
+
+	fw->sec = sec;
+	fw->start = expect + time_f2time_ns ( gain * err );
+	fw->period += gain * gain / 4 * err / k;
+	fw->period = fmin ( fmax ( fw->period, 1.0 - FLYWHEEL_MAX_RATE ), 1.0 + FLYWHEEL_MAX_RATE );
+
+	err = fmin ( fabs ( err ), FLYWHEEL_WINDOW );
+	fw->rms = sqrt ( fw->rms * fw->rms + ( err * err - fw->rms * fw->rms ) / ( fw->count < FLYWHEEL_RMS_WEIGHT ? fw->count : FLYWHEEL_RMS_WEIGHT ) );
+}
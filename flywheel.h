@@ -0,0 +1,43 @@
+#ifndef FLYWHEEL_H_
+#define FLYWHEEL_H_
+
+#include "timef.h"
+
+//the seconds' flywheel: a phase locked loop on when each second starts (on the pc's monotonic
+//clock) - its phase, and its rate against the pc's clock. the seconds are numbered by where it
+//says they'll start, a start too far from that is taken for a glitch, and when the signal goes
+//the seconds can be carried on from it for a while (with an error that grows as they go)
+
+typedef struct
+{
+	int	sec;		//the second last tracked...
+	time_ns	start;		//...and when the loop has it starting (ts->mono)
+	time_f	period;		//a second's length by the pc's clock
+	time_f	rms;		//of the starts' errors from where they were expected
+	int	count;		//starts tracked since it was last started - 0 for none yet
+} flywheelT;
+
+
+void flywheelInit ( flywheelT* fw );
+
+//start again from second sec starting at mono (the rate learned is kept)
+void flywheelStart ( flywheelT* fw, int sec, time_ns mono );
+
+//the second that a start at mono is (after second after) - or -1 if it isn't near enough to one
+int flywheelMatch ( const flywheelT* fw, int after, time_ns mono );
+
+//second sec started at mono - steer the loop to it
+void flywheelTrack ( flywheelT* fw, int sec, time_ns mono );
+
+//when second sec should start (ts->mono)
+time_ns flywheelPredict ( const flywheelT* fw, int sec );
+
+//whether the loop has had enough starts to be believed - to narrow its window, and carry on without them
+int flywheelSettled ( const flywheelT* fw );
+
+//how far out a start predicted at mono could be (from the jitter seen, and how long it's been
+//since a start was tracked)
+time_f flywheelError ( const flywheelT* fw, time_ns mono );
+
+
+#endif
@@ -0,0 +1,338 @@
+/*
+ * Copyright (c) 2002 Jon Atkins http://www.jonatkins.com/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+
+#include "iq.h"
+#include "logger.h"
+#include "memory.h"
+
+
+#define	IQ_CUTOFF	(1000.0)	//fir low pass (Hz) - the keying is much slower than this
+#define	IQ_SCALE	(200.0)		//magnitude (in 8 bit steps) to the detector's samples
+
+
+iqInT*
+iqOpen ( int fd, int rate, int centre )
+{
+	iqInT*	in;
+	double	fc, x, sum;
+	int	i;
+
+	if ( rate < IQ_MIN_RATE || rate > IQ_MAX_RATE )
+	{
+		loggerf ( LOGGER_NOTE, "Error: iq sample rate must be %d to %d\n", IQ_MIN_RATE, IQ_MAX_RATE );
+		return NULL;
+	}
+
+	in = safe_mallocz ( sizeof(iqInT) );
+	in->fd = fd;
+	in->rate = rate;
+	in->centre = centre;
+
+	in->decim1 = rate / IQ_MID_RATE;
+	in->decim2 = rate / in->decim1 / IQ_OUT_RATE;
+
+	//windowed sinc (hamming), at the boxcar sums' rate - unity gain
+	fc = IQ_CUTOFF * in->decim1 / rate;
+	sum = 0;
+	for ( i=0; i<IQ_TAPS; i++ )
+	{
+		x = i - (IQ_TAPS-1) / 2.0;
+		in->taps[i] = ( x == 0 ? 2 * fc : sin ( 2 * M_PI * fc * x ) / (M_PI * x) )
+			* (0.54 - 0.46 * cos ( 2 * M_PI * i / (IQ_TAPS-1) ));
+		sum += in->taps[i];
+	}
+	for ( i=0; i<IQ_TAPS; i++ )
+		in->taps[i] /= sum;
+
+	return in;
+}
+
+int
+iqUseCarrier ( iqInT* in, int freq )
+{
+	iqChannelT*	ch;
+	double		offset;
+	int		k;
+
+	offset = freq - in->centre;
+
+	//(the band edges are no good - they're aliased, or filtered by the sdr)
+	if ( fabs ( offset ) > in->rate * 0.45 || in->numchannels >= IQ_MAX_CHANNELS )
+		return -1;
+
+	ch = &in->channels[in->numchannels++];
+	memset ( ch, 0, sizeof(iqChannelT) );
+	ch->freq = freq;
+
+	for ( k=0; k<IQ_BLOCK; k++ )
+	{
+		ch->rotre[k] = cos ( -2 * M_PI * offset * k / in->rate );
+		ch->rotim[k] = sin ( -2 * M_PI * offset * k / in->rate );
+	}
+
+	audioDetInit ( &ch->det, lround ( (double)in->rate / (in->decim1 * in->decim2) ) );
+
+	return 0;
+}
+
+int
+iqUsePM ( iqInT* in, int freq )
+{
+	int	c;
+
+	for ( c=0; c<in->numchannels; c++ )
+	{
+		if ( in->channels[c].freq == freq && in->channels[c].pm == NULL )
+		{
+			in->channels[c].pm = pmCreate ( (double)in->rate / in->decim1 );
+			return in->channels[c].pm != NULL ? 0 : -1;
+		}
+	}
+
+	return -1;
+}
+
+//u8 samples to floats around 0 - this and iqMix() are the only loops over every input sample,
+//so they're written for the compiler to vectorise: no branches, no aliasing (restrict), and a
+//main loop over a multiple of 8 samples (-O2 won't vectorise a loop that needs a scalar tail)
+static void
+iqConvert ( const unsigned char* restrict data, float* restrict xi, float* restrict xq, int n )
+{
+	int	k, m;
+
+	m = n & ~7;
+	for ( k=0; k<m; k++ )
+	{
+		xi[k] = data[2*k] - 127.5f;
+		xq[k] = data[2*k+1] - 127.5f;
+	}
+	for ( ; k<n; k++ )
+	{
+		xi[k] = data[2*k] - 127.5f;
+		xq[k] = data[2*k+1] - 127.5f;
+	}
+}
+
+//x times the mixer table
+static void
+iqMix ( const float* restrict xi, const float* restrict xq, const float* restrict rotre,
+	const float* restrict rotim, float* restrict mre, float* restrict mim, int n )
+{
+	int	k, m;
+
+	m = n & ~7;
+	for ( k=0; k<m; k++ )
+	{
+		mre[k] = xi[k] * rotre[k] - xq[k] * rotim[k];
+		mim[k] = xi[k] * rotim[k] + xq[k] * rotre[k];
+	}
+	for ( ; k<n; k++ )
+	{
+		mre[k] = xi[k] * rotre[k] - xq[k] * rotim[k];
+		mim[k] = xi[k] * rotim[k] + xq[k] * rotre[k];
+	}
+}
+
+//mix one carrier down, decimate, and take the magnitude - returns the number of output samples
+static int
+iqChannel ( iqInT* in, iqChannelT* ch, int n )
+{
+	float	sre, sim, phre, phim, re, im;
+	int	g, j, i, nout, npm, found;
+
+	iqMix ( in->xi, in->xq, ch->rotre, ch->rotim, in->mre, in->mim, n );
+
+	//the mixer table starts at phase 0 - the block's actual starting phase is applied to
+	//the sums (the blocks are whole boxcar sums)
+	phre = cos ( -2 * M_PI * ch->cycles );
+	phim = sin ( -2 * M_PI * ch->cycles );
+	ch->cycles = fmod ( ch->cycles + (double)(ch->freq - in->centre) * n / in->rate, 1.0 );
+
+	nout = 0;
+	npm = 0;
+
+	for ( g=0; g<n; g+=in->decim1 )
+	{
+		sre = 0;
+		sim = 0;
+		for ( j=0; j<in->decim1; j++ )
+		{
+			sre += in->mre[g+j];
+			sim += in->mim[g+j];
+		}
+
+		re = sre * phre - sim * phim;
+		im = sre * phim + sim * phre;
+
+		//(start with the history full of the first sum - a ramp up from 0 would look like a
+		//carrier reduction to the detector's level trackers while they warm up)
+		if ( !ch->started )
+		{
+			for ( j=0; j<2*IQ_TAPS; j++ )
+			{
+				ch->histre[j] = re;
+				ch->histim[j] = im;
+			}
+			ch->started = 1;
+		}
+
+		ch->histre[ch->histpos] = ch->histre[ch->histpos + IQ_TAPS] = re;
+		ch->histim[ch->histpos] = ch->histim[ch->histpos + IQ_TAPS] = im;
+		if ( ++ch->histpos == IQ_TAPS )
+			ch->histpos = 0;
+
+		if ( ch->pm != NULL )
+		{
+			ch->pmre[npm] = re;
+			ch->pmim[npm++] = im;
+		}
+
+		if ( ++ch->midcount < in->decim2 )
+			continue;
+		ch->midcount = 0;
+
+		re = 0;
+		im = 0;
+		for ( j=0; j<IQ_TAPS; j++ )
+		{
+			re += in->taps[j] * ch->histre[ch->histpos + j];
+			im += in->taps[j] * ch->histim[ch->histpos + j];
+		}
+
+		re = sqrt ( re * re + im * im ) / in->decim1 * IQ_SCALE;
+		ch->out[nout++] = re > 32767 ? 32767 : (short)re;
+	}
+
+	if ( ch->pm != NULL )
+	{
+		found = pmProcess ( ch->pm, ch->pmre, ch->pmim, npm, in->pm + in->numpm, IQ_MAX_PM - in->numpm );
+
+		//(a boxcar sum stands for the input samples it took in - each the interval around it)
+		for ( i=in->numpm; i<in->numpm+found; i++ )
+		{
+			in->pm[i].pos = in->pm[i].pos * in->decim1 - 0.5;
+			in->pm[i].channel = ch->freq;
+		}
+		in->numpm += found;
+	}
+
+	return nout;
+}
+
+int
+iqProcess ( iqInT* in, const unsigned char* data, int n, audioEdgeT* edges, int max )
+{
+	iqChannelT*	ch;
+	audioEdgeT	edge;
+	double		scale, offset;
+	int		c, i, j, nout, count, found;
+
+	iqConvert ( data, in->xi, in->xq, n );
+	in->numpm = 0;
+
+	//an output sample stands for the middle of the fir, which stands for the middle of a boxcar
+	scale = (double)in->decim1 * in->decim2;
+	offset = in->decim1 * (in->decim2 - 1 - (IQ_TAPS-1) / 2.0) + (in->decim1 - 1) / 2.0;
+
+	count = 0;
+	for ( c=0; c<in->numchannels; c++ )
+	{
+		ch = &in->channels[c];
+
+		nout = iqChannel ( in, ch, n );
+		found = audioDetect ( &ch->det, ch->out, nout, edges + count, max - count );
+
+		for ( i=count; i<count+found; i++ )
+		{
+			edges[i].pos = edges[i].pos * scale + offset;
+			edges[i].channel = ch->freq;
+		}
+		count += found;
+	}
+
+	//(each carrier's edges are in order - merge them)
+	for ( i=1; i<count; i++ )
+	{
+		edge = edges[i];
+		for ( j=i; j>0 && edges[j-1].pos > edge.pos; j-- )
+			edges[j] = edges[j-1];
+		edges[j] = edge;
+	}
+
+	in->frames += n;
+
+	return count;
+}
+
+int
+iqRead ( iqInT* in, audioEdgeT* edges, int max )
+{
+	int	want, frames, n;
+
+	//whole boxcar sums only - what's left over waits for the next read
+	want = IQ_BLOCK / in->decim1 * in->decim1 * 2;
+
+	while ( in->buflen < in->decim1 * 2 )
+	{
+		in->reads++;
+		n = read ( in->fd, in->buf + in->buflen, want - in->buflen );
+		if ( n < 0 && errno == EINTR )
+			continue;
+		if ( n <= 0 )
+			return -1;
+
+		in->buflen += n;
+	}
+
+	frames = in->buflen / 2 / in->decim1 * in->decim1;
+
+	n = iqProcess ( in, in->buf, frames, edges, max );
+
+	in->buflen -= frames * 2;
+	memmove ( in->buf, in->buf + frames * 2, in->buflen );
+
+	return n;
+}
+
+void
+iqClose ( iqInT* in )
+{
+	int	c;
+
+	for ( c=0; c<in->numchannels; c++ )
+	{
+		if ( in->channels[c].pm != NULL )
+			pmFree ( in->channels[c].pm );
+	}
+
+	close ( in->fd );
+	safe_free ( in );
+}
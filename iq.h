@@ -0,0 +1,87 @@
+#ifndef IQ_H_
+#define IQ_H_
+
+#include "timef.h"
+#include "audio.h"
+#include "pm.h"
+
+//raw iq front end: 8 bit unsigned interleaved i/q (as written by rtl_sdr), from a file or a
+//fifo, sampled at 250k to 3.2M samples a second around a centre frequency. each carrier
+//wanted is mixed down to 0Hz, decimated in two steps (a boxcar sum to about IQ_MID_RATE, then
+//a low pass fir to about IQ_OUT_RATE), and its magnitude goes through the audio envelope
+//detector - so the carrier's amplitude keying comes out as edges. all the buffers are fixed size
+
+#define	IQ_MAX_CHANNELS		(4)
+#define	IQ_BLOCK		(8192)		//frames read at a time (at most)
+#define	IQ_MID_RATE		(64000)
+#define	IQ_OUT_RATE		(8000)
+#define	IQ_TAPS			(49)
+#define	IQ_MAX_PM		(8)		//phase modulation seconds found per read
+
+#define	IQ_MIN_RATE		(200000)
+#define	IQ_MAX_RATE		(3200000)
+
+typedef struct
+{
+	int	freq;			//carrier (Hz)
+	double	cycles;			//mixer phase at the start of the block (in cycles)
+	float	rotre[IQ_BLOCK];	//mixer, from the start of a block
+	float	rotim[IQ_BLOCK];
+
+	float	histre[2*IQ_TAPS];	//fir history (twice over, so it can be read without wrapping)
+	float	histim[2*IQ_TAPS];
+	int	histpos;
+	int	midcount;		//boxcar sums since the last output
+	int	started;
+
+	short	out[IQ_BLOCK];		//magnitudes, at the output rate
+	audioDetT	det;
+
+	//DCF77 phase modulation correlator, if wanted - fed the boxcar sums
+	pmT*	pm;
+	float	pmre[IQ_BLOCK];
+	float	pmim[IQ_BLOCK];
+} iqChannelT;
+
+typedef struct
+{
+	int		fd;
+	int		rate;
+	int		centre;
+	int		decim1;		//input samples per boxcar sum
+	int		decim2;		//boxcar sums per output sample
+	float		taps[IQ_TAPS];
+	unsigned long	reads;
+	unsigned long long	frames;
+
+	unsigned char	buf[IQ_BLOCK*2];
+	int		buflen;
+	float		xi[IQ_BLOCK];
+	float		xq[IQ_BLOCK];
+	float		mre[IQ_BLOCK];
+	float		mim[IQ_BLOCK];
+
+	int		numchannels;
+	iqChannelT	channels[IQ_MAX_CHANNELS];
+
+	pmSecondT	pm[IQ_MAX_PM];	//phase modulation seconds found by the last read
+	int		numpm;
+} iqInT;
+
+
+//start reading iq samples from fd - rate and centre frequency in Hz
+iqInT* iqOpen ( int fd, int rate, int centre );
+//add a carrier to look for - returns -1 if it's outside what's sampled, or there are too many
+int iqUseCarrier ( iqInT* in, int freq );
+//correlate a carrier's phase modulation too (DCF77 only - see pm.h) - each read leaves the
+//seconds found in pm[] (pm[].pos in input samples, pm[].channel the carrier)
+int iqUsePM ( iqInT* in, int freq );
+//read the next block - returns the number of edges found (in time order, edges[].channel is the
+//carrier's frequency, edges[].pos in input samples), or -1 at the end of the input
+int iqRead ( iqInT* in, audioEdgeT* edges, int max );
+//run n frames (2n bytes) through the chain without reading - for the benchmark
+int iqProcess ( iqInT* in, const unsigned char* data, int n, audioEdgeT* edges, int max );
+void iqClose ( iqInT* in );
+
+
+#endif
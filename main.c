@@ -28,7 +28,10 @@
 #include <unistd.h>
 #include <string.h>
 #include <sys/types.h>
+#include <sys/resource.h>
 #include <signal.h>
+#include <poll.h>
+#include <math.h>
 
 #ifdef ENABLE_SCHED
 #include <sched.h>
@@ -42,6 +45,7 @@
 #include "logger.h"
 #include "clock.h"
 #include "serial.h"
+#include "capture.h"
 #include "memory.h"
 
 
@@ -63,9 +67,18 @@ typedef struct
 #define	MAX_CLOCKS		(16)
 serClockT	clocklist[MAX_CLOCKS];
 
+//how often to log the wakeup/cpu statistics (seconds)
+#define	STATS_INTERVAL		(60*60)
 
+//seconds without a line change before a device is reported as quiet
+#define	WATCHDOG_INTERVAL	(10)
 
-void StartClocks ( serDevT* serdev );
+//how often the edge capture (-c) is written out, if it hasn't filled a block (seconds)
+#define	CAPTURE_INTERVAL	(10)
+
+
+
+void RunClocks ( void );
 
 
 
@@ -126,13 +139,27 @@ void
 usage (void)
 {
 	printf (
-"Usage: radioclkd2 [ -s poll|iwait|timepps ] [ -t dcf77|msf|wwvb ] [ -n <shm start unit> ] [ -d ] [ -v ] tty[:[-]line[:fudgeoffs]] ...\n"
-"   -s poll: poll the serial port 1000 times/sec (poor)\n"
+"Usage: radioclkd2 [ -s poll|iwait|timepps|gpio|gpiochip|stream|audio|wav|iq:<rate>:<centre>|replay:<file> ] [ -t dcf77|msf|wwvb ] [ -n <shm start unit> ] [ -m <minutes> ] [ -a <seconds> ] [ -c <capture file> ] [ -d ] [ -v ] tty[:[-]line[:fudgeoffs]] ...\n"
+"   -s poll: poll the serial port, densely around the expected edges (poor)\n"
 "   -s iwait: wait for serial port interrupts (ok)\n"
 "   -s timepps: use the timepps interface (good)\n"
 "   -s gpio: use /sys/class/gpio/gpioX/value for tty\n"
 "         setup \"edges\" to \"both\", uses poll() for GPIO pin interrupts\n"
 "         GPIO pulses are simulating DCD, so use :DCD and :-DCD for polarity\n"
+"   -s gpiochip: use the GPIO character device, tty is gpiochipN:[-]offset\n"
+"         edges are timestamped by the kernel, several lines share one chip\n"
+"   -s stream: read timestamped edges from another program - tty is a fifo, or a\n"
+"         unix socket to connect to, sending records in capture file format\n"
+"   -s audio: detect edges in a receiver's audio output - tty is a wav fifo or pipe\n"
+"         (eg. from arecord -t wav -f S16_LE -r 48000), line is the channel (default 0)\n"
+"   -s wav: the same from a wav file, as fast as possible\n"
+"   -s iq:<rate>:<centre>: detect the carrier's keying in raw 8 bit iq samples from an sdr -\n"
+"         tty is a fifo (eg. from rtl_sdr -s <rate> -f <centre> -), line is the carrier\n"
+"         in Hz (default the centre) - several carriers can share the samples\n"
+"   -s iqfile:<rate>:<centre>: the same from a file, as fast as possible\n"
+"   -s replay:<file>: replay the edges of tty from a capture, as fast as possible\n"
+"   -s replayrt:<file>: the same, at the speed they were captured\n"
+"         (replays run in the foreground and don't update the shared memory)\n"
 #ifndef ENABLE_TIMEPPS
 "  (timepps not available)\n"
 #endif
@@ -142,10 +169,18 @@ usage (void)
 #ifndef ENABLE_GPIO
 "  (gpio not available)\n"
 #endif
+#ifndef ENABLE_GPIOCDEV
+"  (gpiochip not available)\n"
+#endif
 "   -t dcf77: 77.5KHz Germany/Europe DCF77 Radio Station (default)\n"
 "   -t msf: UK 60KHz MSF Radio Station\n"
 "   -t wwvb: US 60KHz WWVB Fort Collins Radio Station\n"
 "   -n shm#: NTP shared memory start unit - default is 0\n"
+"   -m minutes: when a minute won't decode, vote it with up to this many minutes\n"
+"         before it - default is 10, 0 to not vote\n"
+"   -a seconds: average the pc clock's offset over up to this many seconds of the\n"
+"         seconds' starts - default is 60 (8 to 3600)\n"
+"   -c file: capture every edge to file, for replaying later\n"
 "   -d: debug mode. runs in the foreground and print pulses\n"
 "   -v: verbose mode.\n"
 "   tty: serial port for clock\n"
@@ -163,10 +198,10 @@ main ( int argc, char** argv )
 	int	serialmode;
 	int	shmunit;
 	int	clocktype = CLOCKTYPE_DCF77;
+	int	replaying = 0;
+	int	iqcentre = 0;
 	char*	arg;
 	char*	parm;
-	serDevT*	devfirst;
-	serDevT*	devnext;
 
 
 	loggerSetFile ( stderr, LOGGER_DEBUG );
@@ -227,10 +262,74 @@ main ( int argc, char** argv )
 				else if ( strcasecmp ( parm, "gpio" ) == 0 )
 					serialmode = SERPORT_MODE_GPIO;
 #endif
+#ifdef ENABLE_GPIOCDEV
+				else if ( strcasecmp ( parm, "gpiochip" ) == 0 )
+					serialmode = SERPORT_MODE_GPIOCDEV;
+#endif
+				else if ( strcasecmp ( parm, "stream" ) == 0 )
+					serialmode = SERPORT_MODE_STREAM;
+				else if ( strcasecmp ( parm, "audio" ) == 0 )
+				{
+					serialmode = SERPORT_MODE_AUDIO;
+					serSetAudio ( 0 );
+				}
+				else if ( strcasecmp ( parm, "wav" ) == 0 )
+				{
+					serialmode = SERPORT_MODE_AUDIO;
+					serSetAudio ( 1 );
+
+					//(like a replay - not the real time)
+					if ( !debugLevel )
+						debugLevel = 1;
+					replaying = 1;
+				}
+				else if ( strncmp ( parm, "iq:", 3 ) == 0 || strncmp ( parm, "iqfile:", 7 ) == 0 )
+				{
+					int	rate;
+
+					serialmode = SERPORT_MODE_IQ;
+					if ( sscanf ( strchr ( parm, ':' ) + 1, "%d:%d", &rate, &iqcentre ) != 2 )
+						usage();
+					serSetIQ ( rate, iqcentre, parm[2] != ':' );
+
+					if ( parm[2] != ':' )
+					{
+						//(like a replay - not the real time)
+						if ( !debugLevel )
+							debugLevel = 1;
+						replaying = 1;
+					}
+				}
+				else if ( strncmp ( parm, "replay:", 7 ) == 0 || strncmp ( parm, "replayrt:", 9 ) == 0 )
+				{
+					serialmode = SERPORT_MODE_REPLAY;
+					serSetReplay ( strchr ( parm, ':' ) + 1, parm[6] != ':' );
+
+					//a replay is never the real time - stay in the foreground, and keep it out of ntpd
+					if ( !debugLevel )
+						debugLevel = 1;
+					replaying = 1;
+				}
 				else
 					usage();
 				break;
 
+			case 'c':
+				if ( strlen(arg) > 2 )
+				{
+					parm = arg + 2;
+				}
+				else
+				{
+					argc--;
+					argv++;
+					parm = argv[0];
+				}
+
+				if ( parm == NULL || capOpen ( parm ) < 0 )
+					usage();
+				break;
+
                         case 't':
                                 if ( strlen(arg) > 2 )
                                 {
@@ -282,6 +381,40 @@ main ( int argc, char** argv )
                                         usage();
                                 break;
 
+			case 'm':
+				if ( strlen(arg) > 2 )
+				{
+					parm = arg + 2;
+				}
+				else
+				{
+					argc--;
+					argv++;
+					parm = argv[0];
+				}
+
+				if ( parm == NULL || sscanf ( parm, "%d", &voteMinutes ) != 1
+				  || voteMinutes < 0 || voteMinutes >= VOTE_MAX_MINUTES )
+					usage();
+				break;
+
+			case 'a':
+				if ( strlen(arg) > 2 )
+				{
+					parm = arg + 2;
+				}
+				else
+				{
+					argc--;
+					argv++;
+					parm = argv[0];
+				}
+
+				if ( parm == NULL || sscanf ( parm, "%d", &averageSeconds ) != 1
+				  || averageSeconds < PPS_MIN_AVERAGE || averageSeconds > PPS_MAX_AVERAGE )
+					usage();
+				break;
+
 			default:
 				usage();
 				break;
@@ -301,7 +434,7 @@ main ( int argc, char** argv )
 
 			negate = 0;
 			fudgeoffset = 0.0;
-			line = TIOCM_CD;
+			line = ( serialmode == SERPORT_MODE_AUDIO ) ? 0 : ( serialmode == SERPORT_MODE_IQ ) ? iqcentre : TIOCM_CD;
 
 
 			dev = safe_xstrcpy ( arg, -1 );
@@ -329,7 +462,16 @@ main ( int argc, char** argv )
 					linestr++;
 				}
 
-				if ( strcasecmp ( linestr, "cd" ) == 0 || strcasecmp ( linestr, "dcd" ) == 0 )
+				if ( serialmode == SERPORT_MODE_GPIOCDEV
+				  || serialmode == SERPORT_MODE_AUDIO || serialmode == SERPORT_MODE_IQ
+				  || ((serialmode == SERPORT_MODE_REPLAY || serialmode == SERPORT_MODE_STREAM) && *linestr >= '0' && *linestr <= '9') )
+				{
+					//gpio chips: the line is the offset on the chip (audio: the channel, iq: the carrier)
+					line = strtol ( linestr, &parm, 10 );
+					if ( parm == linestr || *parm != 0 )
+						line = -1;
+				}
+				else if ( strcasecmp ( linestr, "cd" ) == 0 || strcasecmp ( linestr, "dcd" ) == 0 )
 					line = TIOCM_CD;
 				else if ( strcasecmp ( linestr, "cts" ) == 0 )
 					line = TIOCM_CTS;
@@ -344,7 +486,11 @@ main ( int argc, char** argv )
 				}
 
 			}
-	
+			else if ( serialmode == SERPORT_MODE_GPIOCDEV )
+			{
+				line = -1;
+			}
+
 
 			//right - we've got the serial port details - store them...
 
@@ -357,6 +503,11 @@ main ( int argc, char** argv )
 				loggerf ( LOGGER_NOTE, "Error: failed to create clock for serial line '%s'\n", arg );
 
 
+			//(DCF77's phase modulation times the seconds far more finely than the carrier
+			//reductions - but only the iq front end sees the carrier's phase)
+			if ( serline != NULL && serialmode == SERPORT_MODE_IQ && clocktype == CLOCKTYPE_DCF77 )
+				serline->pm = 1;
+
 			if ( clock != NULL && serline != NULL )
 			{
 				clocklist[shmunit].name = safe_xstrcpy ( arg, -1 );
@@ -409,95 +560,296 @@ main ( int argc, char** argv )
 	}
 
 //right - we're ready to start...
-//now, due to the fact that we can only watch one serial port at a time, we'll have
-//to fork off for all but the first serial port
+//all the serial devices are handled by one poll() loop in this process, devices
+//which can't be poll()ed get a waiter thread which feeds the loop through a pipe
 
-	devfirst = serGetDev ( NULL );
+	capStart ();
 
-	devnext = devfirst;
+	RunClocks ();
 
-	//we don't want to do this if we're debugging clocks...
-	if ( !debugLevel )
-	{
+	capClose ();
+
+	if ( replaying )
+		exit(0);
+
+	loggerf ( LOGGER_INFO, "main loop terminated\n" );
+	exit(1);
+
+
+	return 0;	//to stop warnings
+}
 
-		while ( (devnext = serGetDev(devnext)) != NULL )
-		{
-			int	pid;
 
-			pid = fork();
+void
+DispatchDevChange ( serDevT* serdev )
+{
+	serLineT*	serline;
+	int		c;
 
-			if ( pid < 0 )
+	serline = NULL;
+	while ( (serline = serGetLine(serline)) != NULL )
+	{
+		if ( serline->dev == serdev && serline->pmsecond )
+		{
+			for ( c = 0; c<MAX_CLOCKS; c++ )
 			{
-				loggerf ( LOGGER_INFO, "fork() failed for other devices\n" );
-				//as we have forked above, this will kill all processes in the current process group (ie, just us)
-				kill ( 0, SIGTERM );
+				if ( clocklist[c].serline == serline )
+					clkProcessPMSecond ( clocklist[c].clock, serline->pmbit, &serline->pmtime );
 			}
-			else if ( pid == 0 )
+
+			serline->pmsecond = 0;
+		}
+
+		if ( serline->dev != serdev || !serline->changed )
+			continue;
+
+		for ( c = 0; c<MAX_CLOCKS; c++ )
+		{
+			if ( clocklist[c].serline == serline )
 			{
-				//child
-				StartClocks ( devnext );
+				if ( serline->lostedges )
+					clkLostEdges ( clocklist[c].clock, serline->lostedges, serline->curstate, &serdev->eventtime );
+				else
+					clkProcessStatusChange ( clocklist[c].clock, serline->curstate, &serline->eventtime );
 
-				loggerf ( LOGGER_INFO, "child process terminated\n" );
-				exit(0);
 			}
-			//else parent - continue on
 		}
+
+		serline->changed = 0;
 	}
-	else
+}
+
+void
+LogStats ( serDevT** devlist, int numdevs, time_t elapsed )
+{
+	struct rusage	usage;
+	time_f		user, sys;
+	int		i;
+
+	if ( elapsed <= 0 )
+		return;
+
+	for ( i=0; i<numdevs; i++ )
 	{
-		if ( serGetDev(devnext) != NULL )
-			loggerf ( LOGGER_INFO, "Additional serial lines ignored in debug mode\n" );
+		loggerf ( LOGGER_INFO, "stats: %s: %lu wakeups (%.1f/s), %lu line changes, %lu edges lost\n",
+			devlist[i]->dev, devlist[i]->wakeups, (double)devlist[i]->wakeups / elapsed, devlist[i]->changes, devlist[i]->lostedges );
+
+		//syscalls per change don't include the main loop's poll() - one per wakeup
+		if ( devlist[i]->changes > 0 && !devlist[i]->offline )
+			loggerf ( LOGGER_INFO, "stats: %s: %.1f syscalls per change, latency "TIMEF_FORMAT"s avg "TIMEF_FORMAT"s max\n",
+				devlist[i]->dev, (double)devlist[i]->syscalls / devlist[i]->changes,
+				devlist[i]->latencysum / devlist[i]->changes, devlist[i]->latencymax );
+
+		devlist[i]->wakeups = 0;
+		devlist[i]->changes = 0;
+		devlist[i]->lostedges = 0;
+		devlist[i]->syscalls = 0;
+		devlist[i]->latencysum = 0;
+		devlist[i]->latencymax = 0;
 	}
 
-	StartClocks ( devfirst );
+	for ( i=0; i<MAX_CLOCKS; i++ )
+	{
+		if ( clocklist[i].clock == NULL )
+			continue;
 
-	loggerf ( LOGGER_INFO, "parent process terminated\n" );
-	exit(1);
+		if ( clocklist[i].clock->pulses.locked )
+			loggerf ( LOGGER_INFO, "stats: %s: pulses %+.0fms from nominal, confidence %.2f\n",
+				clocklist[i].name, clocklist[i].clock->pulses.skew * 1000, clocklist[i].clock->pulses.confidence );
+		else
+			loggerf ( LOGGER_INFO, "stats: %s: nominal pulse widths, confidence %.2f\n",
+				clocklist[i].name, clocklist[i].clock->pulses.confidence );
 
+		if ( flywheelSettled ( &clocklist[i].clock->flywheel ) )
+			loggerf ( LOGGER_INFO, "stats: %s: seconds %+.1fppm on the pc's clock, jitter "TIMEF_FORMAT"s rms, %lu times sent since start (%lu from the flywheel)\n",
+				clocklist[i].name, (clocklist[i].clock->flywheel.period - 1.0) * 1e6,
+				clocklist[i].clock->flywheel.rms, clocklist[i].clock->sent, clocklist[i].clock->holdovers );
+		else
+			loggerf ( LOGGER_INFO, "stats: %s: seconds not tracked, %lu times sent since start (%lu from the flywheel)\n",
+				clocklist[i].name, clocklist[i].clock->sent, clocklist[i].clock->holdovers );
 
-	return 0;	//to stop warnings
-}
+		if ( clocklist[i].clock->ppssamples > 0 )
+			loggerf ( LOGGER_INFO, "stats: %s: %lu pps samples, left out %lu too far from the radio time, %lu with wide timestamp errors, %lu outliers - %lu times sent without an average\n",
+				clocklist[i].name, clocklist[i].clock->ppssamples, clocklist[i].clock->ppstoofar,
+				clocklist[i].clock->ppswide, clocklist[i].clock->ppsoutliers, clocklist[i].clock->sentraw );
 
+		if ( clocklist[i].clock->freqcount > 0 )
+			loggerf ( LOGGER_INFO, "stats: %s: pc clock %+.2fppm against the radio time (+-%.2fppm)\n",
+				clocklist[i].name, clocklist[i].clock->frequency * 1e6, sqrt ( clocklist[i].clock->freqvar ) * 1e6 );
+	}
+
+	//(cumulative for the process - including the waiter threads)
+	if ( getrusage ( RUSAGE_SELF, &usage ) == 0 )
+	{
+		timeval2time_f ( &usage.ru_utime, user );
+		timeval2time_f ( &usage.ru_stime, sys );
+		loggerf ( LOGGER_INFO, "stats: cpu "TIMEF_FORMAT"s user, "TIMEF_FORMAT"s sys since start\n", user, sys );
+	}
+}
 
 void
-StartClocks ( serDevT* serdev )
+RunClocks ( void )
 {
-	serLineT*	serline;
-	int		c;
+	serDevT*	serdev;
+	serDevT**	devlist;
+	struct pollfd*	pollfds;
+	int		numdevs;
+	int		i, c, ret, timeout, active;
+	time_t		laststats, lastcapture, now;
+	timeStampT	tsnow;
+
 
+	numdevs = 0;
+	for ( serdev = serGetDev(NULL); serdev != NULL; serdev = serGetDev(serdev) )
+		numdevs++;
 
-	loggerf ( LOGGER_INFO, "pid %d for device %s\n", getpid(), serdev->dev );
+	if ( numdevs == 0 )
+		return;
+
+	devlist = safe_mallocz ( numdevs * sizeof(serDevT*) );
+	pollfds = safe_mallocz ( numdevs * sizeof(struct pollfd) );
 
-	if ( serInitHardware ( serdev ) < 0 )
+	numdevs = 0;
+	for ( serdev = serGetDev(NULL); serdev != NULL; serdev = serGetDev(serdev) )
 	{
-		loggerf ( LOGGER_INFO, "error initialising serial device\n" );
+		if ( serInitHardware ( serdev ) < 0 )
+		{
+			loggerf ( LOGGER_INFO, "error initialising serial device %s\n", serdev->dev );
+			continue;
+		}
+		devlist[numdevs++] = serdev;
+	}
+
+	if ( numdevs == 0 )
 		return;
+
+	//wait for the devices to power up... (there's nothing to power up for a replay or stream)
+	for ( i=0; i<numdevs; i++ )
+	{
+		if ( devlist[i]->mode != SERPORT_MODE_REPLAY && devlist[i]->mode != SERPORT_MODE_STREAM
+		  && devlist[i]->mode != SERPORT_MODE_AUDIO && devlist[i]->mode != SERPORT_MODE_IQ )
+		{
+			sleep(3);
+			break;
+		}
 	}
 
-	while(1)
+	for ( i=0; i<numdevs; i++ )
 	{
-		if ( serWaitForSerialChange ( serdev ) < 0 )
+		if ( serStartDev ( devlist[i] ) < 0 )
 		{
-			loggerf ( LOGGER_DEBUG, "no serial line change\n" );
+			loggerf ( LOGGER_INFO, "error starting serial device %s\n", devlist[i]->dev );
+			devlist[i--] = devlist[--numdevs];
 			continue;
 		}
 
-		serUpdateLinesForDevice ( serdev );
+		loggerf ( LOGGER_INFO, "pid %d handling device %s\n", getpid(), devlist[i]->dev );
+	}
+
+	for ( i=0; i<numdevs; i++ )
+	{
+		//poll() ignores entries with a negative fd - those devices get sampled on every pass
+		serGetPollFd ( devlist[i], &pollfds[i] );
+	}
+
+	if ( numdevs == 0 )
+		return;
+
+	laststats = time(NULL);
+	lastcapture = laststats;
+	active = numdevs;
+
+	while ( active > 0 )
+	{
+		//poll mode devices without a timer fd tell us when they next want sampling
+		timeout = 10*1000;
+		for ( i=0; i<numdevs; i++ )
+		{
+			if ( pollfds[i].fd < 0 && !devlist[i]->ended && (ret = serPollTimeout ( devlist[i] )) < timeout )
+				timeout = ret;
+		}
+
+		//and clocks whose line has gone quiet, when their next second's due from the flywheel
+		timeGetStamp ( &tsnow );
+		for ( c=0; c<MAX_CLOCKS; c++ )
+		{
+			if ( clocklist[c].clock != NULL && !clocklist[c].serline->dev->offline
+			  && (ret = clkHoldoverTimeout ( clocklist[c].clock, &tsnow )) >= 0 && ret < timeout )
+				timeout = ret;
+		}
+
+		ret = poll ( pollfds, numdevs, timeout );
+
+		if ( ret < 0 )
+			continue;	//EINTR
 
-		serline = NULL;
-		while ( (serline = serGetLine(serline)) != NULL )
+		for ( i=0; i<numdevs; i++ )
 		{
-			for ( c = 0; c<MAX_CLOCKS; c++ )
+			if ( devlist[i]->ended )
+				continue;
+			if ( pollfds[i].fd >= 0 && !pollfds[i].revents )
+				continue;
+			if ( pollfds[i].fd < 0 && serPollTimeout ( devlist[i] ) > 0 )
+				continue;
+
+			devlist[i]->wakeups++;
+
+			//(gpio chips and streams can deliver a batch of edges in one read)
+			do
 			{
-				if ( (serline->dev == serdev)
-				  && (clocklist[c].serline == serline) )
-				{
-					clkProcessStatusChange ( clocklist[c].clock, serline->curstate, serline->eventtime );
+				if ( serReadDevChange ( devlist[i] ) > 0 )
+					DispatchDevChange ( devlist[i] );
+			} while ( serDevPending ( devlist[i] ) );
 
-				}
+			//(streams reconnect with a new fd)
+			if ( devlist[i]->mode == SERPORT_MODE_STREAM )
+				serGetPollFd ( devlist[i], &pollfds[i] );
+
+			//(only replays, audio and iq inputs come to an end)
+			if ( devlist[i]->ended )
+			{
+				pollfds[i].fd = -1;
+				active--;
+			}
+		}
+
+		//(a replay's clocks are only as far on as its edges - they get theirs from those)
+		timeGetStamp ( &tsnow );
+		for ( c=0; c<MAX_CLOCKS; c++ )
+		{
+			if ( clocklist[c].clock != NULL && !clocklist[c].serline->dev->offline )
+				clkHoldover ( clocklist[c].clock, &tsnow );
+		}
+
+		now = time(NULL);
+
+		//(the waiter threads block without a timeout, so quiet devices are noticed here)
+		for ( i=0; i<numdevs; i++ )
+		{
+			if ( devlist[i]->ended )
+				continue;
+			if ( now - devlist[i]->lastchange >= WATCHDOG_INTERVAL || now < devlist[i]->lastchange )
+			{
+				loggerf ( LOGGER_DEBUG, "%s: no serial line change\n", devlist[i]->dev );
+				devlist[i]->lastchange = now;
 			}
 		}
 
+		if ( now - laststats >= STATS_INTERVAL || now < laststats )
+		{
+			LogStats ( devlist, numdevs, now - laststats );
+			laststats = now;
+		}
+
+		if ( now - lastcapture >= CAPTURE_INTERVAL || now < lastcapture )
+		{
+			capFlush ();
+			lastcapture = now;
+		}
 	}
 
+	//(at least a second, so a fast replay still gets its stats)
+	now = time(NULL);
+	LogStats ( devlist, numdevs, now > laststats ? now - laststats : 1 );
+
 }
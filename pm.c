@@ -0,0 +1,267 @@
+/*
+ * Copyright (c) 2002 Jon Atkins http://www.jonatkins.com/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+
+#include "pm.h"
+#include "logger.h"
+#include "memory.h"
+
+
+#define	PM_SMOOTH	(0.025)		//carrier phase averaged this long either side (seconds)
+#define	PM_MIN_RATE	(4000)
+
+
+void
+pmSequence ( signed char* chips )
+{
+	unsigned int	reg;
+	int		i, b;
+
+	//9 bit feedback shift register (x^9 + x^5 + 1) started at all ones - 511 chips, and a
+	//0 chip to make 512, with as many of each
+	reg = 0x1ff;
+	for ( i=0; i<PM_CHIPS-1; i++ )
+	{
+		b = reg & 1;
+		chips[i] = b ? -1 : 1;
+
+		reg = (reg >> 1) | ((b ^ ((reg >> 4) & 1)) << 8);
+	}
+	chips[PM_CHIPS-1] = 1;
+}
+
+pmT*
+pmCreate ( double rate )
+{
+	signed char	chips[PM_CHIPS];
+	pmT*		pm;
+	int		i, w;
+
+	if ( rate < PM_MIN_RATE || rate > PM_MAX_RATE )
+	{
+		loggerf ( LOGGER_NOTE, "Error: phase modulation needs %d to %d samples/s, not %.0f\n", PM_MIN_RATE, PM_MAX_RATE, rate );
+		return NULL;
+	}
+
+	pm = safe_mallocz ( sizeof(pmT) );
+	pm->rate = rate;
+	pm->chip = rate * PM_CHIP_CYCLES / PM_CARRIER;
+	pm->window = (int)rate;
+
+	//(the sequence changes at about half the chip boundaries)
+	pmSequence ( chips );
+	for ( i=0; i<=PM_CHIPS; i++ )
+	{
+		w = ( i > 0 ? chips[i-1] : 0 ) - ( i < PM_CHIPS ? chips[i] : 0 );
+		if ( w != 0 )
+		{
+			pm->bound[pm->numbounds] = i;
+			pm->weight[pm->numbounds++] = w;
+		}
+	}
+
+	//(a chip's margin either side of the window searched, and the sequence after its end - and
+	//the carrier's average either side of that)
+	pm->smooth = (int)(PM_SMOOTH * rate);
+	pm->size = pm->window + (int)ceil ( (PM_CHIPS + 2) * pm->chip ) + 2 * pm->smooth + 2;
+	pm->re = safe_mallocz ( pm->size * sizeof(float) );
+	pm->im = safe_mallocz ( pm->size * sizeof(float) );
+	pm->y = safe_mallocz ( pm->size * sizeof(float) );
+	pm->sumre = safe_mallocz ( (pm->size + 1) * sizeof(double) );
+	pm->sumim = safe_mallocz ( (pm->size + 1) * sizeof(double) );
+	pm->sum = safe_mallocz ( (pm->size + 1) * sizeof(double) );
+	pm->sumsq = safe_mallocz ( (pm->size + 1) * sizeof(double) );
+
+	return pm;
+}
+
+//a running sum at a fractional sample - each sample stands for the interval up to the next
+static double
+pmSum ( const double* sum, double x )
+{
+	int	i;
+
+	i = (int)x;
+	return sum[i] + (x - i) * (sum[i+1] - sum[i]);
+}
+
+//correlation with the sequence starting at sample t
+static double
+pmCorrelate ( pmT* pm, double t )
+{
+	double	c;
+	int	i;
+
+	c = 0;
+	for ( i=0; i<pm->numbounds; i++ )
+		c += pm->weight[i] * pmSum ( pm->sum, t + pm->bound[i] * pm->chip );
+
+	return c;
+}
+
+//look for a sequence starting in the window (a chip into the buffer) - then move the buffer on
+//by the window. returns 1 with sec filled in if one was found
+static int
+pmSearch ( pmT* pm, pmSecondT* sec )
+{
+	double	c, best, t, early, late, span, energy, are, aim, amp;
+	int	i, step, start, end, found, k, lo, hi;
+
+	pm->sumre[0] = 0;
+	pm->sumim[0] = 0;
+	for ( i=0; i<pm->len; i++ )
+	{
+		pm->sumre[i+1] = pm->sumre[i] + pm->re[i];
+		pm->sumim[i+1] = pm->sumim[i] + pm->im[i];
+	}
+
+	//the phase from the carrier's average around each sample - as the carrier's amplitude
+	pm->sum[0] = 0;
+	pm->sumsq[0] = 0;
+	for ( i=0; i<pm->len; i++ )
+	{
+		lo = i < pm->smooth ? 0 : i - pm->smooth;
+		hi = i + pm->smooth + 1 > pm->len ? pm->len : i + pm->smooth + 1;
+		are = pm->sumre[hi] - pm->sumre[lo];
+		aim = pm->sumim[hi] - pm->sumim[lo];
+		amp = sqrt ( are * are + aim * aim );
+
+		pm->y[i] = amp > 0 ? (pm->im[i] * are - pm->re[i] * aim) / amp : 0;
+
+		pm->sum[i+1] = pm->sum[i] + pm->y[i];
+		pm->sumsq[i+1] = pm->sumsq[i] + (double)pm->y[i] * pm->y[i];
+	}
+
+	start = (int)ceil ( pm->chip ) + pm->smooth;
+	end = start + pm->window;
+	span = PM_CHIPS * pm->chip;
+
+	//every quarter chip (the correlation peak is two chips wide), then every sample around the best
+	step = (int)(pm->chip / 4);
+	if ( step < 1 )
+		step = 1;
+
+	best = 0;
+	t = start;
+	for ( i=start; i<end; i+=step )
+	{
+		c = fabs ( pmCorrelate ( pm, i ) );
+		if ( c > best )
+		{
+			best = c;
+			t = i;
+		}
+	}
+	for ( i=(int)t-step+1; i<(int)t+step; i++ )
+	{
+		if ( i < start || i >= end )
+			continue;
+		c = fabs ( pmCorrelate ( pm, i ) );
+		if ( c > best )
+		{
+			best = c;
+			t = i;
+		}
+	}
+
+	//between the samples: half a chip either side of the peak the correlation falls in straight
+	//lines (away from the rounded top), so the difference between them says how far off it is
+	c = pmCorrelate ( pm, t );
+	for ( k=0; k<2; k++ )
+	{
+		early = pmCorrelate ( pm, t - pm->chip / 2 );
+		late = pmCorrelate ( pm, t + pm->chip / 2 );
+		if ( c < 0 )
+		{
+			early = -early;
+			late = -late;
+		}
+		if ( early + late <= 0 )
+			break;
+
+		t += (late - early) / (late + early) * pm->chip / 2;
+		if ( t < start - pm->chip / 2 || t > end + pm->chip / 2 )
+			break;
+		c = pmCorrelate ( pm, t );
+	}
+
+	found = 0;
+	energy = pmSum ( pm->sumsq, t + span ) - pmSum ( pm->sumsq, t );
+
+	//(a start just outside the window is found as the neighbouring window's own)
+	if ( t >= start && t < end && energy > 0 )
+	{
+		//(the samples' noise is independent, near enough - the boxcar sums don't overlap)
+		sec->quality = fabs ( c ) / sqrt ( energy * span );
+		if ( sec->quality * sqrt ( span ) >= PM_MIN_SNR )
+		{
+			sec->pos = pm->base + t - PM_START * pm->rate;
+			sec->bit = ( c < 0 );
+			found = 1;
+		}
+	}
+
+	pm->len -= pm->window;
+	memmove ( pm->re, pm->re + pm->window, pm->len * sizeof(float) );
+	memmove ( pm->im, pm->im + pm->window, pm->len * sizeof(float) );
+	pm->base += pm->window;
+
+	return found;
+}
+
+int
+pmProcess ( pmT* pm, const float* re, const float* im, int n, pmSecondT* secs, int max )
+{
+	pmSecondT	sec;
+	int		i, count;
+
+	count = 0;
+
+	for ( i=0; i<n; i++ )
+	{
+		pm->re[pm->len] = re[i];
+		pm->im[pm->len++] = im[i];
+
+		if ( pm->len == pm->size && pmSearch ( pm, &sec ) && count < max )
+			secs[count++] = sec;
+	}
+
+	return count;
+}
+
+void
+pmFree ( pmT* pm )
+{
+	safe_free ( pm->re );
+	safe_free ( pm->im );
+	safe_free ( pm->y );
+	safe_free ( pm->sumre );
+	safe_free ( pm->sumim );
+	safe_free ( pm->sum );
+	safe_free ( pm->sumsq );
+	safe_free ( pm );
+}
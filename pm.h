@@ -0,0 +1,64 @@
+#ifndef PM_H_
+#define PM_H_
+
+//DCF77 phase modulation: from 200ms into each second (after the carrier reduction) the
+//carrier's phase is keyed +-15.6 degrees by a 512 chip pseudo random sequence, each chip 120
+//carrier cycles (793ms in all) - sent inverted for a 1 bit. correlating the phase against the
+//sequence times the start of the second far more finely than the carrier reductions' edges,
+//and gives a second copy of the bits. the input is the carrier mixed down to about 0Hz
+//(complex samples - see iq.c)
+
+#define	PM_CHIPS		(512)
+#define	PM_CHIP_CYCLES		(120)
+#define	PM_CARRIER		(77500)
+#define	PM_START		(0.2)		//the sequence starts this long into the second
+#define	PM_MAX_RATE		(131072)	//input samples/s
+#define	PM_MIN_SNR		(8.0)		//correlation needed to believe a second - in standard
+						//deviations of what noise alone would give
+
+typedef struct
+{
+	double	pos;		//input sample number (fractional) that the second started at
+	int	bit;
+	float	quality;	//correlation with the sequence, 0 - 1
+	int	channel;	//(for iq.c - the carrier)
+} pmSecondT;
+
+typedef struct
+{
+	double	rate;		//input samples/s
+	double	chip;		//samples per chip
+	int	window;		//samples searched for each second's start (about a second)
+
+	//where the sequence changes: the correlation is the sum of weight[i] times the running
+	//sum of the phase at bound[i] chips from the start
+	int		numbounds;
+	short		bound[PM_CHIPS+1];
+	signed char	weight[PM_CHIPS+1];
+
+	//the samples, buffered for the search - the carrier's phase is an average of them
+	//either side of each (so it can't shift the times), what's left is the modulation
+	int		smooth;		//half the samples averaged
+	float*		re;
+	float*		im;
+	float*		y;
+	double*		sumre;		//running sums of re and im, y, and y squared
+	double*		sumim;
+	double*		sum;
+	double*		sumsq;
+	int		len;
+	int		size;
+	double		base;		//input sample number of re[0]
+} pmT;
+
+
+//the sequence, as +1/-1 chips (+1 is a phase lead when the bit is 0)
+void pmSequence ( signed char* chips );
+
+pmT* pmCreate ( double rate );
+//run n complex samples through - returns the number of seconds found (up to max)
+int pmProcess ( pmT* pm, const float* re, const float* im, int n, pmSecondT* secs, int max );
+void pmFree ( pmT* pm );
+
+
+#endif
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2002 Jon Atkins http://www.jonatkins.com/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include "config.h"
+
+#include <string.h>
+#include <math.h>
+
+#include "pollsched.h"
+
+
+//sampling interval outside the expected edge windows (seconds)
+#define	POLLSCHED_SLOW		(0.020)
+//half width of the window around an expected edge
+#define	POLLSCHED_MIN_WINDOW	(0.003)
+#define	POLLSCHED_MAX_WINDOW	(0.040)
+//forget edge phases not seen for this long
+#define	POLLSCHED_EXPIRE	(120.0)
+
+
+//distance from phase a to phase b, wrapped to -0.5 .. 0.5 seconds
+static time_f
+pollSchedPhaseDiff ( time_f a, time_f b )
+{
+	time_f	d;
+
+	d = b - a;
+	return d - floor ( d + 0.5 );
+}
+
+//the half width of the dense window around an edge phase
+static time_f
+pollSchedWindow ( const pollSchedT* ps, int i )
+{
+	time_f	w;
+
+	w = 4.0 * ps->phases[i].spread + POLLSCHED_DENSE;
+
+	if ( w < POLLSCHED_MIN_WINDOW )
+		w = POLLSCHED_MIN_WINDOW;
+	if ( w > POLLSCHED_MAX_WINDOW )
+		w = POLLSCHED_MAX_WINDOW;
+	return w;
+}
+
+void
+pollSchedInit ( pollSchedT* ps )
+{
+	memset ( ps, 0, sizeof(*ps) );
+}
+
+void
+pollSchedEdge ( pollSchedT* ps, time_ns when )
+{
+	time_f	phase, d, bestd;
+	int	i, best;
+
+	phase = time_ns2time_f ( when % NSEC_PER_SEC );
+
+	best = -1;
+	bestd = 0;
+	for ( i=0; i<POLLSCHED_MAX_PHASES; i++ )
+	{
+		if ( ps->phases[i].hits == 0 )
+			continue;
+
+		d = pollSchedPhaseDiff ( ps->phases[i].phase, phase );
+		if ( fabs(d) < POLLSCHED_MAX_WINDOW && (best < 0 || fabs(d) < fabs(bestd)) )
+		{
+			best = i;
+			bestd = d;
+		}
+	}
+
+	if ( best >= 0 )
+	{
+		ps->phases[best].phase += bestd / 8;
+		ps->phases[best].phase -= floor ( ps->phases[best].phase );
+		ps->phases[best].spread += (fabs(bestd) - ps->phases[best].spread) / 4;
+		ps->phases[best].lastseen = when;
+		ps->phases[best].hits++;
+		return;
+	}
+
+	//a new phase - replace an unused or the oldest entry
+	best = 0;
+	for ( i=0; i<POLLSCHED_MAX_PHASES; i++ )
+	{
+		if ( ps->phases[i].hits == 0 )
+		{
+			best = i;
+			break;
+		}
+		if ( ps->phases[i].lastseen < ps->phases[best].lastseen )
+			best = i;
+	}
+
+	ps->phases[best].phase = phase;
+	ps->phases[best].spread = POLLSCHED_MAX_WINDOW / 3;
+	ps->phases[best].lastseen = when;
+	ps->phases[best].hits = 1;
+}
+
+//densely inside the window around an expected edge, otherwise slowly, or at the start of the
+//next window if that's sooner
+time_ns
+pollSchedNext ( pollSchedT* ps, time_ns now, time_ns* pwindowend )
+{
+	time_ns	next, windowend, centre, w, sec;
+	int	i, k;
+
+	next = now + time_f2time_ns ( POLLSCHED_SLOW );
+	windowend = 0;
+	sec = now - now % NSEC_PER_SEC;
+
+	for ( i=0; i<POLLSCHED_MAX_PHASES; i++ )
+	{
+		if ( ps->phases[i].hits == 0 )
+			continue;
+
+		if ( time_ns2time_f ( now - ps->phases[i].lastseen ) > POLLSCHED_EXPIRE || now < ps->phases[i].lastseen )
+		{
+			ps->phases[i].hits = 0;
+			continue;
+		}
+
+		//a single edge could be noise - wait until it's been seen again
+		if ( ps->phases[i].hits < 2 )
+			continue;
+
+		w = time_f2time_ns ( pollSchedWindow ( ps, i ) );
+		for ( k=-1; k<=1; k++ )
+		{
+			centre = sec + k * NSEC_PER_SEC + time_f2time_ns ( ps->phases[i].phase );
+
+			if ( now >= centre - w && now < centre + w )
+			{
+				if ( centre + w > windowend )
+					windowend = centre + w;
+			}
+			else if ( centre - w > now && centre - w < next )
+			{
+				next = centre - w;
+			}
+		}
+	}
+
+	if ( windowend > 0 )
+		next = now + time_f2time_ns ( POLLSCHED_DENSE );
+
+	*pwindowend = windowend;
+	return next;
+}
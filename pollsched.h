@@ -0,0 +1,35 @@
+#ifndef POLLSCHED_H_
+#define POLLSCHED_H_
+
+#include "timef.h"
+
+//poll mode's sampling schedule: the phases within the second that a device's edges have been
+//seen at are learned, and the lines are only sampled densely in a window around the next
+//expected edge - slowly the rest of the time
+
+#define	POLLSCHED_MAX_PHASES	(8)
+#define	POLLSCHED_DENSE		(0.00025)	//sampling interval inside the windows (seconds)
+
+typedef struct
+{
+	struct
+	{
+		time_f	phase;		//0.0 - 1.0
+		time_f	spread;		//average distance of the edges from phase
+		time_ns	lastseen;
+		int	hits;
+	} phases[POLLSCHED_MAX_PHASES];
+} pollSchedT;
+
+
+void pollSchedInit ( pollSchedT* ps );
+
+//an edge was seen at when - add it to the nearest edge phase, or start a new one
+void pollSchedEdge ( pollSchedT* ps, time_ns when );
+
+//when to sample next, after sampling at now - and the end of the dense window now is in (0 if
+//it's outside one)
+time_ns pollSchedNext ( pollSchedT* ps, time_ns now, time_ns* pwindowend );
+
+
+#endif
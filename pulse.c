@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2002 Jon Atkins http://www.jonatkins.com/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "config.h"
+
+#include <string.h>
+#include <math.h>
+
+#include "pulse.h"
+#include "logger.h"
+
+
+#define	PULSE_MAX_SKEW		(0.080)		//furthest from nominal the pulses are looked for
+#define	PULSE_MATCH		(0.020)		//a length this close to a width fits it
+#define	PULSE_FIT_EVERY		(16)		//lengths between fits
+#define	PULSE_HALFLIFE		(1200)		//lengths - about 10 minutes of DCF77
+#define	PULSE_MIN_MASS		(60.0)		//lengths seen before the fit is believed
+#define	PULSE_MIN_CLUSTER	(5.0)		//lengths needed to centre a width on them...
+#define	PULSE_MIN_SPREAD	(30.0)		//...and to narrow its window to their spread
+#define	PULSE_SPREAD		(5.0)		//a width's window is this many standard deviations wide...
+#define	PULSE_MIN_TOLERANCE	(0.015)		//...but no narrower (either side)
+#define	PULSE_LOCK		(0.5)		//confidence to lock on, and to stay locked
+#define	PULSE_UNLOCK		(0.35)
+#define	PULSE_DEFAULT_SD	(0.010)		//a width's spread until there's enough to measure it
+#define	PULSE_MIN_SD		(PULSE_BIN / 2)
+#define	PULSE_SOFT_GAP		(0.101)		//widths this close take the lengths between their windows
+
+
+void
+pulseInit ( pulseClassT* pc, const time_f* widths )
+{
+	int	i;
+
+	memset ( pc, 0, sizeof(pulseClassT) );
+
+	for ( i=0; widths[i] > 0 && i < PULSE_MAX_WIDTHS; i++ )
+	{
+		pc->widths[i] = widths[i];
+		pc->centre[PULSE_LOW][i] = widths[i];
+		pc->centre[PULSE_HIGH][i] = widths[i];
+		pc->tolerance[PULSE_LOW][i] = PULSE_TOLERANCE;
+		pc->tolerance[PULSE_HIGH][i] = PULSE_TOLERANCE;
+		pc->spread[PULSE_LOW][i] = PULSE_DEFAULT_SD;
+		pc->spread[PULSE_HIGH][i] = PULSE_DEFAULT_SD;
+	}
+	pc->numwidths = i;
+}
+
+//the lengths seen within w of x - and their sum and sum of squares, for the centroid and spread
+static float
+pulseMass ( const pulseClassT* pc, int kind, time_f x, time_f w, double* sum, double* sumsq )
+{
+	double	v;
+	float	mass;
+	int	b, lo, hi;
+
+	lo = (int)((x - w) / PULSE_BIN);
+	hi = (int)((x + w) / PULSE_BIN);
+	if ( lo < 0 )
+		lo = 0;
+	if ( hi >= PULSE_BINS )
+		hi = PULSE_BINS - 1;
+
+	mass = 0;
+	for ( b=lo; b<=hi; b++ )
+	{
+		mass += pc->hist[kind][b];
+		if ( sum != NULL )
+		{
+			v = (b + 0.5) * PULSE_BIN;
+			*sum += pc->hist[kind][b] * v;
+			*sumsq += pc->hist[kind][b] * v * v;
+		}
+	}
+
+	return mass;
+}
+
+//the skew that puts the most lengths on the widths (the nearest nominal, on a tie), then each
+//width's centre and spread from the lengths around it - a receiver with clean edges gets narrow
+//windows, so less that's really a glitch gets taken for a pulse
+static void
+pulseFit ( pulseClassT* pc )
+{
+	time_f	d, best, expect, sd;
+	double	sum, sumsq;
+	float	score, bestscore, mass;
+	int	i, k, step;
+
+	best = 0;
+	bestscore = -1;
+	for ( step=0; step <= (int)(PULSE_MAX_SKEW / PULSE_BIN + 0.5) * 2; step++ )
+	{
+		//(0, +1, -1, +2, -2 ... bins)
+		d = ( step & 1 ? (step+1) / 2 : -(step / 2) ) * PULSE_BIN;
+
+		score = 0;
+		for ( i=0; i<pc->numwidths; i++ )
+		{
+			score += pulseMass ( pc, PULSE_LOW, pc->widths[i] + d, PULSE_MATCH, NULL, NULL );
+			score += pulseMass ( pc, PULSE_HIGH, pc->widths[i] - d, PULSE_MATCH, NULL, NULL );
+		}
+		if ( score > bestscore )
+		{
+			bestscore = score;
+			best = d;
+		}
+	}
+
+	pc->confidence = pc->mass > 0 ? bestscore / pc->mass : 0;
+
+	if ( !pc->locked && pc->mass >= PULSE_MIN_MASS && pc->confidence >= PULSE_LOCK )
+	{
+		pc->locked = 1;
+		pc->lastskew = best;
+		loggerf ( LOGGER_INFO, "pulse widths: locked on, pulses %+.0fms from nominal (confidence %.2f)\n",
+			best * 1000, pc->confidence );
+	}
+	else if ( pc->locked && pc->confidence < PULSE_UNLOCK )
+	{
+		pc->locked = 0;
+		loggerf ( LOGGER_INFO, "pulse widths: lost lock (confidence %.2f) - back to the nominal widths\n", pc->confidence );
+	}
+	else if ( pc->locked && fabs ( best - pc->lastskew ) >= 2 * PULSE_BIN )
+	{
+		pc->lastskew = best;
+		loggerf ( LOGGER_DEBUG, "pulse widths: pulses now %+.0fms from nominal (confidence %.2f)\n",
+			best * 1000, pc->confidence );
+	}
+
+	pc->skew = pc->locked ? best : 0;
+
+	for ( k=PULSE_LOW; k<=PULSE_HIGH; k++ )
+	{
+		for ( i=0; i<pc->numwidths; i++ )
+		{
+			expect = pc->widths[i] + ( k == PULSE_LOW ? pc->skew : -pc->skew );
+
+			sum = 0;
+			sumsq = 0;
+			mass = pulseMass ( pc, k, expect, PULSE_TOLERANCE, &sum, &sumsq );
+
+			pc->centre[k][i] = expect;
+			pc->tolerance[k][i] = PULSE_TOLERANCE;
+			pc->spread[k][i] = PULSE_DEFAULT_SD;
+			if ( !pc->locked || mass < PULSE_MIN_CLUSTER )
+				continue;
+
+			pc->centre[k][i] = sum / mass;
+			if ( mass < PULSE_MIN_SPREAD )
+				continue;
+
+			sd = sqrt ( fmax ( sumsq / mass - pc->centre[k][i] * pc->centre[k][i], 0 ) );
+			pc->spread[k][i] = fmax ( sd, PULSE_MIN_SD );
+			pc->tolerance[k][i] = fmin ( fmax ( PULSE_SPREAD * sd, PULSE_MIN_TOLERANCE ), PULSE_TOLERANCE );
+		}
+	}
+}
+
+int
+pulseClassify ( pulseClassT* pc, int kind, time_f length )
+{
+	time_f	diff, best;
+	float	decay;
+	int	i, b, match;
+
+	//only short pulses (and clears)...
+	if ( length < 0 || length >= PULSE_BINS * PULSE_BIN )
+		return -1;
+
+	b = (int)(length / PULSE_BIN);
+	pc->hist[kind][b] += 1;
+	pc->mass += 1;
+
+	if ( ++pc->sincefit >= PULSE_FIT_EVERY )
+	{
+		pc->sincefit = 0;
+		pulseFit ( pc );
+
+		//(a halving every PULSE_HALFLIFE lengths, a bit at a time - once there's enough to lock on)
+		if ( pc->mass >= 2 * PULSE_MIN_MASS )
+		{
+			decay = (float)pow ( 0.5, (double)PULSE_FIT_EVERY / PULSE_HALFLIFE );
+			for ( b=0; b<PULSE_BINS; b++ )
+			{
+				pc->hist[PULSE_LOW][b] *= decay;
+				pc->hist[PULSE_HIGH][b] *= decay;
+			}
+			pc->mass *= decay;
+		}
+	}
+
+	//the nearest centre, if it's close enough
+	match = -1;
+	best = PULSE_TOLERANCE;
+	for ( i=0; i<pc->numwidths; i++ )
+	{
+		diff = fabs ( length - pc->centre[kind][i] );
+		if ( diff < best && diff < pc->tolerance[kind][i] )
+		{
+			best = diff;
+			match = i;
+		}
+	}
+
+	//between two windows - the nearer, if they're widths a bit could be either of
+	if ( match < 0 )
+	{
+		for ( i=0; i<pc->numwidths; i++ )
+		{
+			if ( length <= pc->centre[kind][i] )
+				continue;
+			for ( b=0; b<pc->numwidths; b++ )
+			{
+				if ( length >= pc->centre[kind][b] || pc->widths[b] - pc->widths[i] > PULSE_SOFT_GAP
+				  || pc->widths[b] <= pc->widths[i] )
+					continue;
+
+				match = length - pc->centre[kind][i] < pc->centre[kind][b] - length ? i : b;
+				loggerf ( LOGGER_TRACE, "pulse widths: "TIMEF_FORMAT" between %.1f and %.1f - taken as %.1f\n",
+					length, pc->widths[i], pc->widths[b], pc->widths[match] );
+			}
+		}
+	}
+
+	return match < 0 ? -1 : (int)(pc->widths[match] * 10 + 0.5);	//to 10ths of a second
+}
+
+//which of the widths a code (10ths) is
+static int
+pulseWidth ( const pulseClassT* pc, int code )
+{
+	int	i;
+
+	for ( i=0; i<pc->numwidths; i++ )
+	{
+		if ( (int)(pc->widths[i] * 10 + 0.5) == code )
+			return i;
+	}
+	return -1;
+}
+
+float
+pulseCost ( const pulseClassT* pc, int kind, time_f length, int from, int to )
+{
+	time_f	sf, st, df, dt;
+	double	cost;
+	int	f, t;
+
+	f = pulseWidth ( pc, from );
+	t = pulseWidth ( pc, to );
+	if ( f < 0 || t < 0 )
+		return PULSE_MAX_COST;
+
+	//gaussian around each centre
+	sf = pc->spread[kind][f];
+	st = pc->spread[kind][t];
+	df = ( length - pc->centre[kind][f] ) / sf;
+	dt = ( length - pc->centre[kind][t] ) / st;
+	cost = ( dt * dt - df * df ) / 2 + log ( st / sf );
+
+	return (float)fmin ( fmax ( cost, 0 ), PULSE_MAX_COST );
+}
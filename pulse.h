@@ -0,0 +1,53 @@
+#ifndef PULSE_H_
+#define PULSE_H_
+
+#include "timef.h"
+
+//adaptive pulse classifier: receivers stretch (or shorten) the carrier reductions by tens of ms,
+//which can put them outside a fixed window around the nominal widths. the lengths seen are kept
+//in histograms, the pulses' skew from nominal is fitted to them (the clears between are short by
+//the same), and each nominal width's window is centred on where its lengths actually fall
+
+#define	PULSE_BIN		(0.005)		//histogram bin (seconds)
+#define	PULSE_BINS		(400)		//up to 2s
+#define	PULSE_MAX_WIDTHS	(8)
+#define	PULSE_TOLERANCE		(0.040)		//either side of a width's centre (at most)
+#define	PULSE_MAX_COST		(20.0)		//pulseCost()'s most - a width that's sure
+
+//what's being classified - a pulse (the carrier reduced) or the clear time after one
+#define	PULSE_LOW		(0)
+#define	PULSE_HIGH		(1)
+
+typedef struct
+{
+	time_f	widths[PULSE_MAX_WIDTHS];	//nominal
+	int	numwidths;
+
+	float	hist[2][PULSE_BINS];		//lengths seen, decaying (PULSE_LOW, PULSE_HIGH)
+	float	mass;				//total in both
+	int	sincefit;			//lengths added since the last fit
+
+	int	locked;				//the fit is believed - otherwise the nominal widths are used
+	time_f	skew;				//pulses are this much longer than nominal (clears shorter)
+	float	confidence;			//share of the lengths seen that fit the widths, 0 - 1
+	time_f	centre[2][PULSE_MAX_WIDTHS];	//where each width's window is centred
+	time_f	tolerance[2][PULSE_MAX_WIDTHS];	//and how far either side it goes
+	time_f	spread[2][PULSE_MAX_WIDTHS];	//the standard deviation of the lengths around it
+	time_f	lastskew;			//(as last logged)
+} pulseClassT;
+
+
+//widths ends in a value <= 0 (the clkLengths() tables)
+void pulseInit ( pulseClassT* pc, const time_f* widths );
+
+//learn a length, and classify it - returns the nominal width it matches, in 10ths of a second, or -1.
+//a length between the windows of two widths 100ms apart goes to the nearer (pulseCost() says how
+//sure that is) - anything else outside the windows is a glitch
+int pulseClassify ( pulseClassT* pc, int kind, time_f length );
+
+//how much less likely a length is to be the width 'to' than the width 'from' (10ths of a second,
+//as pulseClassify() returns) - a log likelihood ratio, 0 for a toss up, up to PULSE_MAX_COST
+float pulseCost ( const pulseClassT* pc, int kind, time_f length, int from, int to );
+
+
+#endif
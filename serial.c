@@ -26,22 +26,31 @@
 #include <unistd.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <fcntl.h>
 #include "systime.h"
 #include <sys/ioctl.h>
 #include <stdio.h>
-#include <signal.h>
 #include <setjmp.h>
 #include <sys/errno.h>
-
-#ifdef ENABLE_GPIO
 #include <poll.h>
+#include <pthread.h>
+#include <math.h>
+
+#ifdef ENABLE_TIMERFD
+#include <stdint.h>
+#include <sys/timerfd.h>
 #endif
 
 #ifdef ENABLE_TIMEPPS
 #include <sys/timepps.h>
 #endif
 
+#ifdef ENABLE_TIOCGICOUNT
+#include <linux/serial.h>
+#endif
+
 
 
 #include "logger.h"
@@ -50,9 +59,27 @@
 #include "memory.h"
 
 
+//how often to try reconnecting to a stream's socket (seconds)
+#define	SER_STREAM_RETRY	(2.0)
+
+//audio and iq: edges passed on per block read
+#define	SER_AUDIO_MAX_EDGES	(64)
+//how fast the sound card's clock is allowed to fall behind ours (see serAudioThread())
+#define	SER_AUDIO_SLEW		(0.0001)
+
+
 static serDevT* 	serDevHead;
 static serLineT*	serLineHead;
 
+static char*		serReplayFile;
+static int		serReplayRealtime;
+
+static int		serAudioOffline;
+
+static int		serIQRate;
+static int		serIQCentre;
+static int		serIQOffline;
+
 
 int
 serInit (void)
@@ -63,12 +90,34 @@ serInit (void)
 	return 0;
 }
 
+void
+serSetReplay ( char* file, int realtime )
+{
+	serReplayFile = file;
+	serReplayRealtime = realtime;
+}
+
+void
+serSetAudio ( int offline )
+{
+	serAudioOffline = offline;
+}
+
+void
+serSetIQ ( int rate, int centre, int offline )
+{
+	serIQRate = rate;
+	serIQCentre = centre;
+	serIQOffline = offline;
+}
+
 serLineT*
 serAddLine ( char* dev, int line, int mode )
 {
 	char		fulldev[64];
 	serDevT*	serdev;
 	serLineT*	serline;
+	int		id;
 
 	//allow for either full paths or /dev relative paths...
 	if ( dev[0] == '/' )
@@ -92,7 +141,8 @@ serAddLine ( char* dev, int line, int mode )
 	}
 
 	//make sure only one line bit is set...
-	if ( line & (line-1) )
+	if ( mode != SERPORT_MODE_GPIOCDEV && mode != SERPORT_MODE_REPLAY && mode != SERPORT_MODE_STREAM
+	  && mode != SERPORT_MODE_AUDIO && mode != SERPORT_MODE_IQ && (line & (line-1)) )
 	{
 		loggerf ( LOGGER_NOTE, "serAddLine(): more than one line bit set\n" );
 		return NULL;
@@ -126,6 +176,64 @@ serAddLine ( char* dev, int line, int mode )
 		return NULL;
 	}
 
+	id = line;
+
+	//a replay or stream can have tty lines or gpio offsets (audio, channels - iq, carriers) - give each its own line bit
+	if ( mode == SERPORT_MODE_REPLAY || mode == SERPORT_MODE_STREAM || mode == SERPORT_MODE_AUDIO
+	  || mode == SERPORT_MODE_IQ )
+	{
+		for ( serline = serLineHead; serline != NULL; serline = serline->next )
+		{
+			if ( serline->dev == serdev && serline->id == id )
+			{
+				loggerf ( LOGGER_NOTE, "serAddLine(): cannot add modem status line more than once\n" );
+				return NULL;
+			}
+		}
+
+		for ( line = 1; line < (1 << SER_MAX_LINE_BITS); line <<= 1 )
+		{
+			if ( !(serdev->modemlines & line) )
+				break;
+		}
+		if ( line == (1 << SER_MAX_LINE_BITS) )
+		{
+			loggerf ( LOGGER_NOTE, "serAddLine(): too many lines to replay or stream\n" );
+			return NULL;
+		}
+	}
+
+#ifdef ENABLE_GPIOCDEV
+	//gpio chip lines are given as an offset - turn it into a line bit
+	if ( mode == SERPORT_MODE_GPIOCDEV )
+	{
+		int	i;
+
+		if ( line < 0 )
+		{
+			loggerf ( LOGGER_NOTE, "serAddLine(): bad gpio line offset\n" );
+			return NULL;
+		}
+
+		for ( i=0; i<serdev->gpionumlines; i++ )
+		{
+			if ( serdev->gpiooffsets[i] == line )
+				break;
+		}
+		if ( i == serdev->gpionumlines )
+		{
+			if ( i >= SER_GPIO_MAX_LINES )
+			{
+				loggerf ( LOGGER_NOTE, "serAddLine(): too many lines on gpio chip\n" );
+				return NULL;
+			}
+			serdev->gpiooffsets[serdev->gpionumlines++] = line;
+		}
+
+		line = 1 << i;
+	}
+#endif
+
 
 	//make sure we're not already monitoring this line...
 	if ( serdev->modemlines & line )
@@ -145,6 +253,7 @@ serAddLine ( char* dev, int line, int mode )
 
 	serline->dev = serdev;
 	serline->line = line;
+	serline->id = id;
 
 	return serline;
 
@@ -170,279 +279,1365 @@ serGetLine ( serLineT* prev )
 	return prev->next;
 }
 
+//the bit number of a (single bit) line - its index in serCountT.count
+static int
+serLineBit ( int line )
+{
+	int	bit;
 
-int
-serOpenDev ( serDevT* dev )
+	for ( bit=0; bit<SER_MAX_LINE_BITS-1; bit++ )
+	{
+		if ( line & (1 << bit) )
+			break;
+	}
+	return bit;
+}
+
+#ifdef ENABLE_TIOCGICOUNT
+//read the kernel's interrupt counts for the modem lines
+//(not for the ring indicator - only its trailing edges are counted)
+static void
+serReadCounts ( serDevT* dev, serCountT* counts )
 {
-#ifdef ENABLE_TIMEPPS
-	pps_params_t	ppsparams;
-	int		ppsmode;
+	struct serial_icounter_struct	icount;
+
+	counts->valid = 0;
+
+	if ( !dev->icountok || ioctl ( dev->fd, TIOCGICOUNT, &icount ) != 0 )
+		return;
+
+	counts->count[serLineBit(TIOCM_CD)] = icount.dcd;
+	counts->count[serLineBit(TIOCM_CTS)] = icount.cts;
+	counts->count[serLineBit(TIOCM_DSR)] = icount.dsr;
+	counts->valid = dev->modemlines & (TIOCM_CD | TIOCM_CTS | TIOCM_DSR);
+}
 #endif
 
-	dev->fd = open ( dev->dev, O_RDONLY|O_NOCTTY );
 
-	switch ( dev->mode )
+#ifdef ENABLE_GPIOCDEV
+//request all the lines used on a gpio chip as one line request, with edge
+//detection on both edges - dev->fd becomes the line request fd, which
+//delivers the edge events (with kernel timestamps) for all the lines
+static int
+serOpenGpioChip ( serDevT* dev )
+{
+	struct gpio_v2_line_request	req;
+	struct gpio_v2_line_values	values;
+	int		chipfd, i;
+
+	chipfd = open ( dev->dev, O_RDONLY );
+	if ( chipfd < 0 )
+		return -1;
+
+	memset ( &req, 0, sizeof(req) );
+	for ( i=0; i<dev->gpionumlines; i++ )
+		req.offsets[i] = dev->gpiooffsets[i];
+	req.num_lines = dev->gpionumlines;
+	strcpy ( req.consumer, "radioclkd2" );
+	req.config.flags = GPIO_V2_LINE_FLAG_INPUT
+		| GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+
+	if ( ioctl ( chipfd, GPIO_V2_GET_LINE_IOCTL, &req ) != 0 )
 	{
-#ifdef ENABLE_TIMEPPS
-	case SERPORT_MODE_TIMEPPS:
-		if ( time_pps_create ( dev->fd, &dev->ppshandle ) == -1 )
-			return -1;
+		loggerf ( LOGGER_NOTE, "Error: failed to request lines on %s: %d\n", dev->dev, errno );
+		close ( chipfd );
+		return -1;
+	}
+	close ( chipfd );
 
-		if ( time_pps_getparams ( dev->ppshandle, &ppsparams ) == -1 )
-			return -1;
+	//the events only say which way a line went - start with the current levels
+	memset ( &values, 0, sizeof(values) );
+	values.mask = (1ULL << dev->gpionumlines) - 1;
+	if ( ioctl ( req.fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values ) != 0 )
+	{
+		close ( req.fd );
+		return -1;
+	}
+	dev->gpiolines = (int)values.bits;
 
-		ppsparams.mode |= PPS_TSFMT_TSPEC | PPS_CAPTUREBOTH;
+	dev->gpioevcount = 0;
+	dev->gpioevpos = 0;
+	dev->gpiolastseqno = 0;
 
-		if ( time_pps_setparams ( dev->ppshandle, &ppsparams ) == -1 )
-			return -1;
+	return req.fd;
+}
 
-		if ( time_pps_getcap ( dev->ppshandle, &ppsmode ) == -1 )
+//take the next edge event from the buffer (reading more from the kernel when it's empty)
+static int
+serReadGpioEvent ( serDevT* dev )
+{
+	struct gpio_v2_line_event*	ev;
+	timeStampT	ts;
+	serCountT	counts;
+	int	n, bit;
+
+	if ( dev->gpioevpos >= dev->gpioevcount )
+	{
+		n = read ( dev->fd, dev->gpioevents, sizeof(dev->gpioevents) );
+		if ( n < (int)sizeof(struct gpio_v2_line_event) )
 			return -1;
 
-		//NOTE: these should probably be error cases, but the code is still experimental and
-		//the PPS support I've used also seems to have problems
-		if ( ! (ppsmode | PPS_CAPTUREASSERT) )
-			loggerf ( LOGGER_NOTE, "Warning: PPS_CAPTUREASSERT not supported\n" );
-		if ( ! (ppsmode | PPS_CAPTURECLEAR) )
-			loggerf ( LOGGER_NOTE, "Warning: PPS_CAPTURECLEAR not supported\n" );
+		dev->gpioevcount = n / sizeof(struct gpio_v2_line_event);
+		dev->gpioevpos = 0;
+	}
+
+	ev = &dev->gpioevents[dev->gpioevpos++];
 
-//!!! no point using this - too many problems
-//1. linux doesn't report PPS_CANWAIT, but can
-//2. FreeBSD does report PPS_CANWAIT, but can't
-//(unless its me reading the docs backwards?)
-//		if ( ! (ppsmode | PPS_CANWAIT) )
-//			loggerf ( LOGGER_NOTE, "Warning: PPS_CANWAIT not supported (linux lies)\n" );
+	if ( dev->gpiolastseqno != 0 && ev->seqno != dev->gpiolastseqno + 1 )
+		loggerf ( LOGGER_INFO, "warning: %s: lost %u gpio events\n", dev->dev, ev->seqno - dev->gpiolastseqno - 1 );
+	dev->gpiolastseqno = ev->seqno;
 
-#endif
+	for ( bit=0; bit<dev->gpionumlines; bit++ )
+	{
+		if ( dev->gpiooffsets[bit] == (int)ev->offset )
+			break;
 	}
+	if ( bit == dev->gpionumlines )
+		return 0;
 
-	return dev->fd;
+	if ( ev->id == GPIO_V2_LINE_EVENT_RISING_EDGE )
+		dev->gpiolines |= 1 << bit;
+	else
+		dev->gpiolines &= ~(1 << bit);
+
+	//(the kernel stamps line events with CLOCK_MONOTONIC)
+	timeStampFromMono ( &ts, (time_ns)ev->timestamp_ns );
+
+	//the line's sequence number counts its edges
+	counts.valid = 1 << bit;
+	counts.count[bit] = ev->line_seqno;
+
+	return serStoreDevStatusLines ( dev, dev->gpiolines, &counts, &ts );
 }
+#endif
 
-int
-serInitHardware ( serDevT* dev )
+#ifdef ENABLE_TIMEPPS
+static int
+serOpenPPS ( serDevT* dev )
 {
-	if ( dev->fd < 0 )
-		serOpenDev ( dev );
+	pps_params_t	ppsparams;
+	pps_info_t	ppsinfo;
+	struct timespec	timeout;
+	int		ppsmode;
 
-	if ( dev->fd < 0 )
+	if ( time_pps_create ( dev->fd, &dev->ppshandle ) == -1 )
 		return -1;
 
-	//add code to power on the device (set DTR high - maybe other options..?)
+	if ( time_pps_getparams ( dev->ppshandle, &ppsparams ) == -1 )
+		return -1;
 
-	//wait for the device to power up...
-	sleep(3);
+	ppsparams.mode |= PPS_TSFMT_TSPEC | PPS_CAPTUREBOTH;
 
-	return 0;
-}
+	if ( time_pps_setparams ( dev->ppshandle, &ppsparams ) == -1 )
+		return -1;
 
+	if ( time_pps_getcap ( dev->ppshandle, &ppsmode ) == -1 )
+		return -1;
 
-//static jmp_buf alrmjump;
+	//NOTE: these should probably be error cases, but the code is still experimental and
+	//the PPS support I've used also seems to have problems
+	if ( ! (ppsmode & PPS_CAPTUREASSERT) )
+		loggerf ( LOGGER_NOTE, "Warning: PPS_CAPTUREASSERT not supported\n" );
+	if ( ! (ppsmode & PPS_CAPTURECLEAR) )
+		loggerf ( LOGGER_NOTE, "Warning: PPS_CAPTURECLEAR not supported\n" );
+
+	//don't trust PPS_CANWAIT - linux doesn't report it but can wait, and
+	//FreeBSD reports it but couldn't. serFetchPPS() finds out by trying.
+	dev->ppscanwait = 1;
+
+	//start from the current sequence numbers, rather than reporting the last
+	//(old) events as soon as we start
+	timeout.tv_sec = 0;
+	timeout.tv_nsec = 0;
+	if ( time_pps_fetch ( dev->ppshandle, PPS_TSFMT_TSPEC, &ppsinfo, &timeout ) == -1 )
+		return -1;
 
-#ifdef ENABLE_TIOCMIWAIT
-static void
-sigalrm ( int sig )
-{
-	//empty func - just used so that ioctl() aborts on an alarm()
+	dev->ppslastassert = ppsinfo.assert_sequence;
+	dev->ppslastclear = ppsinfo.clear_sequence;
+
+	return 0;
 }
-#endif
 
-int
-serWaitForSerialChange ( serDevT* dev )
+//fetch the pps events since the last call, waiting up to timeout for one.
+//a pps device only keeps the latest assert and clear, so if both have
+//changed they are returned in the order they happened
+static int
+serFetchPPS ( serDevT* dev, serEventT* ev, const struct timespec* timeout )
 {
-	struct timeval tv;
-	time_f	timef;
-	int	i,ret;
-#ifdef ENABLE_TIMEPPS
-	struct timespec timeout;
 	pps_info_t	ppsinfo;
-	int		ppslines;
-#endif
-#ifdef ENABLE_GPIO
-	struct pollfd  pollfds[1];
-#endif
+	serEventT	assertev, clearev;
+	time_ns		asserttime, cleartime;
+	int		newassert, newclear, bit;
 
-	if ( dev->modemlines == 0 )
+	if ( time_pps_fetch ( dev->ppshandle, PPS_TSFMT_TSPEC, &ppsinfo, timeout ) == -1 )
 		return -1;
 
-	switch ( dev->mode )
-	{
-	case SERPORT_MODE_POLL:
-
-		for ( i=0; i<10*1000; i++ )
-		{
-			gettimeofday ( &tv, NULL );
-			timeval2time_f ( &tv, timef );
-			ret = serGetDevStatusLines ( dev, timef );
-			if ( ret < 0 )
-				return -1;
-			if ( ret == 1 )
-				return 0;
+	newassert = ppsinfo.assert_sequence - dev->ppslastassert;
+	newclear = ppsinfo.clear_sequence - dev->ppslastclear;
 
-			usleep ( 1000 );
-		}
+	if ( newassert > 1 || newclear > 1 )
+		loggerf ( LOGGER_DEBUG, "%s: missed %d pps events\n", dev->dev,
+			(newassert > 1 ? newassert-1 : 0) + (newclear > 1 ? newclear-1 : 0) );
 
-		//timeout
-		return -1;
-		break;
+	dev->ppslastassert = ppsinfo.assert_sequence;
+	dev->ppslastclear = ppsinfo.clear_sequence;
 
-#ifdef ENABLE_GPIO
-	case SERPORT_MODE_GPIO:
-		pollfds[0].fd = dev->fd;
-		pollfds[0].events = POLLERR;
+	memset ( &assertev, 0, sizeof(assertev) );
+	memset ( &clearev, 0, sizeof(clearev) );
 
-		i = poll(pollfds, 1, 10000); /* timeout 10 seconds */
-		if (i != 1 && !(pollfds[0].revents & POLLERR) )
-			return -1;
+	//the pps line is whichever line was given for this device (only one is allowed)
+	timespec2time_ns ( &ppsinfo.assert_timestamp, asserttime );
+	timeStampFromReal ( &assertev.time, asserttime );
+	assertev.lines = dev->modemlines;
+	timespec2time_ns ( &ppsinfo.clear_timestamp, cleartime );
+	timeStampFromReal ( &clearev.time, cleartime );
 
-		gettimeofday ( &tv, NULL );
-		timeval2time_f ( &tv, timef );
+	//the line's edge count is both sequences together (the earlier event of a pair is one less)
+	bit = serLineBit ( dev->modemlines );
+	assertev.counts.valid = dev->modemlines;
+	assertev.counts.count[bit] = ppsinfo.assert_sequence + ppsinfo.clear_sequence;
+	clearev.counts = assertev.counts;
+	if ( newassert && newclear )
+	{
+		if ( asserttime <= cleartime )
+			assertev.counts.count[bit]--;
+		else
+			clearev.counts.count[bit]--;
+	}
 
-		if ( serGetDevStatusLines ( dev, timef ) < 0 )
-			return -1;
+	if ( newassert && newclear )
+	{
+		if ( asserttime <= cleartime )
+		{
+			ev[0] = assertev;
+			ev[1] = clearev;
+		}
+		else
+		{
+			ev[0] = clearev;
+			ev[1] = assertev;
+		}
+		return 2;
+	}
+	else if ( newassert )
+	{
+		ev[0] = assertev;
+		return 1;
+	}
+	else if ( newclear )
+	{
+		ev[0] = clearev;
+		return 1;
+	}
 
-		return 0;
-		break;
+	return 0;
+}
 #endif
 
+//connect to (or open) an edge stream - returns the fd, or -1 if the sender isn't there yet
+static int
+serOpenStream ( serDevT* dev )
+{
+	struct sockaddr_un	addr;
+	int	fd;
 
-#ifdef ENABLE_TIOCMIWAIT
-	case SERPORT_MODE_IWAIT:
-		signal ( SIGALRM, sigalrm );
-		alarm ( 10 );
+	if ( dev->streamsock )
+	{
+		if ( strlen ( dev->dev ) >= sizeof(addr.sun_path) )
+			return -1;
 
-		if ( ioctl ( dev->fd, TIOCMIWAIT, dev->modemlines) != 0 )
+		fd = socket ( AF_UNIX, SOCK_STREAM, 0 );
+		if ( fd < 0 )
 			return -1;
-		gettimeofday ( &tv, NULL );
-		timeval2time_f ( &tv, timef );
 
-		signal ( SIGALRM, SIG_DFL );
-		alarm ( 0 );
+		memset ( &addr, 0, sizeof(addr) );
+		addr.sun_family = AF_UNIX;
+		strcpy ( addr.sun_path, dev->dev );
 
-		if ( serGetDevStatusLines ( dev, timef ) < 0 )
+		if ( connect ( fd, (struct sockaddr*)&addr, sizeof(addr) ) != 0
+		  || fcntl ( fd, F_SETFL, O_NONBLOCK ) != 0 )
+		{
+			close ( fd );
 			return -1;
+		}
+	}
+	else
+	{
+		//(nonblocking, so this doesn't wait for a writer)
+		fd = open ( dev->dev, O_RDONLY|O_NONBLOCK );
+		if ( fd < 0 )
+			return -1;
+	}
 
-		return 0;
-		break;
-#endif
+	dev->capin = capAttach ( fd );
+	dev->fd = fd;
 
-#ifdef ENABLE_TIMEPPS
-	case SERPORT_MODE_TIMEPPS:
-		timeout.tv_sec = 0;
-		timeout.tv_nsec = 0;
+	return fd;
+}
 
-		for ( i=0; i<10*100; i++ )
-		{
-			if ( time_pps_fetch ( dev->ppshandle, PPS_TSFMT_TSPEC, &ppsinfo, &timeout ) == -1 )
-			{
-				loggerf ( LOGGER_NOTE, "ppsfetch failed: %d\n", errno );
-				return -1;
-			}
+static void
+serCloseStream ( serDevT* dev )
+{
+	time_ns		now;
 
-			if ( ppsinfo.assert_sequence != dev->ppslastassert )
-			{
-				timespec2time_f ( &ppsinfo.assert_timestamp, timef );
-				ppslines = TIOCM_CD;	//NOTE: assuming that pps support is on the DCD line
-				dev->ppslastassert = ppsinfo.assert_sequence;
+	if ( dev->capin != NULL )
+		capCloseRead ( dev->capin );	//(closes the fd)
 
-				if ( serStoreDevStatusLines ( dev, ppslines, timef ) < 0 )
-					return -1;
-				return 0;
-			}
-			else if ( ppsinfo.clear_sequence != dev->ppslastclear )
-			{
-				timespec2time_f ( &ppsinfo.clear_timestamp, timef );
-				ppslines = 0;
-				dev->ppslastclear = ppsinfo.clear_sequence;
+	dev->capin = NULL;
+	dev->fd = -1;
+	dev->streammore = 0;
 
-				if ( serStoreDevStatusLines ( dev, ppslines, timef ) < 0 )
-					return -1;
-				return 0;
-			}
+	gettime_ns ( now );
+	dev->pollnext = now + time_f2time_ns ( SER_STREAM_RETRY );
+}
 
-			usleep ( 10000 );
-		}
+static int
+serOpenAudio ( serDevT* dev )
+{
+	serLineT*	line;
+	int		fd;
 
+	fd = open ( dev->dev, O_RDONLY );
+	if ( fd < 0 )
 		return -1;
-		break;
-#endif
 
+	dev->audio = audioOpen ( fd, dev->dev );
+	if ( dev->audio == NULL )
+	{
+		close ( fd );
+		return -1;
 	}
 
-	loggerf ( LOGGER_NOTE, "Error: serWaitForSerialChange(): mode not supported\n" );
+	for ( line = serLineHead; line != NULL; line = line->next )
+	{
+		if ( line->dev == dev && audioUseChannel ( dev->audio, line->id ) < 0 )
+		{
+			loggerf ( LOGGER_NOTE, "Error: %s has no channel %d\n", dev->dev, line->id );
+			audioClose ( dev->audio );
+			dev->audio = NULL;
+			return -1;
+		}
+	}
 
-	//unknown serial port mode !!
-	return -1;
+	dev->offline = serAudioOffline;
+	dev->fd = fd;
 
+	return fd;
 }
 
-int
-serGetDevStatusLines ( serDevT* dev, time_f timef )
+static int
+serOpenIQ ( serDevT* dev )
 {
-	int	lines;
+	serLineT*	line;
+	int		fd;
 
-#ifdef ENABLE_GPIO
-	char    buf[8];
-	if (dev->mode == SERPORT_MODE_GPIO) {
-		if (lseek(dev->fd, SEEK_SET, 0) == -1)
-			return -1;
-		if (read(dev->fd, buf, sizeof(buf)) <= 0)
-			return -1;
+	fd = open ( dev->dev, O_RDONLY );
+	if ( fd < 0 )
+		return -1;
 
-		if (buf[0] == '1')
-			lines = TIOCM_CD;
-		else
-			lines = 0;
+	dev->iq = iqOpen ( fd, serIQRate, serIQCentre );
+	if ( dev->iq == NULL )
+	{
+		close ( fd );
+		return -1;
+	}
 
-		return serStoreDevStatusLines ( dev, lines, timef );
+	for ( line = serLineHead; line != NULL; line = line->next )
+	{
+		if ( line->dev == dev && iqUseCarrier ( dev->iq, line->id ) < 0 )
+		{
+			loggerf ( LOGGER_NOTE, "Error: %s can't receive %dHz (centre %dHz, %d samples/s)\n",
+				dev->dev, line->id, serIQCentre, serIQRate );
+			iqClose ( dev->iq );
+			dev->iq = NULL;
+			return -1;
+		}
+		if ( line->dev == dev && line->pm && iqUsePM ( dev->iq, line->id ) < 0 )
+		{
+			loggerf ( LOGGER_NOTE, "Error: %s can't correlate %dHz's phase modulation\n", dev->dev, line->id );
+			iqClose ( dev->iq );
+			dev->iq = NULL;
+			return -1;
+		}
 	}
-#endif
 
-	if ( ioctl ( dev->fd, TIOCMGET, &lines ) != 0 )
-		return -1;
+	dev->offline = serIQOffline;
+	dev->fd = fd;
 
-	return serStoreDevStatusLines ( dev, lines, timef );
+	return fd;
 }
 
 int
-serStoreDevStatusLines ( serDevT* dev, int lines, time_f timef )
+serOpenDev ( serDevT* dev )
 {
 
-	time_f diff = timef - dev->eventtime;
-	if (diff < 0.05) {
-		loggerf ( LOGGER_DEBUG, "serStoreDevStatusLines: pulse too short %f, filtering!\n", diff);
-		return 0;
+#ifdef ENABLE_GPIOCDEV
+	if ( dev->mode == SERPORT_MODE_GPIOCDEV )
+	{
+		dev->fd = serOpenGpioChip ( dev );
+		return dev->fd;
 	}
-	if ( lines != dev->curlines )
+#endif
+
+	if ( dev->mode == SERPORT_MODE_REPLAY )
 	{
-		dev->prevlines = dev->curlines;
-		dev->curlines = lines;
-		dev->eventtime = timef;
+		dev->fd = -1;
+		if ( serReplayFile == NULL )
+			return -1;
 
-		return 1;
+		dev->capin = capOpenRead ( serReplayFile );
+		if ( dev->capin != NULL )
+			dev->fd = dev->capin->fd;
+		dev->offline = 1;
+		return dev->fd;
 	}
 
-	return 0;
-}
+	if ( dev->mode == SERPORT_MODE_AUDIO )
+		return serOpenAudio ( dev );
 
+	if ( dev->mode == SERPORT_MODE_IQ )
+		return serOpenIQ ( dev );
 
-int
-serUpdateLinesForDevice ( serDevT* dev )
-{
-	serLineT* line;
+	if ( dev->mode == SERPORT_MODE_STREAM )
+		return serOpenStream ( dev );
 
-	for ( line = serGetLine ( NULL );  line != NULL; line = serGetLine ( line ) )
-	{
-		//skip lines not on this device...
-		if ( line->dev != dev )
-			continue;
+	dev->fd = open ( dev->dev, O_RDONLY|O_NOCTTY );
 
-		if ( (dev->curlines & line->line) != (dev->prevlines & line->line) )
-		{
-			line->curstate = dev->curlines & line->line;
-			line->eventtime = dev->eventtime;
+	switch ( dev->mode )
+	{
+#ifdef ENABLE_TIMEPPS
+	case SERPORT_MODE_TIMEPPS:
+		if ( dev->fd < 0 )
+			return -1;
+
+		if ( serOpenPPS ( dev ) < 0 )
+		{
+			close ( dev->fd );
+			dev->fd = -1;
+			return -1;
+		}
+		break;
+#endif
+	}
+
+	return dev->fd;
+}
+
+int
+serInitHardware ( serDevT* dev )
+{
+	struct stat	st;
+
+	//a stream's sender may not be running yet - that's fine, it's retried from the main loop
+	if ( dev->mode == SERPORT_MODE_STREAM )
+	{
+		if ( stat ( dev->dev, &st ) != 0 || !(S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode)) )
+		{
+			loggerf ( LOGGER_NOTE, "Error: %s is not a fifo or unix socket\n", dev->dev );
+			return -1;
 		}
+		dev->streamsock = S_ISSOCK(st.st_mode);
+		dev->streamlines = 0;
+		dev->streamcounts.valid = dev->modemlines;
+
+		if ( dev->fd < 0 && serOpenStream ( dev ) < 0 )
+		{
+			loggerf ( LOGGER_INFO, "%s: can't connect to the stream yet - will keep trying\n", dev->dev );
+			serCloseStream ( dev );
+		}
+		return 0;
 	}
 
+	if ( dev->fd < 0 )
+		serOpenDev ( dev );
+
+	if ( dev->fd < 0 )
+		return -1;
+
+#ifdef ENABLE_TIOCGICOUNT
+	//not all serial drivers keep interrupt counts (usb serial adapters often don't)
+	if ( dev->mode == SERPORT_MODE_IWAIT || dev->mode == SERPORT_MODE_POLL )
+	{
+		struct serial_icounter_struct	icount;
+
+		dev->icountok = ( ioctl ( dev->fd, TIOCGICOUNT, &icount ) == 0 );
+		if ( !dev->icountok )
+			loggerf ( LOGGER_INFO, "%s: no interrupt counts - lost edges can't be detected\n", dev->dev );
+	}
+#endif
+
+	//add code to power on the device (set DTR high - maybe other options..?)
+
+	//(the caller waits for the devices to power up - once for all of them)
+
 	return 0;
 }
+
+
+//poll mode: arm the timer for dev->pollnext. in a dense window the timer is left
+//running periodically, so it doesn't have to be set again for every sample
+static void
+serPollArm ( serDevT* dev, time_ns now )
+{
+#ifdef ENABLE_TIMERFD
+	struct itimerspec	its;
+	struct timespec		mono;
+	time_ns			delta, monons;
+
+	if ( dev->timerfd < 0 )
+		return;
+
+	if ( dev->pollwindowend > 0 && dev->timerperiodic )
+		return;
+
+	//the deadline is in wall clock time, but the timer runs on the monotonic clock
+	//so that it isn't upset by clock steps
+	delta = dev->pollnext - now;
+	if ( delta < 1000 )
+		delta = 1000;
+
+	clock_gettime ( CLOCK_MONOTONIC, &mono );
+	timespec2time_ns ( &mono, monons );
+	time_ns2timespec ( monons + delta, &its.it_value );
+
+	its.it_interval.tv_sec = 0;
+	its.it_interval.tv_nsec = 0;
+	dev->timerperiodic = 0;
+	if ( dev->pollwindowend > 0 )
+	{
+		its.it_interval.tv_nsec = (long)(POLLSCHED_DENSE * 1000000000.0);
+		dev->timerperiodic = 1;
+	}
+
+	timerfd_settime ( dev->timerfd, TFD_TIMER_ABSTIME, &its, NULL );
+#endif
+}
+
+//poll mode: work out when to sample next (see pollsched.h) - and arm the timer for it
+static void
+serPollSchedule ( serDevT* dev, time_ns now )
+{
+	dev->pollnext = pollSchedNext ( &dev->pollsched, now, &dev->pollwindowend );
+	if ( dev->pollwindowend == 0 )
+		dev->timerperiodic = 0;	//left the window - back to one-shot deadlines
+
+	serPollArm ( dev, now );
+}
+
+int
+serPollTimeout ( serDevT* dev )
+{
+	time_ns		now;
+
+	gettime_ns ( now );
+
+	if ( dev->pollnext <= now )
+		return 0;
+
+	return (int)((dev->pollnext - now + 999999) / 1000000);
+}
+
+static void*
+serWaitThread ( void* arg )
+{
+	serDevT*	dev = arg;
+	serEventT	ev[SER_MAX_WAIT_EVENTS];
+	int		n;
+
+	//no timeouts here - the main loop notices a device that has gone quiet
+	while(1)
+	{
+		n = serWaitForSerialChange ( dev, ev );
+		if ( n <= 0 )
+		{
+			//don't spin on a device that has gone away
+			if ( errno != ETIMEDOUT && errno != EINTR )
+				sleep(1);
+			continue;
+		}
+
+		ev[0].syscalls++;	//the write() below
+
+		if ( write ( dev->evpipe[1], ev, n * sizeof(serEventT) ) != n * (int)sizeof(serEventT) )
+			loggerf ( LOGGER_NOTE, "Error: failed to pass serial line change to main loop\n" );
+	}
+
+	return NULL;
+}
+
+//apply an edge record (from a capture or a stream) to the line levels, and to the edge
+//counts rebuilt from them - returns 0 if it isn't for one of the device's lines
+static int
+serApplyEdgeRecord ( serDevT* dev, const capRecordT* rec, int* lines, serCountT* counts )
+{
+	serLineT*	line;
+	int		bit;
+
+	for ( line = serLineHead; line != NULL; line = line->next )
+	{
+		if ( line->dev == dev && line->id == rec->line )
+			break;
+	}
+	if ( line == NULL )
+		return 0;
+
+	bit = serLineBit ( line->line );
+	if ( ((*lines & line->line) != 0) != (rec->level != 0) )
+		counts->count[bit]++;
+	counts->count[bit] += rec->lost;
+
+	if ( rec->level )
+		*lines |= line->line;
+	else
+		*lines &= ~line->line;
+
+	return 1;
+}
+
+//the waiter thread for a replay: pass the device's edges from the capture to the main
+//loop, with the edge counts rebuilt from them - closes the pipe at the end
+static void*
+serReplayThread ( void* arg )
+{
+	serDevT*	dev = arg;
+	serEventT	ev;
+	capRecordT	rec;
+	time_ns		first, start;
+	timeStampT	now;
+	struct timespec	wake;
+	unsigned long	edges;
+
+	memset ( &ev, 0, sizeof(ev) );
+	ev.counts.valid = dev->modemlines;
+
+	first = 0;
+	start = 0;
+	edges = 0;
+
+	while ( capRead ( dev->capin, &rec ) > 0 )
+	{
+		if ( rec.type != CAP_REC_EDGE || strcmp ( rec.dev, dev->dev ) != 0 )
+			continue;
+
+		if ( !serApplyEdgeRecord ( dev, &rec, &ev.lines, &ev.counts ) )
+			continue;
+
+		ev.time = rec.time;
+		edges++;
+
+		//keep the spacing of the edges as they were captured
+		if ( serReplayRealtime )
+		{
+			if ( first == 0 )
+			{
+				first = rec.time.mono;
+				timeGetStamp ( &now );
+				start = now.mono;
+			}
+
+			time_ns2timespec ( start + (rec.time.mono - first), &wake );
+			while ( clock_nanosleep ( CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL ) == EINTR )
+				;
+		}
+
+		if ( write ( dev->evpipe[1], &ev, sizeof(ev) ) != sizeof(ev) )
+		{
+			loggerf ( LOGGER_NOTE, "Error: failed to pass replayed change to main loop\n" );
+			break;
+		}
+	}
+
+	loggerf ( LOGGER_INFO, "%s: replay finished after %lu edges\n", dev->dev, edges );
+
+	close ( dev->evpipe[1] );
+
+	return NULL;
+}
+
+//take the next edge from a stream, reading a batch of records when none are buffered -
+//when the sender goes away, the fifo is reopened (or the socket reconnected)
+static int
+serReadStream ( serDevT* dev )
+{
+	capRecordT	rec;
+	timeStampT	ts;
+	unsigned long	reads;
+	time_ns		now;
+	int		ret;
+
+	dev->streammore = 0;
+
+	if ( dev->capin == NULL )
+	{
+		gettime_ns ( now );
+		if ( now < dev->pollnext )
+			return 0;
+
+		dev->syscalls += 2;	//socket() and connect(), or open()
+		if ( serOpenStream ( dev ) < 0 )
+		{
+			serCloseStream ( dev );
+			return 0;
+		}
+		loggerf ( LOGGER_INFO, "%s: stream connected\n", dev->dev );
+	}
+
+	reads = dev->capin->reads;
+
+	while ( (ret = capRead ( dev->capin, &rec )) > 0 )
+	{
+		if ( rec.type != CAP_REC_EDGE )
+			continue;
+
+		if ( !serApplyEdgeRecord ( dev, &rec, &dev->streamlines, &dev->streamcounts ) )
+			continue;
+
+		dev->syscalls += dev->capin->reads - reads;
+		dev->streammore = capPending ( dev->capin );
+
+		//the sender might not have both clocks - or either of them
+		ts = rec.time;
+		if ( ts.real == 0 && ts.mono == 0 )
+			timeGetStamp ( &ts );
+		else if ( ts.mono == 0 )
+			timeStampFromReal ( &ts, rec.time.real );
+		else if ( ts.real == 0 )
+			timeStampFromMono ( &ts, rec.time.mono );
+		ts.err = rec.time.err;
+
+		return serStoreDevStatusLines ( dev, dev->streamlines, &dev->streamcounts, &ts );
+	}
+
+	dev->syscalls += dev->capin->reads - reads;
+
+	if ( ret < 0 && errno == EAGAIN )
+		return 0;
+
+	if ( ret < 0 && errno == EINVAL )
+		loggerf ( LOGGER_NOTE, "Error: %s: bad record in stream - reconnecting\n", dev->dev );
+	else
+		loggerf ( LOGGER_INFO, "%s: stream closed - reconnecting\n", dev->dev );
+
+	//(a fifo can be reopened straight away - it waits for the next writer)
+	serCloseStream ( dev );
+	if ( !dev->streamsock && serOpenStream ( dev ) < 0 )
+		serCloseStream ( dev );
+
+	return -1;
+}
+
+//audio or iq: read the next block of samples - returns the edges found (or -1 at the end),
+//with the input's sample and read() counts so far
+static int
+serReadSamples ( serDevT* dev, audioEdgeT* edges, unsigned long long* frames, unsigned long* reads )
+{
+	int	n;
+
+	if ( dev->iq != NULL )
+	{
+		n = iqRead ( dev->iq, edges, SER_AUDIO_MAX_EDGES );
+		*frames = dev->iq->frames;
+		*reads = dev->iq->reads;
+	}
+	else
+	{
+		n = audioRead ( dev->audio, edges, SER_AUDIO_MAX_EDGES );
+		*frames = dev->audio->frames;
+		*reads = dev->audio->reads;
+	}
+
+	return n;
+}
+
+//when sample pos (in input samples) was taken - for a file, from when it was opened, live, from
+//the anchor (see serAudioThread())
+static void
+serSampleTime ( serDevT* dev, double pos, time_f period, const timeStampT* start, time_ns anchor,
+	const timeStampT* now, time_ns lag, timeStampT* ts )
+{
+	time_ns	offset;
+
+	offset = time_f2time_ns ( pos * period );
+
+	if ( dev->offline )
+	{
+		ts->mono = start->mono + offset;
+		ts->real = start->real + offset;
+		ts->err = period;
+	}
+	else
+	{
+		ts->mono = anchor + offset;
+		ts->real = ts->mono + (now->real - now->mono);
+		ts->err = period + time_ns2time_f ( lag );
+	}
+}
+
+//the waiter thread for audio and iq: read the samples, and pass the edges the detectors find
+//(and any phase modulation seconds) to the main loop - closes the pipe at the end of the input
+static void*
+serAudioThread ( void* arg )
+{
+	serDevT*	dev = arg;
+	audioEdgeT	edges[SER_AUDIO_MAX_EDGES];
+	serLineT*	line;
+	serEventT	ev, pmev;
+	timeStampT	start, now;
+	time_ns		base, anchor, lag, lastread;
+	time_f		period;
+	unsigned long long	frames;
+	unsigned long	reads, lastreads;
+	int		n, i;
+
+	memset ( &ev, 0, sizeof(ev) );
+
+	period = 1.0 / ( dev->iq != NULL ? dev->iq->rate : dev->audio->rate );
+	timeGetStamp ( &start );
+	now = start;
+	anchor = 0;
+	lag = 0;
+	lastread = 0;
+	frames = 0;
+	lastreads = dev->iq != NULL ? dev->iq->reads : dev->audio->reads;
+
+	while ( (n = serReadSamples ( dev, edges, &frames, &reads )) >= 0 )
+	{
+		//live audio: when the sound card took the first sample, going by when each read
+		//returns. that's late by however long the samples sat in buffers, so the earliest
+		//is kept - allowed to creep later, in case the sound card's clock is slower than ours
+		if ( !dev->offline )
+		{
+			timeGetStamp ( &now );
+			base = now.mono - time_f2time_ns ( frames * period );
+
+			if ( anchor == 0 )
+				anchor = base;
+			else
+				anchor += (time_ns)((now.mono - lastread) * SER_AUDIO_SLEW);
+			if ( base < anchor )
+				anchor = base;
+
+			//(how late the reads are, on average - the anchor could be out by as much)
+			lag += ( (base - anchor) - lag ) / 16;
+			lastread = now.mono;
+		}
+
+		for ( i=0; i<n; i++ )
+		{
+			for ( line = serLineHead; line != NULL; line = line->next )
+			{
+				if ( line->dev == dev && line->id == edges[i].channel )
+					break;
+			}
+			if ( line == NULL )
+				continue;
+
+			if ( edges[i].level )
+				ev.lines |= line->line;
+			else
+				ev.lines &= ~line->line;
+
+			serSampleTime ( dev, edges[i].pos, period, &start, anchor, &now, lag, &ev.time );
+
+			ev.syscalls = reads - lastreads + 1;	//(and the write())
+			lastreads = reads;
+
+			if ( write ( dev->evpipe[1], &ev, sizeof(ev) ) != sizeof(ev) )
+				loggerf ( LOGGER_NOTE, "Error: failed to pass audio edge to main loop\n" );
+		}
+
+		for ( i=0; dev->iq != NULL && i<dev->iq->numpm; i++ )
+		{
+			for ( line = serLineHead; line != NULL; line = line->next )
+			{
+				if ( line->dev == dev && line->id == dev->iq->pm[i].channel )
+					break;
+			}
+			if ( line == NULL )
+				continue;
+
+			memset ( &pmev, 0, sizeof(pmev) );
+			pmev.pmline = line->line;
+			pmev.pmbit = dev->iq->pm[i].bit;
+			serSampleTime ( dev, dev->iq->pm[i].pos, period, &start, anchor, &now, lag, &pmev.time );
+			pmev.syscalls = 1;
+
+			if ( write ( dev->evpipe[1], &pmev, sizeof(pmev) ) != sizeof(pmev) )
+				loggerf ( LOGGER_NOTE, "Error: failed to pass phase modulation second to main loop\n" );
+		}
+	}
+
+	loggerf ( LOGGER_INFO, "%s: %s input ended after %.0f seconds\n", dev->dev,
+		dev->iq != NULL ? "iq" : "audio", frames * period );
+
+	close ( dev->evpipe[1] );
+
+	return NULL;
+}
+
+int
+serStartDev ( serDevT* dev )
+{
+	dev->evpipe[0] = -1;
+	dev->evpipe[1] = -1;
+	dev->timerfd = -1;
+	dev->lastchange = time(NULL);
+
+	switch ( dev->mode )
+	{
+	case SERPORT_MODE_POLL:
+#ifdef ENABLE_TIMERFD
+		dev->timerfd = timerfd_create ( CLOCK_MONOTONIC, TFD_NONBLOCK );
+		if ( dev->timerfd < 0 )
+			loggerf ( LOGGER_INFO, "%s: no timerfd - sampling with millisecond resolution\n", dev->dev );
+#endif
+		pollSchedInit ( &dev->pollsched );
+		dev->pollnext = 0;
+		serPollArm ( dev, 0 );
+		return 0;
+
+	case SERPORT_MODE_GPIO:
+	case SERPORT_MODE_GPIOCDEV:
+	case SERPORT_MODE_STREAM:
+		//handled directly by the main loop
+		return 0;
+	}
+
+	if ( pipe ( dev->evpipe ) != 0 )
+	{
+		loggerf ( LOGGER_NOTE, "Error: pipe() failed for %s\n", dev->dev );
+		return -1;
+	}
+
+	if ( pthread_create ( &dev->thread, NULL,
+		dev->mode == SERPORT_MODE_REPLAY ? serReplayThread
+		: dev->mode == SERPORT_MODE_AUDIO || dev->mode == SERPORT_MODE_IQ ? serAudioThread : serWaitThread, dev ) != 0 )
+	{
+		loggerf ( LOGGER_NOTE, "Error: failed to start waiter thread for %s\n", dev->dev );
+		close ( dev->evpipe[0] );
+		close ( dev->evpipe[1] );
+		dev->evpipe[0] = -1;
+		dev->evpipe[1] = -1;
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+serGetPollFd ( serDevT* dev, struct pollfd* pfd )
+{
+	pfd->fd = -1;
+	pfd->events = 0;
+	pfd->revents = 0;
+
+	switch ( dev->mode )
+	{
+	case SERPORT_MODE_POLL:
+		if ( dev->timerfd < 0 )
+			return -1;
+
+		pfd->fd = dev->timerfd;
+		pfd->events = POLLIN;
+		return 0;
+
+	case SERPORT_MODE_GPIO:
+		//sysfs gpio value files signal an edge as an exceptional condition
+		pfd->fd = dev->fd;
+		pfd->events = POLLPRI | POLLERR;
+		return 0;
+
+	case SERPORT_MODE_GPIOCDEV:
+		pfd->fd = dev->fd;
+		pfd->events = POLLIN;
+		return 0;
+
+	case SERPORT_MODE_STREAM:
+		//(while disconnected, the main loop comes back when it's time to retry)
+		if ( dev->fd < 0 )
+			return -1;
+
+		pfd->fd = dev->fd;
+		pfd->events = POLLIN;
+		return 0;
+	}
+
+	pfd->fd = dev->evpipe[0];
+	pfd->events = POLLIN;
+	return 0;
+}
+
+//a phase modulation second from the iq waiter thread - returns 1 if it's for a line
+static int
+serStorePMSecond ( serDevT* dev, const serEventT* ev )
+{
+	serLineT*	line;
+
+	for ( line = serLineHead; line != NULL; line = line->next )
+	{
+		if ( line->dev == dev && line->line == ev->pmline )
+		{
+			line->pmsecond = 1;
+			line->pmtime = ev->time;
+			line->pmbit = ev->pmbit;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+int
+serReadDevChange ( serDevT* dev )
+{
+	serEventT	ev;
+	int	ret;
+	timeStampT	now;
+	time_f	latency;
+
+	switch ( dev->mode )
+	{
+	case SERPORT_MODE_POLL:
+#ifdef ENABLE_TIMERFD
+		if ( dev->timerfd >= 0 )
+		{
+			uint64_t	expirations;
+
+			//(nonblocking - just clear the expiry count)
+			dev->syscalls++;
+			if ( read ( dev->timerfd, &expirations, sizeof(expirations) ) < 0 && errno != EAGAIN )
+				return -1;
+		}
+#endif
+		dev->syscalls += 1 + dev->icountok;
+		ret = serGetDevStatusLines ( dev );
+
+		if ( ret > 0 )
+			pollSchedEdge ( &dev->pollsched, dev->eventtime.real );
+		serPollSchedule ( dev, dev->lastsample.real );
+		break;
+
+	case SERPORT_MODE_GPIO:
+		dev->syscalls += 2;	//lseek() and read()
+		ret = serGetDevStatusLines ( dev );
+		break;
+
+#ifdef ENABLE_GPIOCDEV
+	case SERPORT_MODE_GPIOCDEV:
+		ret = serReadGpioEvent ( dev );
+		break;
+#endif
+
+	case SERPORT_MODE_STREAM:
+		ret = serReadStream ( dev );
+		break;
+
+	default:
+		ret = read ( dev->evpipe[0], &ev, sizeof(ev) );
+		if ( ret == 0 )
+			dev->ended = 1;
+		if ( ret != sizeof(ev) )
+			return -1;
+
+		dev->syscalls += ev.syscalls + 1;
+
+		//(a phase modulation second isn't a line change - it's for the clocks, but isn't
+		//counted, and it's found a second or so after it started)
+		if ( ev.pmline != 0 )
+			return serStorePMSecond ( dev, &ev );
+
+		ret = serStoreDevStatusLines ( dev, ev.lines, &ev.counts, &ev.time );
+		break;
+	}
+
+	if ( ret > 0 && !dev->offline )
+	{
+		//(clock_gettime() doesn't enter the kernel on linux)
+		timeGetStamp ( &now );
+		latency = time_ns2time_f ( now.mono - dev->eventtime.mono );
+
+		dev->latencysum += latency;
+		if ( latency > dev->latencymax )
+			dev->latencymax = latency;
+	}
+
+	if ( ret > 0 )
+	{
+
+		dev->changes++;
+		dev->lastchange = time(NULL);
+	}
+
+	return ret;
+}
+
+int
+serDevPending ( serDevT* dev )
+{
+#ifdef ENABLE_GPIOCDEV
+	if ( dev->mode == SERPORT_MODE_GPIOCDEV )
+		return dev->gpioevpos < dev->gpioevcount;
+#endif
+
+	if ( dev->mode == SERPORT_MODE_STREAM )
+		return dev->streammore;
+
+	return 0;
+}
+
+
+//wait for a modem line change on an iwait or timepps device.
+//this blocks, so it is only called from the device's waiter thread - it
+//mustn't touch anything the main loop uses, the changes are returned in ev
+int
+serWaitForSerialChange ( serDevT* dev, serEventT* ev )
+{
+#ifdef ENABLE_TIOCMIWAIT
+	timeStampT	before, after;
+#endif
+#ifdef ENABLE_TIMEPPS
+	int	i, n;
+	struct timespec timeout;
+#endif
+
+	if ( dev->modemlines == 0 )
+		return -1;
+
+	switch ( dev->mode )
+	{
+#ifdef ENABLE_TIOCMIWAIT
+	case SERPORT_MODE_IWAIT:
+		//no alarm() timeout here - the alarm is shared by the whole process,
+		//so it can't be used from several waiter threads at once
+		//two calls per change: the wait, and reading which lines changed
+		//(TIOCMIWAIT doesn't say which of the lines it woke up for)
+		if ( ioctl ( dev->fd, TIOCMIWAIT, dev->modemlines) != 0 )
+			return -1;
+
+		memset ( ev, 0, sizeof(*ev) );
+		ev->syscalls = 2;
+
+		//the counts are read before the lines: an edge in between shows up in the
+		//lines first, which serStoreDevStatusLines() allows for
+		ev->counts.valid = 0;
+#ifdef ENABLE_TIOCGICOUNT
+		serReadCounts ( dev, &ev->counts );
+		if ( dev->icountok )
+			ev->syscalls++;
+#endif
+
+		//bracket the status read - if we get preempted here, the error shows it
+		timeGetStamp ( &before );
+		if ( ioctl ( dev->fd, TIOCMGET, &ev->lines ) != 0 )
+			return -1;
+		timeGetStamp ( &after );
+
+		timeBracketStamp ( &ev->time, &before, &after );
+
+		return 1;
+		break;
+#endif
+
+#ifdef ENABLE_TIMEPPS
+	case SERPORT_MODE_TIMEPPS:
+		if ( dev->ppscanwait )
+		{
+			//block in the kernel until the next assert or clear (or 10s)
+			timeout.tv_sec = 10;
+			timeout.tv_nsec = 0;
+
+			n = serFetchPPS ( dev, ev, &timeout );
+			if ( n > 0 )
+			{
+				ev[0].syscalls = 1;
+				return n;
+			}
+			if ( n == 0 || errno == ETIMEDOUT || errno == EINTR )
+				return -1;
+
+			if ( errno != EOPNOTSUPP && errno != EINVAL )
+			{
+				loggerf ( LOGGER_NOTE, "ppsfetch failed: %d\n", errno );
+				return -1;
+			}
+
+			loggerf ( LOGGER_INFO, "%s: pps can't wait for events - polling instead\n", dev->dev );
+			dev->ppscanwait = 0;
+		}
+
+		//no blocking fetch - poll at 100Hz
+		timeout.tv_sec = 0;
+		timeout.tv_nsec = 0;
+
+		for ( i=0; i<10*100; i++ )
+		{
+			n = serFetchPPS ( dev, ev, &timeout );
+			if ( n < 0 )
+			{
+				loggerf ( LOGGER_NOTE, "ppsfetch failed: %d\n", errno );
+				return -1;
+			}
+			if ( n > 0 )
+			{
+				ev[0].syscalls = 2*i + 1;	//the fetches, and the sleeps between them
+				return n;
+			}
+
+			usleep ( 10000 );
+		}
+
+		errno = ETIMEDOUT;
+		return -1;
+		break;
+#endif
+
+	}
+
+	loggerf ( LOGGER_NOTE, "Error: serWaitForSerialChange(): mode not supported\n" );
+
+	//unknown serial port mode !!
+	return -1;
+
+}
+
+int
+serGetDevStatusLines ( serDevT* dev )
+{
+	int	lines;
+	timeStampT	before, after, ts;
+	serCountT	counts;
+
+	counts.valid = 0;
+#ifdef ENABLE_TIOCGICOUNT
+	if ( dev->mode == SERPORT_MODE_POLL )
+		serReadCounts ( dev, &counts );
+#endif
+
+	timeGetStamp ( &before );
+
+#ifdef ENABLE_GPIO
+	char    buf[8];
+	if (dev->mode == SERPORT_MODE_GPIO) {
+		if (lseek(dev->fd, SEEK_SET, 0) == -1)
+			return -1;
+		if (read(dev->fd, buf, sizeof(buf)) <= 0)
+			return -1;
+
+		if (buf[0] == '1')
+			lines = TIOCM_CD;
+		else
+			lines = 0;
+	}
+	else
+#endif
+	if ( ioctl ( dev->fd, TIOCMGET, &lines ) != 0 )
+		return -1;
+
+	timeGetStamp ( &after );
+
+	//when polling, the edge could have been any time since the last read
+	if ( dev->mode == SERPORT_MODE_POLL && dev->lastsample.mono != 0 )
+		timeBracketStamp ( &ts, &dev->lastsample, &after );
+	else
+		timeBracketStamp ( &ts, &before, &after );
+
+	dev->lastsample = before;
+
+	return serStoreDevStatusLines ( dev, lines, &counts, &ts );
+}
+
+//update the device's lines from the last read - debounced per line, and with the
+//edge counts (if any) checked for edges that were missed
+static int
+serUpdateLinesForDevice ( serDevT* dev )
+{
+	serLineT*	line;
+	int		level, bit, changed, numchanged;
+	unsigned int	accounted;
+	time_f		diff;
+
+	numchanged = 0;
+
+	for ( line = serGetLine ( NULL );  line != NULL; line = serGetLine ( line ) )
+	{
+		//skip lines not on this device...
+		if ( line->dev != dev )
+			continue;
+
+		level = dev->curlines & line->line;
+		changed = ( (level != 0) != (line->rawstate != 0) );
+		line->rawstate = level;
+
+		//any edges the kernel counted beyond the change we saw were lost - two edges too
+		//close together to be read separately. (the count may also be behind by the
+		//change we saw, when it came between reading the counts and the lines)
+		line->lostedges = 0;
+		if ( dev->counts.valid & line->line )
+		{
+			bit = serLineBit ( line->line );
+			accounted = line->edgecount + changed;
+
+			if ( !line->counted )
+			{
+				line->counted = 1;
+				line->edgecount = dev->counts.count[bit];
+			}
+			else if ( (int)(dev->counts.count[bit] - accounted) > 0 )
+			{
+				line->lostedges = dev->counts.count[bit] - accounted;
+				line->edgecount = dev->counts.count[bit];
+			}
+			else
+				line->edgecount = accounted;
+		}
+
+		//every raw edge goes in the capture (if there is one) - before the debouncing
+		if ( changed || line->lostedges )
+			capEdge ( dev->dev, dev->mode, line->id, level != 0, line->lostedges, &dev->eventtime );
+
+		if ( line->lostedges )
+		{
+			loggerf ( LOGGER_DEBUG, "%s: %d edges lost on line 0x%x\n", dev->dev, line->lostedges, line->line );
+			dev->lostedges += line->lostedges;
+
+			//(the clocks work out what the lost edges mean - line->eventtime stays the last good edge)
+			line->curstate = level;
+			line->changed = 1;
+			numchanged++;
+			continue;
+		}
+
+		if ( (level != 0) == (line->curstate != 0) )
+			continue;
+
+		//debounce each line on its own, so an edge on one line doesn't hide another's
+		diff = time_ns2time_f ( dev->eventtime.mono - line->eventtime.mono );
+		if ( diff < 0.05 )
+		{
+			loggerf ( LOGGER_DEBUG, "serUpdateLinesForDevice: pulse too short %f, filtering!\n", diff );
+			continue;
+		}
+
+		line->curstate = level;
+		line->eventtime = dev->eventtime;
+		line->changed = 1;
+		numchanged++;
+	}
+
+	return numchanged;
+}
+
+int
+serStoreDevStatusLines ( serDevT* dev, int lines, const serCountT* counts, const timeStampT* ts )
+{
+	dev->prevlines = dev->curlines;
+	dev->curlines = lines;
+	dev->eventtime = *ts;
+
+	if ( counts != NULL )
+		dev->counts = *counts;
+	else
+		dev->counts.valid = 0;
+
+	return serUpdateLinesForDevice ( dev ) > 0;
+}
@@ -3,13 +3,28 @@
 
 #include "systime.h"
 #include <sys/ioctl.h>
+#include <poll.h>
+#include <pthread.h>
 
 #include "timef.h"
+#include "capture.h"
+#include "audio.h"
+#include "iq.h"
+#include "pollsched.h"
 
 #ifdef ENABLE_TIMEPPS
 #include <sys/timepps.h>
 #endif
 
+#ifdef ENABLE_GPIOCDEV
+#include <linux/gpio.h>
+
+//lines per gpio chip (each gets one bit in modemlines)
+#define	SER_GPIO_MAX_LINES	(16)
+//line events read from the kernel in one go
+#define	SER_GPIO_MAX_EVENTS	(16)
+#endif
+
 
 //a serial device (serDevT) is an individual serial port, with several status control lines
 //a modem status line (serLineT) is an individual status line on a serial port
@@ -17,6 +32,29 @@
 typedef struct serDevS serDevT;
 typedef struct serLineS serLineT;
 
+//edge counts from the kernel for each line - count[n] is for line bit n, valid has
+//the line bits that have a count (TIOCGICOUNT, gpio line sequence numbers, pps sequences)
+//so edges that weren't seen separately can be found
+#define	SER_MAX_LINE_BITS	(16)
+typedef struct
+{
+	int		valid;
+	unsigned int	count[SER_MAX_LINE_BITS];
+} serCountT;
+
+//a modem line change, as passed from a device's waiter thread to the main loop
+typedef struct
+{
+	int		lines;
+	serCountT	counts;
+	timeStampT	time;
+	int		syscalls;	//system calls the waiter thread made to get this change
+	//or, instead of a change, a DCF77 phase modulation second on this line bit (iq only -
+	//time is when the second started)
+	int		pmline;
+	int		pmbit;
+} serEventT;
+
 struct serDevS
 {
 	serDevT*	next;
@@ -28,9 +66,15 @@ struct serDevS
 #define	SERPORT_MODE_POLL	(2)
 #define	SERPORT_MODE_TIMEPPS	(3)
 #define SERPORT_MODE_GPIO       (4)
+#define	SERPORT_MODE_GPIOCDEV	(5)
+#define	SERPORT_MODE_REPLAY	(6)
+#define	SERPORT_MODE_STREAM	(7)
+#define	SERPORT_MODE_AUDIO	(8)
+#define	SERPORT_MODE_IQ		(9)
 	int		mode;
 
 	//which modem status lines to check - some of TIOCM_{RNG|DSR|CD|CTS}
+	//(for gpio chardevs, bit n is the line gpiooffsets[n])
 	int		modemlines;
 
 	//-- runtime data
@@ -39,14 +83,65 @@ struct serDevS
 	int		fd;
 #ifdef ENABLE_TIMEPPS
 	pps_handle_t	ppshandle;
-	int		ppslastassert;
-	int		ppslastclear;
+	pps_seq_t	ppslastassert;
+	pps_seq_t	ppslastclear;
+	int		ppscanwait;	//time_pps_fetch() can block until the next event
+#endif
+#ifdef ENABLE_GPIOCDEV
+	int		gpiooffsets[SER_GPIO_MAX_LINES];
+	int		gpionumlines;
+	int		gpiolines;	//raw line levels, updated from the edge events
+	struct gpio_v2_line_event	gpioevents[SER_GPIO_MAX_EVENTS];
+	int		gpioevcount;
+	int		gpioevpos;
+	unsigned int	gpiolastseqno;
 #endif
 
+	//modes that can't be waited on with poll() (iwait, timepps) get a waiter thread,
+	//which passes serEventT records back to the main loop through evpipe
+	int		evpipe[2];
+	pthread_t	thread;
+
+	//poll mode: the lines are only sampled densely in a window around the next expected edge
+	pollSchedT	pollsched;
+	time_ns		pollnext;	//when to sample next
+	time_ns		pollwindowend;	//end of the dense window we're in, 0 if outside one
+	int		timerfd;	//-1 without timerfd - the main loop uses serPollTimeout()
+	int		timerperiodic;
+	timeStampT	lastsample;	//when the lines were last read - an edge seen now happened since then
+
+	//replaying a capture (see serSetReplay()) - read by the waiter thread -
+	//or reading an edge stream (a fifo or unix socket) from the main loop
+	capReaderT*	capin;
+	int		ended;		//the replay has finished - no more changes will come
+	int		streamsock;	//the stream is a socket we connect to, not a fifo
+	int		streamlines;	//line levels, and edge counts, from the stream's records
+	serCountT	streamcounts;
+	int		streammore;	//more records buffered - serReadDevChange() again
+
+	//audio input (a wav file, fifo or pipe) - read, and its edges detected, by the waiter thread
+	audioInT*	audio;
+	//raw iq samples from an sdr - the same, with a detector per carrier
+	iqInT*		iq;
+
+	int		offline;	//a replay, wav or iq file - the edge times aren't now
+
 	//the current and previous modem lines active - some of modemlines
 	int		curlines;
 	int		prevlines;
-	time_f		eventtime;
+	serCountT	counts;		//edge counts read with curlines
+	timeStampT	eventtime;
+
+	int		icountok;	//TIOCGICOUNT works on this port
+
+	//statistics, for the periodic status report
+	unsigned long	wakeups;	//times the main loop looked at this device
+	unsigned long	changes;	//modem line changes passed on to the clocks
+	unsigned long	syscalls;	//system calls made reading them (not counting the main loop's poll())
+	time_f		latencysum;	//from the edge timestamp to handing the change to the clocks
+	time_f		latencymax;
+	time_t		lastchange;	//for the "no serial line change" watchdog
+	unsigned long	lostedges;	//edges the kernel counted that we didn't see
 
 };
 
@@ -55,15 +150,45 @@ struct serLineS
 	serLineT*	next;
 
 	//one of TIOCM_{RNG|DSR|CD|CTS}
+	//(for gpio chardevs and replays, a bit allocated for the line - id is the line given)
 	int		line;
+	int		id;
 	serDevT*	dev;
 
+	//debounced state, and when it last changed
 	int		curstate;
-	time_f		eventtime;
+	timeStampT	eventtime;
+
+	int		rawstate;	//as last read, before debouncing
+	int		changed;	//curstate changed (or edges were lost) - for the clocks
+
+	//edge accounting, when the device has counts for this line
+	int		counted;
+	unsigned int	edgecount;	//edges accounted for so far
+	int		lostedges;	//edges missed before this change
+
+	//iq: correlate the carrier's phase modulation too (DCF77) - the last second found,
+	//pmsecond set until the clocks have it
+	int		pm;
+	int		pmsecond;
+	timeStampT	pmtime;
+	int		pmbit;
 
 };
 
 int serInit (void);
+//the capture file that SERPORT_MODE_REPLAY devices read, and whether to replay it
+//at the speed it was captured (otherwise as fast as the clocks can take it)
+void serSetReplay ( char* file, int realtime );
+//whether SERPORT_MODE_AUDIO devices are wav files to read as fast as possible (offline),
+//or live audio from a sound card (eg. a fifo written by arecord)
+void serSetAudio ( int offline );
+//the sample rate and centre frequency (Hz) of SERPORT_MODE_IQ devices, and whether they're
+//files (offline) or live from an sdr (eg. a fifo written by rtl_sdr)
+void serSetIQ ( int rate, int centre, int offline );
+//line is one of TIOCM_{RNG|DSR|CD|CTS}, or the line offset on the chip for gpio chardevs
+//(replays and streams take either - it's matched against the line in the records -
+//for audio it's the channel, for iq the carrier frequency in Hz)
 serLineT* serAddLine ( char* dev, int line, int mode );
 
 //pass in NULL to get the first dev/line
@@ -74,12 +199,34 @@ serLineT* serGetLine ( serLineT* prev );
 
 
 int serInitHardware ( serDevT* dev );
-int serWaitForSerialChange ( serDevT* dev );
-
-int serGetDevStatusLines ( serDevT* dev, time_f timef );
-int serStoreDevStatusLines ( serDevT* dev, int lines, time_f time );
-
-int serUpdateLinesForDevice ( serDevT* dev );
+int serStartDev ( serDevT* dev );
+
+//fill in the pollfd the main loop should wait on for this device
+//returns -1 (and pfd->fd = -1) if the device has to be sampled on every pass instead (poll mode,
+//and streams waiting to reconnect) - a stream's fd changes when it reconnects
+int serGetPollFd ( serDevT* dev, struct pollfd* pfd );
+
+//read the pending change for a device after poll() - returns 1 if the modem lines changed (or a
+//line has a phase modulation second - serLineT.pmsecond)
+int serReadDevChange ( serDevT* dev );
+//poll mode without a timer fd: milliseconds until the device wants sampling again
+int serPollTimeout ( serDevT* dev );
+
+//returns 1 if there are more changes already read for this device (call serReadDevChange() again)
+int serDevPending ( serDevT* dev );
+
+//blocking wait for a change - used by the waiter threads
+//stores up to SER_MAX_WAIT_EVENTS changes in ev (in the order they happened)
+//and returns how many, or -1 on a timeout or error
+#define	SER_MAX_WAIT_EVENTS	(2)
+int serWaitForSerialChange ( serDevT* dev, serEventT* ev );
+
+//read the lines, stamping the time just before and after the read (in poll mode,
+//from the previous read) - the edge time is the middle, the interval its error
+int serGetDevStatusLines ( serDevT* dev );
+//store the lines read (counts may be NULL), and update the device's serLineT's -
+//returns the number of lines with a change for the clocks (serLineT.changed)
+int serStoreDevStatusLines ( serDevT* dev, int lines, const serCountT* counts, const timeStampT* ts );
 
 
 #endif
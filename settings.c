@@ -29,4 +29,6 @@
 
 int verboseLevel = 0;
 int debugLevel = 0;
+int voteMinutes = 10;
+int averageSeconds = 60;
 
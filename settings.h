@@ -9,5 +9,12 @@ extern int verboseLevel;
 
 extern int debugLevel;
 
+//minutes before that a minute is voted with, when it won't decode alone (see vote.h) - 0 for none
+extern int voteMinutes;
+
+//seconds of pps samples the pc clock's offset is averaged over (see clock.h) - the window grows to
+//this from the time's first decode
+extern int averageSeconds;
+
 
 #endif
@@ -50,25 +50,33 @@ shmCreate ( int unit )
 	return shm;
 }
 
+void
+shmFree ( shmTimeT* shm )
+{
+	shmdt ( shm );
+}
+
 
 void
-shmStore ( shmTimeT* volatile shm, time_f radioclock, time_f localrecv, time_f time_err, int leap )
+shmStore ( shmTimeT* volatile shm, time_ns radioclock, time_ns localrecv, time_f time_err, int leap )
 {
-	struct timeval radioclocktv,localrecvtv;
+	struct timespec radioclockts,localrecvts;
 
-	loggerf ( LOGGER_DEBUG, "shm: storing time "TIMEF_FORMAT" local "TIMEF_FORMAT" err "TIMEF_FORMAT" leap %d\n", radioclock, localrecv, time_err, leap );
+	loggerf ( LOGGER_DEBUG, "shm: storing time "TIMENS_FORMAT" local "TIMENS_FORMAT" err "TIMEF_FORMAT" leap %d\n", TIMENS_ARGS(radioclock), TIMENS_ARGS(localrecv), time_err, leap );
 
-	time_f2timeval ( radioclock, &radioclocktv );
-	time_f2timeval ( localrecv, &localrecvtv );
+	time_ns2timespec ( radioclock, &radioclockts );
+	time_ns2timespec ( localrecv, &localrecvts );
 
 	shm->valid = 0;
 
 	shm->mode = 1;
 	shm->count++;
-	shm->clockTimeStampSec = radioclocktv.tv_sec;
-	shm->clockTimeStampUSec = radioclocktv.tv_usec;
-	shm->receiveTimeStampSec = localrecvtv.tv_sec;
-	shm->receiveTimeStampUSec = localrecvtv.tv_usec;
+	shm->clockTimeStampSec = radioclockts.tv_sec;
+	shm->clockTimeStampUSec = radioclockts.tv_nsec / 1000;
+	shm->clockTimeStampNSec = radioclockts.tv_nsec;
+	shm->receiveTimeStampSec = localrecvts.tv_sec;
+	shm->receiveTimeStampUSec = localrecvts.tv_nsec / 1000;
+	shm->receiveTimeStampNSec = localrecvts.tv_nsec;
 	shm->leap = leap;
 	shm->precision = log(time_err)/log(2);
 	shm->count++;
@@ -86,8 +94,10 @@ shmCheckNoStore ( shmTimeT* volatile shm )
 	shm->count++;
 	shm->clockTimeStampSec = 0;
 	shm->clockTimeStampUSec = 0;
+	shm->clockTimeStampNSec = 0;
 	shm->receiveTimeStampSec = 0;
 	shm->receiveTimeStampUSec = 0;
+	shm->receiveTimeStampNSec = 0;
 	shm->leap = LEAP_NOTINSYNC;
 	shm->precision = 0;
 	shm->count++;
@@ -16,7 +16,9 @@ typedef struct {
 	int     precision;
 	int     nsamples;
 	int     valid;
-	int     dummy[10];
+	unsigned clockTimeStampNSec;	//(newer ntpd and chrony use these when set)
+	unsigned receiveTimeStampNSec;
+	int     dummy[8];
 } shmTimeT;
 
 
@@ -28,7 +30,9 @@ typedef struct {
 
 
 shmTimeT* shmCreate ( int unit );
-void shmStore ( shmTimeT* volatile shm, time_f radioclock, time_f localrecv, time_f time_err, int leap );
+//detach it (the segment stays, for ntpd)
+void shmFree ( shmTimeT* shm );
+void shmStore ( shmTimeT* volatile shm, time_ns radioclock, time_ns localrecv, time_f time_err, int leap );
 void shmCheckNoStore ( shmTimeT* volatile shm );
 
 
@@ -0,0 +1,394 @@
+/*
+ * Copyright (c) 2002 Jon Atkins http://www.jonatkins.com/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "config.h"
+
+#include <string.h>
+#include <math.h>
+#include "systime.h"
+
+#include "synth.h"
+#include "clock.h"
+#include "utctime.h"
+
+
+//---- frame encoding
+
+//the european (and uk) summer time rule - from 01:00 utc on the last sunday in march
+//until 01:00 utc on the last sunday in october
+static time_t
+synthLastSunday ( int year, int mon )
+{
+	struct tm	tm;
+	time_t		t;
+
+	memset ( &tm, 0, sizeof(tm) );
+	tm.tm_year = year - 1900;
+	tm.tm_mon = mon;
+	tm.tm_mday = 31;	//(both march and october have 31 days)
+	tm.tm_hour = 1;
+
+	t = UTCtime ( &tm );
+	gmtime_r ( &t, &tm );
+
+	return t - tm.tm_wday * 24*60*60;
+}
+
+static int
+synthSummerTime ( time_t t )
+{
+	struct tm	tm;
+
+	gmtime_r ( &t, &tm );
+
+	return t >= synthLastSunday ( tm.tm_year + 1900, 2 ) && t < synthLastSunday ( tm.tm_year + 1900, 9 );
+}
+
+//set the bits bit..bit+count-1 to val, with the given weights (a weight of 0 is an unused bit)
+//returns the number of bits set, for the parity
+static int
+synthSetBCD ( int* bits, int bit, int count, const int* weights, int val )
+{
+	int	i, n, ones;
+
+	ones = 0;
+	for ( n=0; n<count; n++ )
+	{
+		//(biggest weight first - dcf77 sends the bits the other way round)
+		i = ( weights[0] < weights[count-1] ) ? count-1-n : n;
+
+		if ( weights[i] != 0 && val >= weights[i] )
+		{
+			val -= weights[i];
+			bits[bit+i] = 1;
+			ones++;
+		}
+	}
+
+	return ones;
+}
+
+static void
+synthSetLow ( synthSecondT* sec, time_f start, time_f end )
+{
+	sec->low[sec->numlows][0] = start;
+	sec->low[sec->numlows][1] = end;
+	sec->numlows++;
+}
+
+//DCF77: a 100ms (0) or 200ms (1) reduction at the start of each second, none in second 59.
+//the frame carries the (german) time of the next minute
+static void
+synthEncodeDCF77 ( time_t minute, synthSecondT* frame )
+{
+	static const int	bcd[8] = { 1, 2, 4, 8, 10, 20, 40, 80 };
+	int		bits[60];
+	int		summer, p, s;
+	struct tm	tm;
+	time_t		t;
+
+	memset ( bits, 0, sizeof(bits) );
+
+	t = minute + 60;
+	summer = synthSummerTime ( t );
+	t += summer ? 2*60*60 : 1*60*60;
+	gmtime_r ( &t, &tm );
+
+	bits[17] = summer;
+	bits[18] = !summer;
+	bits[20] = 1;
+
+	//(even parity)
+	bits[28] = synthSetBCD ( bits, 21, 7, bcd, tm.tm_min ) & 1;
+	bits[35] = synthSetBCD ( bits, 29, 6, bcd, tm.tm_hour ) & 1;
+	p = synthSetBCD ( bits, 36, 6, bcd, tm.tm_mday );
+	p += synthSetBCD ( bits, 42, 3, bcd, tm.tm_wday == 0 ? 7 : tm.tm_wday );
+	p += synthSetBCD ( bits, 45, 5, bcd, tm.tm_mon + 1 );
+	p += synthSetBCD ( bits, 50, 8, bcd, tm.tm_year % 100 );
+	bits[58] = p & 1;
+
+	for ( s=0; s<59; s++ )
+		synthSetLow ( &frame[s], 0.0, bits[s] ? 0.2 : 0.1 );
+}
+
+//MSF: second 0 is a 500ms reduction. the others are 100ms, then bit A for 100ms, then
+//bit B for 100ms - so A=0 B=1 is two reductions. the frame carries the (uk) time of the
+//next minute, the B bits have its odd parity
+static void
+synthEncodeMSF ( time_t minute, synthSecondT* frame )
+{
+	static const int	bcd8[8] = { 80, 40, 20, 10, 8, 4, 2, 1 };
+	int		a[60], b[60];
+	int		summer, p, s;
+	struct tm	tm;
+	time_t		t;
+
+	memset ( a, 0, sizeof(a) );
+	memset ( b, 0, sizeof(b) );
+
+	t = minute + 60;
+	summer = synthSummerTime ( t );
+	t += summer ? 1*60*60 : 0;
+	gmtime_r ( &t, &tm );
+
+	b[54] = !( synthSetBCD ( a, 17, 8, bcd8, tm.tm_year % 100 ) & 1 );
+	p = synthSetBCD ( a, 25, 5, bcd8+3, tm.tm_mon + 1 );
+	p += synthSetBCD ( a, 30, 6, bcd8+2, tm.tm_mday );
+	b[55] = !(p & 1);
+	b[56] = !( synthSetBCD ( a, 36, 3, bcd8+5, tm.tm_wday ) & 1 );
+	p = synthSetBCD ( a, 39, 6, bcd8+2, tm.tm_hour );
+	p += synthSetBCD ( a, 45, 7, bcd8+1, tm.tm_min );
+	b[57] = !(p & 1);
+	b[58] = summer;
+
+	//the minute identifier 01111110
+	for ( s=53; s<=58; s++ )
+		a[s] = 1;
+
+	synthSetLow ( &frame[0], 0.0, 0.5 );
+
+	for ( s=1; s<60; s++ )
+	{
+		if ( !a[s] && b[s] )
+		{
+			synthSetLow ( &frame[s], 0.0, 0.1 );
+			synthSetLow ( &frame[s], 0.2, 0.3 );
+		}
+		else
+			synthSetLow ( &frame[s], 0.0, b[s] ? 0.3 : a[s] ? 0.2 : 0.1 );
+	}
+}
+
+//WWVB: 200ms (0), 500ms (1) or 800ms (marker) reductions. markers at 0, 9, 19 .. 59,
+//so the minute starts after two markers. the frame carries the utc time of this minute
+static void
+synthEncodeWWVB ( time_t minute, synthSecondT* frame )
+{
+	static const int	bcd[12] = { 200, 100, 0, 80, 40, 20, 10, 0, 8, 4, 2, 1 };
+	int		bits[60];
+	int		s, year;
+	struct tm	tm;
+
+	memset ( bits, 0, sizeof(bits) );
+
+	gmtime_r ( &minute, &tm );
+
+	synthSetBCD ( bits, 1, 8, bcd+4, tm.tm_min );
+	synthSetBCD ( bits, 12, 7, bcd+5, tm.tm_hour );
+	synthSetBCD ( bits, 22, 12, bcd, tm.tm_yday + 1 );
+	synthSetBCD ( bits, 45, 4, bcd+3, tm.tm_year % 100 / 10 * 10 );
+	synthSetBCD ( bits, 50, 4, bcd+8, tm.tm_year % 10 );
+
+	year = tm.tm_year + 1900;
+	bits[55] = ( year % 4 == 0 && (year % 100 != 0 || year % 400 == 0) );
+
+	for ( s=0; s<60; s++ )
+	{
+		if ( s == 0 || s % 10 == 9 )
+			synthSetLow ( &frame[s], 0.0, 0.8 );
+		else
+			synthSetLow ( &frame[s], 0.0, bits[s] ? 0.5 : 0.2 );
+	}
+}
+
+void
+synthEncodeMinute ( int clocktype, time_t minute, synthSecondT* frame )
+{
+	memset ( frame, 0, 60 * sizeof(synthSecondT) );
+
+	switch ( clocktype )
+	{
+	case CLOCKTYPE_DCF77:
+		synthEncodeDCF77 ( minute, frame );
+		break;
+	case CLOCKTYPE_MSF:
+		synthEncodeMSF ( minute, frame );
+		break;
+	case CLOCKTYPE_WWVB:
+		synthEncodeWWVB ( minute, frame );
+		break;
+	}
+}
+
+
+//---- the noisy receiver
+
+//(xorshift - the same sequence everywhere, so runs can be compared)
+static time_f
+synthRandom ( synthT* syn )
+{
+	syn->rng ^= syn->rng << 13;
+	syn->rng ^= syn->rng >> 17;
+	syn->rng ^= syn->rng << 5;
+
+	return (syn->rng >> 8) / (time_f)(1 << 24);
+}
+
+static time_f
+synthGauss ( synthT* syn )
+{
+	time_f	u;
+
+	do
+		u = synthRandom ( syn );
+	while ( u <= 0 );
+
+	return sqrt ( -2 * log(u) ) * cos ( 2 * M_PI * synthRandom ( syn ) );
+}
+
+static void
+synthAddEdge ( synthT* syn, time_ns t, int level )
+{
+	int	i;
+
+	if ( syn->numedges >= SYNTH_MAX_EDGES )
+		return;
+
+	//(kept in time order)
+	for ( i=syn->numedges; i>0 && syn->edges[i-1].time > t; i-- )
+		syn->edges[i] = syn->edges[i-1];
+
+	syn->edges[i].time = t;
+	syn->edges[i].level = level;
+	syn->numedges++;
+}
+
+//work out the edges for the next second
+static void
+synthNextSecond ( synthT* syn )
+{
+	synthSecondT*	sec;
+	time_ns		start;
+	time_f		a, b, len, t;
+	int		i;
+
+	if ( ++syn->second >= 60 )
+	{
+		syn->second = 0;
+		syn->minute += 60;
+		synthEncodeMinute ( syn->clocktype, syn->minute, syn->frame );
+	}
+
+	sec = &syn->frame[syn->second];
+	start = (time_ns)(syn->minute + syn->second) * NSEC_PER_SEC + time_f2time_ns ( syn->noise.delay );
+
+	syn->numedges = 0;
+	syn->edgepos = 0;
+
+	t = syn->minute + syn->second - syn->start;
+	if ( t >= syn->noise.outagestart && t < syn->noise.outagestart + syn->noise.outage )
+		return;
+
+	if ( synthRandom ( syn ) >= syn->noise.dropout )
+	{
+		for ( i=0; i<sec->numlows; i++ )
+		{
+			a = sec->low[i][0] + syn->noise.jitter * synthGauss ( syn );
+			b = sec->low[i][1] + syn->noise.skew + syn->noise.jitter * synthGauss ( syn );
+			if ( b < a + 0.001 )
+				b = a + 0.001;
+
+			synthAddEdge ( syn, start + time_f2time_ns ( a ), 0 );
+			synthAddEdge ( syn, start + time_f2time_ns ( b ), 1 );
+		}
+	}
+
+	if ( synthRandom ( syn ) < syn->noise.glitch )
+	{
+		len = 0.005 + synthRandom ( syn ) * (syn->noise.glitchlen - 0.005);
+		a = synthRandom ( syn ) * (1.0 - len);
+
+		synthAddEdge ( syn, start + time_f2time_ns ( a ), 0 );
+		synthAddEdge ( syn, start + time_f2time_ns ( a + len ), 1 );
+	}
+}
+
+void
+synthInit ( synthT* syn, int clocktype, time_t start, const synthNoiseT* noise, unsigned int seed )
+{
+	memset ( syn, 0, sizeof(synthT) );
+
+	syn->clocktype = clocktype;
+	syn->noise = *noise;
+	syn->rng = seed ? seed : 1;
+
+	syn->start = start;
+	syn->minute = start - start % 60;
+	syn->second = -1;
+	synthEncodeMinute ( clocktype, syn->minute, syn->frame );
+
+	syn->level = 1;
+	syn->monooffset = (time_ns)syn->minute * NSEC_PER_SEC - 1000 * NSEC_PER_SEC;
+}
+
+void
+synthNextEdge ( synthT* syn, int* level, timeStampT* ts )
+{
+	time_ns	t, read;
+	time_f	err;
+
+	while(1)
+	{
+		while ( syn->edgepos >= syn->numedges )
+			synthNextSecond ( syn );
+
+		t = syn->edges[syn->edgepos].time;
+		*level = syn->edges[syn->edgepos].level;
+		syn->edgepos++;
+
+		//overlapping glitches and pulses - only the changes get out
+		if ( *level == syn->level )
+			continue;
+
+		if ( syn->noise.late > 0 && synthRandom ( syn ) < syn->noise.late )
+			t += time_f2time_ns ( 0.002 + 0.013 * synthRandom ( syn ) );
+
+		err = 0;
+		if ( syn->noise.slowread > 0 && synthRandom ( syn ) < syn->noise.slowread )
+		{
+			read = time_f2time_ns ( 0.002 + 0.013 * synthRandom ( syn ) );
+			if ( syn->noise.bracket )
+			{
+				t += read / 2;
+				err = time_ns2time_f ( read );
+			}
+			else
+				t += read;
+		}
+
+		//(and never out of order, whatever the jitter did - or a late timestamp, or a slow read)
+		if ( t <= syn->lastedge )
+			t = syn->lastedge + 1000;
+
+		syn->level = *level;
+		syn->lastedge = t;
+
+		//(the pc's clock gaining from the start)
+		t += (time_ns)llround ( (t - (time_ns)syn->start * NSEC_PER_SEC) * syn->noise.drift );
+
+		ts->real = t;
+		ts->mono = t - syn->monooffset;
+		ts->err = err;
+		return;
+	}
+}
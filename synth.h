@@ -0,0 +1,75 @@
+#ifndef SYNTH_H_
+#define SYNTH_H_
+
+#include "systime.h"
+#include "timef.h"
+
+//synthetic DCF77/MSF/WWVB receiver output, for measuring the decoders (see bench.c)
+//the line is low (0) while the carrier is reduced - as a receiver feeding a clock
+//that isn't inverted
+
+
+//what's wrong with the signal
+typedef struct
+{
+	time_f	delay;		//receiver delay - added to every edge
+	time_f	skew;		//receiver stretch - added to the end of each carrier reduction
+	time_f	jitter;		//standard deviation of each edge's time
+	time_f	dropout;	//chance per second of the second's pulses going missing
+	time_f	glitch;		//chance per second of a short spurious pulse
+	time_f	glitchlen;	//longest glitch (they're 5ms up to this)
+	time_f	drift;		//the pc clock's rate error - its timestamps gain this much a second
+	time_f	late;		//chance per edge of it being timestamped 2-15ms late (a late wakeup)
+	time_f	slowread;	//chance per edge of the status read being preempted, for 2-15ms...
+	int	bracket;	//...and the stamp put in the middle of the read, with its length as the error
+				//(as serial.c does) - or, if 0, taken after it
+	time_f	outage;		//no signal at all for this long (seconds)...
+	time_f	outagestart;	//...from this long after the start
+} synthNoiseT;
+
+//the carrier reductions in one second - up to two (MSF's A=0 B=1 seconds)
+typedef struct
+{
+	int	numlows;
+	time_f	low[2][2];	//start and end, from the start of the second
+} synthSecondT;
+
+#define	SYNTH_MAX_EDGES	(8)
+
+typedef struct
+{
+	int		clocktype;
+	synthNoiseT	noise;
+	unsigned int	rng;
+
+	time_t		start;		//(utc)
+	time_t		minute;		//utc start of the minute being sent
+	int		second;
+	synthSecondT	frame[60];
+
+	//the edges of the current second, after the noise
+	struct
+	{
+		time_ns	time;
+		int	level;
+	} edges[SYNTH_MAX_EDGES];
+	int		numedges;
+	int		edgepos;
+
+	int		level;
+	time_ns		lastedge;
+	time_ns		monooffset;	//(a made up monotonic clock - real less this)
+} synthT;
+
+
+//encode the frame sent during the minute starting at minute (utc)
+void synthEncodeMinute ( int clocktype, time_t minute, synthSecondT* frame );
+
+//start sending at the minute containing start
+void synthInit ( synthT* syn, int clocktype, time_t start, const synthNoiseT* noise, unsigned int seed );
+
+//the next edge - level is the line level after it, ts when the receiver output changed
+void synthNextEdge ( synthT* syn, int* level, timeStampT* ts );
+
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2002 Jon Atkins http://www.jonatkins.com/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "systime.h"
+
+#include "timef.h"
+
+
+
+void
+timeGetStamp ( timeStampT* ts )
+{
+	struct timespec	real, mono;
+
+	clock_gettime ( CLOCK_MONOTONIC, &mono );
+	clock_gettime ( CLOCK_REALTIME, &real );
+
+	timespec2time_ns ( &real, ts->real );
+	timespec2time_ns ( &mono, ts->mono );
+	ts->err = 0;
+}
+
+void
+timeStampFromReal ( timeStampT* ts, time_ns real )
+{
+	timeStampT	now;
+
+	timeGetStamp ( &now );
+
+	ts->real = real;
+	ts->mono = real - (now.real - now.mono);
+	ts->err = 0;
+}
+
+void
+timeStampFromMono ( timeStampT* ts, time_ns mono )
+{
+	timeStampT	now;
+
+	timeGetStamp ( &now );
+
+	ts->mono = mono;
+	ts->real = mono + (now.real - now.mono);
+	ts->err = 0;
+}
+
+void
+timeBracketStamp ( timeStampT* ts, const timeStampT* before, const timeStampT* after )
+{
+	ts->real = before->real + (after->real - before->real) / 2;
+	ts->mono = before->mono + (after->mono - before->mono) / 2;
+	ts->err = time_ns2time_f ( after->mono - before->mono );
+}
@@ -2,27 +2,64 @@
 #define TIMEF_H_
 
 #include <math.h>
+#include <inttypes.h>
 #include "systime.h"
 
 //a floating point time format for representing a time_t
+//(used for time differences - pulse lengths, offsets, errors)
 typedef double time_f;
 
 //printf() format for time_f values
 #define	TIMEF_FORMAT	"%.6f"
 
-//convert between 
+//an integer time format - nanoseconds since the epoch
+//(used for absolute times, so nothing is lost to rounding before ntpd sees them)
+typedef int64_t time_ns;
+
+#define	NSEC_PER_SEC	((time_ns)1000000000)
+
+//printf() format for (positive) time_ns values - use TIMENS_ARGS(t) for the arguments
+#define	TIMENS_FORMAT	"%" PRId64 ".%09" PRId64
+#define	TIMENS_ARGS(__timens)	(int64_t)((__timens) / NSEC_PER_SEC), (int64_t)((__timens) % NSEC_PER_SEC)
+
+//convert between
 #define	timeval2time_f(__timeval,__timef)	__timef = (time_f)(__timeval)->tv_sec + (time_f)(__timeval)->tv_usec / (time_f)1000000.0
 
-#define	time_f2timeval(__timef,__timeval)	do { (__timeval)->tv_sec = floor((__timef)); (__timeval)->tv_usec = ((__timef) - (__timeval)->tv_sec)*1000000.0; } while(0)
+#define	timespec2time_ns(__timespec,__timens)	__timens = (time_ns)(__timespec)->tv_sec * NSEC_PER_SEC + (time_ns)(__timespec)->tv_nsec
 
+#define	time_ns2timespec(__timens,__timespec)	do { (__timespec)->tv_sec = (__timens) / NSEC_PER_SEC; (__timespec)->tv_nsec = (__timens) % NSEC_PER_SEC; \
+							if ( (__timespec)->tv_nsec < 0 ) { (__timespec)->tv_sec--; (__timespec)->tv_nsec += NSEC_PER_SEC; } } while(0)
 
+//time differences between time_ns and time_f
+#define	time_ns2time_f(__timens)	((time_f)(__timens) / (time_f)1000000000.0)
+#define	time_f2time_ns(__timef)		((time_ns)llround((__timef) * (time_f)1000000000.0))
 
-#ifdef ENABLE_TIMEPPS
+//the current (wall clock) time
+#define	gettime_ns(__timens)	do { struct timespec __ts; clock_gettime ( CLOCK_REALTIME, &__ts ); timespec2time_ns ( &__ts, __timens ); } while(0)
 
-#define	timespec2time_f(__timeval,__timef)	__timef = (time_f)(__timeval)->tv_sec + (time_f)(__timeval)->tv_nsec / (time_f)1000000000.0
 
-#define	time_f2timespec(__timef,__timeval)	do { (__timeval)->tv_sec = floor((__timef)); (__timeval)->tv_nsec = ((__timef) - (__timeval)->tv_sec)*1000000000.0; } while(0)
+//the time of an edge, on two clocks:
+//mono is CLOCK_MONOTONIC - never stepped, so it's used to measure pulse lengths
+//real is CLOCK_REALTIME - the wall clock time, which is what gets sent to ntpd
+//(not CLOCK_MONOTONIC_RAW - gpio edge events and timers use CLOCK_MONOTONIC)
+//err is the width of the interval the edge is known to be in (0 for kernel timestamps)
+typedef struct
+{
+	time_ns	real;
+	time_ns	mono;
+	time_f	err;
+} timeStampT;
+
+//stamp the current time on both clocks
+void timeGetStamp ( timeStampT* ts );
+
+//fill in the other clock for a time only known on one of them (eg. a pps or gpio
+//event timestamp), using the current difference between the clocks
+void timeStampFromReal ( timeStampT* ts, time_ns real );
+void timeStampFromMono ( timeStampT* ts, time_ns mono );
+
+//the middle of the interval between two stamps, with its width as the error
+void timeBracketStamp ( timeStampT* ts, const timeStampT* before, const timeStampT* after );
 
-#endif
 
 #endif
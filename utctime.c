@@ -22,6 +22,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include "systime.h"
 
 #include "utctime.h"
@@ -53,3 +55,20 @@ UTCtime(struct tm *timeptr)
 
 }
 
+int
+UTCcheckDate ( int year, int mon, int mday, int wday )
+{
+	struct tm	t;
+
+	memset ( &t, 0, sizeof(t) );
+	t.tm_year = year - 1900;
+	t.tm_mon = mon;
+	t.tm_mday = mday;
+	t.tm_hour = 12;
+
+	//(a day past the end of the month comes back as the next month's)
+	if ( UTCtime ( &t ) == (time_t)(-1) )
+		return 0;
+
+	return t.tm_mon == mon && t.tm_mday == mday && ( wday < 0 || t.tm_wday == wday );
+}
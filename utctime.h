@@ -6,5 +6,8 @@
 
 time_t UTCtime(struct tm *timeptr);
 
+//whether a date exists (mon 0 - 11), and falls on wday (0 - 6, Sunday 0) - unless wday is -1
+int UTCcheckDate ( int year, int mon, int mday, int wday );
+
 
 #endif
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2002 Jon Atkins http://www.jonatkins.com/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "config.h"
+
+#include <string.h>
+#include <math.h>
+
+#include "clock.h"
+#include "vote.h"
+
+#include "logger.h"
+#include "settings.h"
+
+
+#define	VOTE_MATCH	(0.5)		//a minute before has to have ended this close to a whole number
+					//of minutes before (seconds)
+#define	VOTE_MARGIN	(3.0)		//how much better the minute found has to fit than the next best
+#define	VOTE_FIELD_BITS	(7)
+
+//where each station sends the minute - the only field that changes from one minute to the next
+//within the hour. bits are seconds times 2, plus 1 for MSF's B bit (as clkCorrectBits())
+typedef struct
+{
+	int	bits[VOTE_FIELD_BITS];
+	int	weights[VOTE_FIELD_BITS];	//BCD
+	int	parity;				//the parity bit covering it - -1 for none
+} voteFieldT;
+
+static const voteFieldT voteFields[3] =
+{
+	{ { 21*2, 22*2, 23*2, 24*2, 25*2, 26*2, 27*2 }, { 1, 2, 4, 8, 10, 20, 40 }, 28*2 },	//DCF77
+	{ { 45*2, 46*2, 47*2, 48*2, 49*2, 50*2, 51*2 }, { 40, 20, 10, 8, 4, 2, 1 }, 57*2+1 },	//MSF
+	{ { 1*2, 2*2, 3*2, 5*2, 6*2, 7*2, 8*2 }, { 40, 20, 10, 8, 4, 2, 1 }, -1 },		//WWVB
+};
+
+
+//bit j of the minute field, sending minute m
+static int
+voteFieldBit ( const voteFieldT* f, int j, int m )
+{
+	int	w = f->weights[j];
+
+	return w >= 10 ? ( (m / 10) & (w / 10) ) != 0 : ( (m % 10) & w ) != 0;
+}
+
+static int
+voteFieldParity ( const voteFieldT* f, int m )
+{
+	int	j, parity;
+
+	parity = 0;
+	for ( j=0; j<VOTE_FIELD_BITS; j++ )
+		parity ^= voteFieldBit ( f, j, m );
+
+	return parity;
+}
+
+//which of the minute field's bits a bit is - -1 for none
+static int
+voteFieldIndex ( const voteFieldT* f, int bit )
+{
+	int	j;
+
+	for ( j=0; j<VOTE_FIELD_BITS; j++ )
+	{
+		if ( f->bits[j] == bit )
+			return j;
+	}
+	return -1;
+}
+
+void
+voteAddMinute ( clkInfoT* clock, time_ns minstart )
+{
+	voteT*	v = &clock->votes;
+	int	s, i;
+
+	for ( s=0; s<60; s++ )
+	{
+		i = clock->numdata - 60 + s;
+		v->data[v->index][s] = i >= 0 ? clock->data[i] : CLK_ERASED;
+		v->cost[v->index][s][0] = i >= 0 ? clock->cost[i][0] : 0;
+		v->cost[v->index][s][1] = i >= 0 ? clock->cost[i][1] : 0;
+	}
+	v->time[v->index] = minstart;
+
+	v->index++;
+	v->index %= VOTE_MAX_MINUTES;
+}
+
+int
+voteMinute ( clkInfoT* clock, time_ns minstart )
+{
+	voteT*			v = &clock->votes;
+	const voteFieldT*	f = &voteFields[clock->clocktype];
+	int	age[VOTE_MAX_MINUTES];		//minutes before this one, -1 if not voted
+	int	taken[VOTE_MAX_MINUTES];
+	float	sum[60][2];
+	float	score, bestscore, nextscore;
+	time_f	back;
+	int	i, j, k, s, b, m, mi, val, bit, numused, best;
+
+	if ( voteMinutes <= 0 )
+		return -1;
+
+	//the minutes to vote - the newest that ended each whole number of minutes before
+	memset ( taken, 0, sizeof(taken) );
+	numused = 0;
+	for ( i=0; i<VOTE_MAX_MINUTES; i++ )
+	{
+		age[i] = -1;
+		if ( v->time[i] == 0 )
+			continue;
+
+		back = time_ns2time_f ( minstart - v->time[i] ) / 60;
+		k = lround ( back );
+		if ( k < 0 || k > voteMinutes || k >= VOTE_MAX_MINUTES || fabs ( back - k ) * 60 > VOTE_MATCH )
+			continue;
+		if ( taken[k] && v->time[i] <= v->time[taken[k]-1] )
+			continue;
+		if ( taken[k] )
+			age[taken[k]-1] = -1;
+		else
+			numused++;
+
+		taken[k] = i + 1;
+		age[i] = k;
+	}
+
+	if ( !taken[0] || numused < 2 )
+		return -1;
+
+	//the minute being sent: where the minute fields fit best, each one less than the next
+	best = 0;
+	bestscore = 1e30;
+	nextscore = 1e30;
+	for ( m=0; m<60; m++ )
+	{
+		score = 0;
+		for ( i=0; i<VOTE_MAX_MINUTES; i++ )
+		{
+			if ( age[i] < 0 )
+				continue;
+
+			mi = ( m - age[i] % 60 + 60 ) % 60;
+			for ( j=0; j<VOTE_FIELD_BITS; j++ )
+			{
+				s = f->bits[j] / 2;
+				b = f->bits[j] & 1;
+				bit = clkBitValue ( clock->clocktype, v->data[i][s], b );
+				if ( bit >= 0 && bit != voteFieldBit ( f, j, mi ) )
+					score += v->cost[i][s][b];
+			}
+		}
+
+		if ( score < bestscore )
+		{
+			nextscore = bestscore;
+			bestscore = score;
+			best = m;
+		}
+		else if ( score < nextscore )
+			nextscore = score;
+	}
+
+	if ( nextscore - bestscore < VOTE_MARGIN )
+	{
+		loggerf ( LOGGER_DEBUG, "vote: %d minutes don't agree on the minute (best %02d, cost %.1f, next %.1f)\n",
+			numused, best, bestscore, nextscore );
+		return -1;
+	}
+
+	//each bit's votes, weighted by how sure they were - the minute field (and the parity bit
+	//covering it) as if sent this minute, and the rest from this hour only
+	memset ( sum, 0, sizeof(sum) );
+	for ( i=0; i<VOTE_MAX_MINUTES; i++ )
+	{
+		if ( age[i] < 0 )
+			continue;
+
+		mi = ( best - age[i] % 60 + 60 ) % 60;
+		for ( s=0; s<60; s++ )
+		{
+			for ( b=0; b<2; b++ )
+			{
+				bit = clkBitValue ( clock->clocktype, v->data[i][s], b );
+				if ( bit < 0 )
+					continue;
+
+				j = voteFieldIndex ( f, s*2 + b );
+				if ( j >= 0 )
+					bit ^= voteFieldBit ( f, j, mi ) ^ voteFieldBit ( f, j, best );
+				else if ( age[i] > best )
+					continue;
+				else if ( s*2 + b == f->parity )
+					bit ^= voteFieldParity ( f, mi ) ^ voteFieldParity ( f, best );
+
+				sum[s][b] += bit ? v->cost[i][s][b] : -v->cost[i][s][b];
+			}
+		}
+	}
+
+	//the voted minute, from the newest value for each second (this hour's, but for the minute
+	//field) with its bits set as voted - erased if there's none
+	for ( s=0; s<60; s++ )
+	{
+		val = CLK_ERASED;
+		for ( k=0; k<VOTE_MAX_MINUTES && val == CLK_ERASED; k++ )
+		{
+			if ( taken[k] && ( k <= best || voteFieldIndex ( f, s*2 ) >= 0 ) )
+				val = v->data[taken[k]-1][s];
+		}
+
+		for ( b=0; b<2; b++ )
+		{
+			clock->cost[s][b] = PULSE_MAX_COST;
+			bit = clkBitValue ( clock->clocktype, val, b );
+			if ( bit < 0 )
+				continue;
+
+			//(a minute field bit no one was sure of is the minute's)
+			j = voteFieldIndex ( f, s*2 + b );
+			if ( sum[s][b] != 0 ? (sum[s][b] > 0) != bit : j >= 0 && voteFieldBit ( f, j, best ) != bit )
+				val = clkFlipValue ( clock->clocktype, val, b );
+			clock->cost[s][b] = fmin ( fabs ( sum[s][b] ), PULSE_MAX_COST );
+		}
+
+		clock->data[s] = val;
+		clock->width[s] = 0;
+	}
+	clock->numdata = 60;
+
+	loggerf ( LOGGER_DEBUG, "vote: minute %02d from %d minutes (cost %.1f, next %.1f)\n", best, numused, bestscore, nextscore );
+
+	return numused;
+}
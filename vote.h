@@ -0,0 +1,34 @@
+#ifndef VOTE_H_
+#define VOTE_H_
+
+#include "timef.h"
+
+//voting across minutes: in poor reception no one minute may make it through the decoder, but
+//most of the bits are right in most minutes. the minutes before are kept (with how sure each
+//bit was), the one being sent now found from where they all agree best - each sends the minute
+//one less than the next, everything else stays the same within the hour - and each bit voted
+//on, weighted by how sure it was. the voted minute goes through the decoder as any other
+
+#define	VOTE_MAX_MINUTES	(60)		//minutes kept - voteMinutes can be one less
+
+struct clkInfoS;
+
+typedef struct
+{
+	signed char	data[VOTE_MAX_MINUTES][60];	//clkInfoT.data for each second
+	float		cost[VOTE_MAX_MINUTES][60][2];	//and clkInfoT.cost
+	time_ns		time[VOTE_MAX_MINUTES];		//when the minute ended - 0 for none
+	int		index;				//the next to use
+} voteT;
+
+
+//keep the minute that's just ended (the last 60 of clock->data), with the time it ended
+void voteAddMinute ( struct clkInfoS* clock, time_ns minstart );
+
+//vote the minute that's just ended (as added last) with the ones before it - replaces clock->data
+//with the voted minute, to be decoded. returns the number of minutes voted, or -1 if there aren't
+//enough or they don't agree on the minute
+int voteMinute ( struct clkInfoS* clock, time_ns minstart );
+
+
+#endif
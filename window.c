@@ -0,0 +1,359 @@
+/*
+ * Copyright (c) 2002 Jon Atkins http://www.jonatkins.com/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include "config.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "window.h"
+#include "memory.h"
+
+
+#define	NONE		(-1)
+
+
+static void
+windowSumsAdd ( windowSumsT* to, const windowSumsT* from, int sign )
+{
+	to->count += sign * from->count;
+	to->w += sign * from->w;
+	to->wx += sign * from->wx;
+	to->wt += sign * from->wt;
+	to->x += sign * from->x;
+	to->xx += sign * from->xx;
+	to->t += sign * from->t;
+	to->tt += sign * from->tt;
+	to->tx += sign * from->tx;
+}
+
+//a node's own sample's sums
+static void
+windowOwnSums ( const windowT* w, int t, windowSumsT* s )
+{
+	time_f	x, tm, wt;
+
+	x = w->node[t].x;
+	tm = w->node[t].t;
+	wt = w->node[t].weight;
+
+	s->count = 1;
+	s->w = wt;
+	s->wx = wt * x;
+	s->wt = wt * tm;
+	s->x = x;
+	s->xx = x * x;
+	s->t = tm;
+	s->tt = tm * tm;
+	s->tx = tm * x;
+}
+
+//a node's sums, from its own sample and its children's
+static void
+windowPull ( windowT* w, int t )
+{
+	windowSumsT*	s;
+
+	s = &w->node[t].sums;
+	windowOwnSums ( w, t, s );
+
+	if ( w->node[t].left != NONE )
+		windowSumsAdd ( s, &w->node[w->node[t].left].sums, 1 );
+	if ( w->node[t].right != NONE )
+		windowSumsAdd ( s, &w->node[w->node[t].right].sums, 1 );
+}
+
+//whether slot a's sample comes before slot b's
+static int
+windowBefore ( const windowT* w, int a, int b )
+{
+	if ( w->node[a].x != w->node[b].x )
+		return w->node[a].x < w->node[b].x;
+	return a < b;
+}
+
+//split the tree at t into the samples before slot's, and the rest
+static void
+windowSplit ( windowT* w, int t, int slot, int* before, int* after )
+{
+	if ( t == NONE )
+	{
+		*before = *after = NONE;
+		return;
+	}
+
+	if ( windowBefore ( w, t, slot ) )
+	{
+		windowSplit ( w, w->node[t].right, slot, &w->node[t].right, after );
+		*before = t;
+	}
+	else
+	{
+		windowSplit ( w, w->node[t].left, slot, before, &w->node[t].left );
+		*after = t;
+	}
+	windowPull ( w, t );
+}
+
+//join two trees, all of a's samples before b's
+static int
+windowMerge ( windowT* w, int a, int b )
+{
+	if ( a == NONE )
+		return b;
+	if ( b == NONE )
+		return a;
+
+	if ( w->node[a].prio > w->node[b].prio )
+	{
+		w->node[a].right = windowMerge ( w, w->node[a].right, b );
+		windowPull ( w, a );
+		return a;
+	}
+
+	w->node[b].left = windowMerge ( w, a, w->node[b].left );
+	windowPull ( w, b );
+	return b;
+}
+
+//take slot out of the tree at t - returning what's left
+static int
+windowErase ( windowT* w, int t, int slot )
+{
+	if ( t == slot )
+		return windowMerge ( w, w->node[t].left, w->node[t].right );
+
+	if ( windowBefore ( w, slot, t ) )
+		w->node[t].left = windowErase ( w, w->node[t].left, slot );
+	else
+		w->node[t].right = windowErase ( w, w->node[t].right, slot );
+	windowPull ( w, t );
+
+	return t;
+}
+
+void
+windowInit ( windowT* w, int size )
+{
+	w->node = safe_mallocz ( size * sizeof(*w->node) );
+	w->size = size;
+	w->seed = 1;
+	windowClear ( w );
+}
+
+void
+windowFree ( windowT* w )
+{
+	safe_free ( w->node );
+	w->node = NULL;
+	w->size = 0;
+}
+
+void
+windowClear ( windowT* w )
+{
+	int	i;
+
+	for ( i=0; i<w->size; i++ )
+		w->node[i].used = 0;
+	w->root = NONE;
+}
+
+void
+windowAdd ( windowT* w, int slot, time_f x, time_f t, time_f weight )
+{
+	int	before, after;
+
+	windowRemove ( w, slot );
+
+	w->seed = w->seed * 1103515245 + 12345;
+
+	w->node[slot].x = x;
+	w->node[slot].t = t;
+	w->node[slot].weight = weight;
+	w->node[slot].used = 1;
+	w->node[slot].left = w->node[slot].right = NONE;
+	w->node[slot].prio = w->seed >> 8;
+	windowPull ( w, slot );
+
+	windowSplit ( w, w->root, slot, &before, &after );
+	w->root = windowMerge ( w, windowMerge ( w, before, slot ), after );
+}
+
+void
+windowRemove ( windowT* w, int slot )
+{
+	if ( !w->node[slot].used )
+		return;
+
+	w->root = windowErase ( w, w->root, slot );
+	w->node[slot].used = 0;
+}
+
+int
+windowCount ( const windowT* w )
+{
+	return w->root == NONE ? 0 : w->node[w->root].sums.count;
+}
+
+time_f
+windowNth ( const windowT* w, int k )
+{
+	int	t, left;
+
+	t = w->root;
+	while ( t != NONE )
+	{
+		left = w->node[t].left == NONE ? 0 : w->node[w->node[t].left].sums.count;
+		if ( k < left )
+			t = w->node[t].left;
+		else if ( k == left )
+			return w->node[t].x;
+		else
+		{
+			k -= left + 1;
+			t = w->node[t].right;
+		}
+	}
+
+	return 0;
+}
+
+time_f
+windowMedian ( const windowT* w )
+{
+	return windowNth ( w, windowCount ( w ) / 2 );
+}
+
+int
+windowRank ( const windowT* w, time_f x )
+{
+	int	t, k;
+
+	k = 0;
+	t = w->root;
+	while ( t != NONE )
+	{
+		if ( w->node[t].x < x )
+		{
+			k += 1 + (w->node[t].left == NONE ? 0 : w->node[w->node[t].left].sums.count);
+			t = w->node[t].right;
+		}
+		else
+			t = w->node[t].left;
+	}
+
+	return k;
+}
+
+time_f
+windowMAD ( const windowT* w, time_f m )
+{
+	int	n, below, k, lo, hi, i, j;
+	time_f	dl, dr;
+
+	n = windowCount ( w );
+	if ( n == 0 )
+		return 0;
+
+	//the distances below m (going down from rank below-1) and above it (going up from rank
+	//below) are each in order - the k'th smallest of the two, taking i of them from below and
+	//k-i from above, found by bisecting on i
+	below = windowRank ( w, m );
+	k = n/2 + 1;
+	lo = k - (n - below) > 0 ? k - (n - below) : 0;
+	hi = k < below ? k : below;
+	while ( lo < hi )
+	{
+		i = (lo + hi) / 2;
+		j = k - i;
+		//(too few from below, if the next one down is nearer than the last one up taken)
+		if ( m - windowNth ( w, below - 1 - i ) < windowNth ( w, below + j - 1 ) - m )
+			lo = i + 1;
+		else
+			hi = i;
+	}
+
+	i = lo;
+	j = k - i;
+	dl = i > 0 ? m - windowNth ( w, below - i ) : 0;
+	dr = j > 0 ? windowNth ( w, below + j - 1 ) - m : 0;
+
+	return dl > dr ? dl : dr;
+}
+
+//the sums over the k lowest ranks
+static void
+windowPrefix ( const windowT* w, int k, windowSumsT* sums, int sign )
+{
+	windowSumsT	own;
+	int		t, left;
+
+	t = w->root;
+	while ( t != NONE && k > 0 )
+	{
+		left = w->node[t].left == NONE ? 0 : w->node[w->node[t].left].sums.count;
+		if ( k <= left )
+		{
+			t = w->node[t].left;
+			continue;
+		}
+
+		if ( left > 0 )
+			windowSumsAdd ( sums, &w->node[w->node[t].left].sums, sign );
+
+		windowOwnSums ( w, t, &own );
+		windowSumsAdd ( sums, &own, sign );
+
+		k -= left + 1;
+		t = w->node[t].right;
+	}
+}
+
+void
+windowSums ( const windowT* w, int from, int to, windowSumsT* sums )
+{
+	memset ( sums, 0, sizeof(*sums) );
+	windowPrefix ( w, to, sums, 1 );
+	windowPrefix ( w, from, sums, -1 );
+}
+
+time_f
+windowSpread ( const windowT* w, int from, int to, time_f a, time_f b )
+{
+	windowSumsT	sums;
+	windowSumsT*	s;
+	time_f		var;
+
+	if ( to <= from )
+		return 0;
+
+	//(sum of (x - a - b*t)^2, from the sums)
+	s = &sums;
+	windowSums ( w, from, to, s );
+	var = ( s->xx + s->count * a * a + b * b * s->tt
+		- 2 * a * s->x - 2 * b * s->tx + 2 * a * b * s->t ) / s->count;
+
+	return var > 0 ? sqrt ( var ) : 0;
+}
@@ -0,0 +1,78 @@
+#ifndef WINDOW_H_
+#define WINDOW_H_
+
+#include "timef.h"
+
+//a sliding window of samples kept in order: a sample is added to (or taken from) its slot as it
+//comes in (or goes), in O(log n), and the median, the sums over a run of ranks and the spread
+//(about a mean, or a line against the samples' times) can be had at any time, in O(log n) too (the
+//median absolute deviation in O(log^2 n)) - rather than sorting the lot each time. it's a treap (a
+//binary search tree, kept balanced by random priorities) over the slots, each node holding the
+//sums of the samples under it, so the sums over any run of ranks come from one walk down. the
+//samples are in order of value, x - each has a time, t, too
+
+typedef struct
+{
+	int	count;
+	time_f	w;		//sum of the weights
+	time_f	wx;		//of the weighted values
+	time_f	wt;		//times
+	time_f	x;		//of the values (unweighted)
+	time_f	xx;
+	time_f	t;
+	time_f	tt;
+	time_f	tx;
+} windowSumsT;
+
+typedef struct
+{
+	struct
+	{
+		time_f		x;		//the value - kept in order of (x, slot)
+		time_f		t;		//and its time
+		time_f		weight;
+		int		used;
+		int		left, right;	//slots - -1 for none
+		unsigned int	prio;
+		windowSumsT	sums;		//of it and everything under it
+	} *node;
+	int		size;		//slots
+	int		root;
+	unsigned int	seed;
+} windowT;
+
+
+void windowInit ( windowT* w, int size );
+void windowFree ( windowT* w );
+
+//empty it
+void windowClear ( windowT* w );
+
+//put a sample in slot - replacing whatever was there
+void windowAdd ( windowT* w, int slot, time_f x, time_f t, time_f weight );
+
+//take slot's sample out (if it has one)
+void windowRemove ( windowT* w, int slot );
+
+int windowCount ( const windowT* w );
+
+//the value of rank k (0 the smallest)
+time_f windowNth ( const windowT* w, int k );
+
+time_f windowMedian ( const windowT* w );
+
+//how many are below x - the rank x would have
+int windowRank ( const windowT* w, time_f x );
+
+//the median absolute deviation from m (m the median, usually) - a spread that a few wild samples
+//don't pull
+time_f windowMAD ( const windowT* w, time_f m );
+
+//the sums over ranks from to to-1
+void windowSums ( const windowT* w, int from, int to, windowSumsT* sums );
+
+//the rms distance of ranks from to to-1 from the line x = a + b*t (b = 0 for a mean)
+time_f windowSpread ( const windowT* w, int from, int to, time_f a, time_f b );
+
+
+#endif